@@ -1 +1 @@
-./build/src/profiling/ec_create_doca
\ No newline at end of file
+./build/src/profiling/ec_create_doca "$@"
\ No newline at end of file
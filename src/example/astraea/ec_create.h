@@ -20,6 +20,15 @@ struct ec_create_config {
     size_t block_size;
     uint32_t nb_tasks;
     uint32_t latency;
+    bool inline_submit;
+    /* Encode on the CPU, no device is opened */
+    bool software;
+    /* CPU workers strips spill to when tokens run out, 0 disables */
+    uint32_t nb_spillover_workers;
+    /* Sleep on the event fd of the pe instead of polling it */
+    bool event_driven;
+    /* Reap completions in batches instead of taking callbacks */
+    bool is_reaping;
 };
 
 /* Helper class to allocate and destroy resources */
@@ -29,7 +38,6 @@ class ec_create_resources {
 
     astraea_ec_matrix *matrix = nullptr;
     astraea_ec *ec = nullptr;
-    std::vector<astraea_ec_task_create *> tasks;
     astraea_ctx *ctx = nullptr;
 
     astraea_pe *pe = nullptr;
@@ -45,7 +53,8 @@ class ec_create_resources {
 
     doca_error_t prepare_memory(const ec_create_config &cfg);
 
-    doca_error_t setup_ec_ctx(astraea_ec_task_create_completion_cb_t success_cb,
+    doca_error_t setup_ec_ctx(const ec_create_config &cfg,
+                              astraea_ec_task_create_completion_cb_t success_cb,
                               astraea_ec_task_create_completion_cb_t error_cb);
 
     doca_error_t open_dev();
@@ -7,6 +7,7 @@
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <sys/epoll.h>
 #include <thread>
 #include <unistd.h>
 
@@ -26,6 +27,11 @@
 
 DOCA_LOG_REGISTER(EC_CREATE : CORE);
 
+/* Waits only time out if a wake up was lost */
+constexpr int EVENT_WAIT_TIMEOUT_MS = 100;
+/* Completions reaped per astraea_pe_progress call */
+constexpr uint32_t REAP_BATCH_SIZE = 32;
+
 static void write_to_file(void *data, size_t size, const char *file_name) {
     namespace fs = std::filesystem;
 
@@ -55,14 +61,8 @@ static void write_to_file(void *data, size_t size, const char *file_name) {
     }
 }
 
-/* Tasks will be free in the destructor */
-void ec_create_success_cb(astraea_ec_task_create *task,
-                          doca_data task_user_data, doca_data ctx_user_data) {
-    (void)task;
-    (void)ctx_user_data;
-
-    ec_create_user_data *user_data =
-        static_cast<ec_create_user_data *>(task_user_data.ptr);
+/* Tasks go back to the ec once they complete, there is nothing to free */
+static void on_task_success(ec_create_user_data *user_data) {
     user_data->end_time_arr->push_back(
         std::chrono::high_resolution_clock::now());
 
@@ -80,7 +80,7 @@ void ec_create_success_cb(astraea_ec_task_create *task,
         std::chrono::high_resolution_clock::now());
 
     doca_error_t status = astraea_ec_task_create_allocate_init(
-        rscs->ec, rscs->matrix, rscs->mmap, rscs->src_buf,
+        rscs->ec, rscs->matrix, rscs->mmap, rscs->src_buf, rscs->mmap,
         rscs->dst_bufs[*nb_finished_tasks], {.ptr = user_data}, &new_task);
     if (status != DOCA_SUCCESS) {
         DOCA_LOG_ERR("Failed to allocate and init ec task: %s",
@@ -91,20 +91,96 @@ void ec_create_success_cb(astraea_ec_task_create *task,
     status = astraea_task_submit(astraea_ec_task_create_as_task(new_task));
     if (status != DOCA_SUCCESS) {
         DOCA_LOG_ERR("Failed to submit task: %s", doca_error_get_descr(status));
+        astraea_task_free(astraea_ec_task_create_as_task(new_task));
         return;
     }
-    rscs->tasks.push_back(new_task);
 }
+
+static void on_task_error(ec_create_user_data *user_data) {
+    uint32_t *nb_finished_tasks = user_data->nb_finished_tasks;
+    (*nb_finished_tasks)++;
+    DOCA_LOG_ERR("EC create task failed");
+}
+
+void ec_create_success_cb(astraea_ec_task_create *task,
+                          doca_data task_user_data, doca_data ctx_user_data) {
+    (void)task;
+    (void)ctx_user_data;
+    on_task_success(static_cast<ec_create_user_data *>(task_user_data.ptr));
+}
+
 void ec_create_error_cb(astraea_ec_task_create *task, doca_data task_user_data,
                         doca_data ctx_user_data) {
     (void)task;
     (void)ctx_user_data;
+    on_task_error(static_cast<ec_create_user_data *>(task_user_data.ptr));
+}
 
-    ec_create_user_data *user_data =
-        static_cast<ec_create_user_data *>(task_user_data.ptr);
-    uint32_t *nb_finished_tasks = user_data->nb_finished_tasks;
-    (*nb_finished_tasks)++;
-    DOCA_LOG_ERR("EC create task failed");
+/* Drain the pe, tasks set up without callbacks are handled in batches */
+static void reap_tasks(astraea_pe *pe) {
+    astraea_completion completions[REAP_BATCH_SIZE];
+    uint32_t nb_completions;
+    do {
+        nb_completions =
+            astraea_pe_progress(pe, completions, REAP_BATCH_SIZE);
+        for (uint32_t i = 0; i < nb_completions; i++) {
+            ec_create_user_data *user_data =
+                static_cast<ec_create_user_data *>(
+                    completions[i].user_data.ptr);
+            if (completions[i].status == DOCA_SUCCESS) {
+                on_task_success(user_data);
+            } else {
+                on_task_error(user_data);
+            }
+        }
+    } while (nb_completions == REAP_BATCH_SIZE);
+}
+
+/**
+ * Sleep until the pe has completions, the way an app adds the event fd of
+ * the pe to its own epoll set
+ */
+static doca_error_t wait_for_tasks(astraea_pe *pe,
+                                   const uint32_t &nb_finished_tasks,
+                                   uint32_t nb_tasks, bool is_reaping) {
+    int event_fd;
+    doca_error_t status = astraea_pe_get_event_fd(pe, &event_fd);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to get pe event fd: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event = {.events = EPOLLIN, .data = {.fd = event_fd}};
+    if (epoll_fd < 0 ||
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, event_fd, &event) != 0) {
+        DOCA_LOG_ERR("Failed to watch pe event fd");
+        if (epoll_fd >= 0) {
+            close(epoll_fd);
+        }
+        return DOCA_ERROR_OPERATING_SYSTEM;
+    }
+
+    while (nb_finished_tasks < nb_tasks) {
+        status = astraea_pe_request_notification(pe);
+        if (status != DOCA_SUCCESS) {
+            break;
+        }
+        (void)epoll_wait(epoll_fd, &event, 1, EVENT_WAIT_TIMEOUT_MS);
+        status = astraea_pe_clear_notification(pe);
+        if (status != DOCA_SUCCESS) {
+            break;
+        }
+        if (is_reaping) {
+            reap_tasks(pe);
+            continue;
+        }
+        while (astraea_pe_progress(pe)) {
+        }
+    }
+    close(epoll_fd);
+    return status;
 }
 
 doca_error_t ec_create(const ec_create_config &cfg) {
@@ -113,10 +189,12 @@ doca_error_t ec_create(const ec_create_config &cfg) {
     ec_create_resources rscs;
 
     /* Open device */
-    status = rscs.open_dev();
-    if (status != DOCA_SUCCESS) {
-        DOCA_LOG_ERR("Failed to open device");
-        return status;
+    if (!cfg.software) {
+        status = rscs.open_dev();
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to open device");
+            return status;
+        }
     }
 
     /* Create pe */
@@ -127,7 +205,12 @@ doca_error_t ec_create(const ec_create_config &cfg) {
     }
 
     /* Create and config ec ctx */
-    status = rscs.setup_ec_ctx(ec_create_success_cb, ec_create_error_cb);
+    if (cfg.is_reaping) {
+        status = rscs.setup_ec_ctx(cfg, nullptr, nullptr);
+    } else {
+        status =
+            rscs.setup_ec_ctx(cfg, ec_create_success_cb, ec_create_error_cb);
+    }
     if (status != DOCA_SUCCESS) {
         DOCA_LOG_ERR("Failed to setup ec ctx");
         return status;
@@ -172,8 +255,8 @@ doca_error_t ec_create(const ec_create_config &cfg) {
     astraea_ec_task_create *task;
     begin_time_arr.push_back(std::chrono::high_resolution_clock::now());
     status = astraea_ec_task_create_allocate_init(
-        rscs.ec, rscs.matrix, rscs.mmap, rscs.src_buf, rscs.dst_bufs[0],
-        {.ptr = &user_data}, &task);
+        rscs.ec, rscs.matrix, rscs.mmap, rscs.src_buf, rscs.mmap,
+        rscs.dst_bufs[0], {.ptr = &user_data}, &task);
     if (status != DOCA_SUCCESS) {
         DOCA_LOG_ERR("Failed to allocate and init ec task: %s",
                      doca_error_get_descr(status));
@@ -183,15 +266,64 @@ doca_error_t ec_create(const ec_create_config &cfg) {
     status = astraea_task_submit(astraea_ec_task_create_as_task(task));
     if (status != DOCA_SUCCESS) {
         DOCA_LOG_ERR("Failed to submit task: %s", doca_error_get_descr(status));
+        astraea_task_free(astraea_ec_task_create_as_task(task));
         return status;
     }
-    rscs.tasks.push_back(task);
 
+    if (cfg.event_driven) {
+        status = wait_for_tasks(rscs.pe, nb_finished_tasks, cfg.nb_tasks,
+                                cfg.is_reaping);
+        if (status != DOCA_SUCCESS) {
+            return status;
+        }
+    }
     while (nb_finished_tasks < cfg.nb_tasks) {
-        (void)astraea_pe_progress(rscs.pe);
+        if (cfg.is_reaping) {
+            reap_tasks(rscs.pe);
+        } else {
+            (void)astraea_pe_progress(rscs.pe);
+        }
         std::this_thread::sleep_for(std::chrono::microseconds(10));
     }
 
+    astraea_sgl_cache_stats sgl_stats;
+    astraea_ec_get_sgl_cache_stats(rscs.ec, &sgl_stats);
+    DOCA_LOG_INFO("SGL cache: %lu hits, %lu misses, %lu evictions, %u bufs",
+                  sgl_stats.nb_hits, sgl_stats.nb_misses,
+                  sgl_stats.nb_evictions, sgl_stats.nb_bufs);
+
+    astraea_granularity_stats granularity_stats;
+    astraea_ec_get_granularity_stats(rscs.ec, &granularity_stats);
+    DOCA_LOG_INFO("Granularity: %lu of %lu tasks sliced, %lu sla misses, "
+                  "bias %d after %lu steps up and %lu down, %luns per strip",
+                  granularity_stats.nb_sliced_tasks, granularity_stats.nb_tasks,
+                  granularity_stats.nb_sla_misses, granularity_stats.bias,
+                  granularity_stats.nb_steps_up,
+                  granularity_stats.nb_steps_down,
+                  granularity_stats.strip_overhead_ns);
+
+    astraea_matrix_cache_stats matrix_stats;
+    astraea_ec_get_matrix_cache_stats(rscs.ec, &matrix_stats);
+    DOCA_LOG_INFO("Matrix cache: %lu hits, %lu misses, %u matrices",
+                  matrix_stats.nb_hits, matrix_stats.nb_misses,
+                  matrix_stats.nb_matrices);
+
+    astraea_submit_stats submit_stats;
+    astraea_ctx_get_submit_stats(rscs.ctx, &submit_stats);
+    DOCA_LOG_INFO("Submitter: %lu strips in %lu bursts, max burst %u",
+                  submit_stats.nb_submitted, submit_stats.nb_bursts,
+                  submit_stats.max_burst_size);
+
+    astraea_idle_stats idle_stats;
+    astraea_ctx_get_idle_stats(rscs.ctx, &idle_stats);
+    DOCA_LOG_INFO("Submitter idle: %lu parks, %lu submit and %lu refill "
+                  "wakeups, %luns max wakeup latency, %luus spinning, %luus "
+                  "parked, %luus cpu",
+                  idle_stats.nb_parks, idle_stats.nb_submit_wakeups,
+                  idle_stats.nb_refill_wakeups,
+                  idle_stats.max_wakeup_latency_ns, idle_stats.spin_ns / 1000,
+                  idle_stats.parked_ns / 1000, idle_stats.cpu_ns / 1000);
+
     for (uint32_t i = 0; i < cfg.nb_tasks; i++) {
         std::chrono::high_resolution_clock::time_point begin_time =
             begin_time_arr[i];
@@ -115,6 +115,76 @@ doca_error_t register_ec_create_params() {
         return status;
     }
 
+    status = register_param(
+        "in", "inline", "submit from pe progress instead of a thread",
+        [](void *param, void *config) -> doca_error_t {
+            ec_create_config *cfg = static_cast<ec_create_config *>(config);
+            cfg->inline_submit = *static_cast<bool *>(param);
+            return DOCA_SUCCESS;
+        },
+        DOCA_ARGP_TYPE_BOOLEAN);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register inline param: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = register_param(
+        "sw", "software", "encode on the CPU instead of a device",
+        [](void *param, void *config) -> doca_error_t {
+            ec_create_config *cfg = static_cast<ec_create_config *>(config);
+            cfg->software = *static_cast<bool *>(param);
+            return DOCA_SUCCESS;
+        },
+        DOCA_ARGP_TYPE_BOOLEAN);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register software param: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = register_param(
+        "spill", "spillover", "CPU workers to spill strips to without tokens",
+        [](void *param, void *config) -> doca_error_t {
+            ec_create_config *cfg = static_cast<ec_create_config *>(config);
+            cfg->nb_spillover_workers = *static_cast<uint32_t *>(param);
+            return DOCA_SUCCESS;
+        },
+        DOCA_ARGP_TYPE_INT);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register spillover param: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = register_param(
+        "ev", "event", "wait for completions on an fd instead of polling",
+        [](void *param, void *config) -> doca_error_t {
+            ec_create_config *cfg = static_cast<ec_create_config *>(config);
+            cfg->event_driven = *static_cast<bool *>(param);
+            return DOCA_SUCCESS;
+        },
+        DOCA_ARGP_TYPE_BOOLEAN);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register event param: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = register_param(
+        "cq", "reap", "reap completions in batches instead of callbacks",
+        [](void *param, void *config) -> doca_error_t {
+            ec_create_config *cfg = static_cast<ec_create_config *>(config);
+            cfg->is_reaping = *static_cast<bool *>(param);
+            return DOCA_SUCCESS;
+        },
+        DOCA_ARGP_TYPE_BOOLEAN);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register reap param: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
     return DOCA_SUCCESS;
 }
 
@@ -149,7 +219,12 @@ int main(int argc, char **argv) {
                             .nb_rdnc_blocks = 32,
                             .block_size = 1024,
                             .nb_tasks = 1,
-                            .latency = 20};
+                            .latency = 20,
+                            .inline_submit = false,
+                            .software = false,
+                            .nb_spillover_workers = 0,
+                            .event_driven = false,
+                            .is_reaping = false};
 
     status = doca_argp_init("ec_create", &cfg);
     if (status != DOCA_SUCCESS) {
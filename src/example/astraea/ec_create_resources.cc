@@ -26,10 +26,6 @@ static void mock_data(void *buffer, size_t length) {
 ec_create_resources::ec_create_resources() {}
 
 ec_create_resources::~ec_create_resources() {
-    /* Free tasks */
-    for (astraea_ec_task_create *task : tasks)
-        astraea_task_free(astraea_ec_task_create_as_task(task));
-
     /* Destroy ec related resources */
     if (ctx) {
         doca_error_t status = astraea_ctx_stop(ctx);
@@ -77,10 +73,14 @@ doca_error_t ec_create_resources::prepare_memory(const ec_create_config &cfg) {
         return status;
     }
 
-    status = doca_mmap_add_dev(mmap, dev);
-    if (status != DOCA_SUCCESS) {
-        DOCA_LOG_ERR("Failed to add dev: %s", doca_error_get_descr(status));
-        return status;
+    /* Software ecs only read the memory from the CPU */
+    if (dev) {
+        status = doca_mmap_add_dev(mmap, dev);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to add dev: %s",
+                         doca_error_get_descr(status));
+            return status;
+        }
     }
 
     size_t data_buf_size = cfg.nb_data_blocks * cfg.block_size;
@@ -161,15 +161,29 @@ doca_error_t ec_create_resources::prepare_memory(const ec_create_config &cfg) {
 }
 
 doca_error_t ec_create_resources::setup_ec_ctx(
+    const ec_create_config &cfg,
     astraea_ec_task_create_completion_cb_t success_cb,
     astraea_ec_task_create_completion_cb_t error_cb) {
     doca_error_t status;
-    status = astraea_ec_create(dev, &ec);
+    if (cfg.software) {
+        status = astraea_ec_create_software(&ec);
+    } else {
+        status = astraea_ec_create(dev, &ec);
+    }
     if (status != DOCA_SUCCESS) {
         DOCA_LOG_ERR("Failed to create ec: %s", doca_error_get_descr(status));
         return status;
     }
 
+    if (cfg.nb_spillover_workers > 0) {
+        status = astraea_ec_set_spillover(ec, cfg.nb_spillover_workers);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to set spillover: %s",
+                         doca_error_get_descr(status));
+            return status;
+        }
+    }
+
     status = astraea_ec_task_create_set_conf(ec, success_cb, error_cb,
                                              MAX_NB_EC_TASKS);
     if (status != DOCA_SUCCESS) {
@@ -184,6 +198,25 @@ doca_error_t ec_create_resources::setup_ec_ctx(
         return DOCA_ERROR_UNEXPECTED;
     }
 
+    status = astraea_ctx_set_inline_submit(ctx, cfg.inline_submit);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set submit mode: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    /* The matrix is ready before the first task */
+    astraea_ec_matrix_geometry geometry = {
+        .type = ASTRAEA_EC_MATRIX_TYPE_CAUCHY,
+        .nb_data_blocks = cfg.nb_data_blocks,
+        .nb_rdnc_blocks = cfg.nb_rdnc_blocks};
+    status = astraea_ec_set_matrix_prewarm(ec, &geometry, 1);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set matrix prewarm: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
     status = astraea_pe_connect_ctx(pe, ctx);
     if (status != DOCA_SUCCESS) {
         DOCA_LOG_ERR("Failed to connect pe to ctx: %s",
@@ -0,0 +1,75 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <doca_buf.h>
+#include <doca_buf_inventory.h>
+#include <doca_dev.h>
+#include <doca_error.h>
+#include <doca_mmap.h>
+
+#include "astraea_ctx.h"
+#include "astraea_ec.h"
+#include "astraea_pe.h"
+#include "resource_mgmt.h"
+
+constexpr uint32_t MAX_NB_EC_TASKS = 8192;
+constexpr uint32_t MAX_NB_PES = 64;
+
+struct ec_create_mt_config {
+    /* Rounds run with 1, 2, 4, ... pes up to nb_pes */
+    uint32_t nb_pes;
+    uint32_t nb_data_blocks;
+    uint32_t nb_rdnc_blocks;
+    size_t block_size;
+    /* Tasks encoded by each pe and tasks each pe keeps in flight */
+    uint32_t nb_tasks;
+    uint32_t queue_depth;
+    uint32_t latency;
+    bool inline_submit;
+};
+
+struct ec_create_mt_worker;
+
+/* Task user data, a slot owns one dst buf */
+struct ec_create_mt_slot {
+    ec_create_mt_worker *worker;
+    uint32_t id;
+};
+
+/**
+ * Everything one thread drives: its own pe, ec ctx and buffers
+ * Only the device and the session are shared between workers
+ */
+struct ec_create_mt_worker {
+    doca_dev *dev = nullptr;
+    astraea_session *session = nullptr;
+
+    astraea_pe *pe = nullptr;
+    astraea_ec *ec = nullptr;
+    astraea_ctx *ctx = nullptr;
+    astraea_ec_matrix *matrix = nullptr;
+
+    doca_mmap *mmap = nullptr;
+    void *mmap_buffer = nullptr;
+    doca_buf_inventory *buf_inventory = nullptr;
+    doca_buf *src_buf = nullptr;
+    std::vector<doca_buf *> dst_bufs;
+    std::vector<ec_create_mt_slot> slots;
+
+    uint32_t nb_tasks = 0;
+    uint32_t nb_submitted = 0;
+    uint32_t nb_finished = 0;
+    uint32_t nb_failed = 0;
+
+    ~ec_create_mt_worker();
+
+    doca_error_t setup(const ec_create_mt_config &cfg);
+
+    doca_error_t submit(uint32_t slot_id);
+
+    doca_error_t run();
+};
+
+doca_error_t ec_create_mt(const ec_create_mt_config &cfg,
+                          astraea_session *session);
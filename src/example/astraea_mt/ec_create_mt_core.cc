@@ -0,0 +1,408 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <latch>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <doca_buf.h>
+#include <doca_buf_inventory.h>
+#include <doca_dev.h>
+#include <doca_error.h>
+#include <doca_log.h>
+#include <doca_mmap.h>
+#include <doca_types.h>
+
+#include "astraea_ctx.h"
+#include "astraea_ec.h"
+#include "astraea_pe.h"
+#include "resource_mgmt.h"
+
+#include "ec_create_mt.h"
+
+DOCA_LOG_REGISTER(EC_CREATE_MT : CORE);
+
+static void mock_data(void *buffer, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        *(static_cast<uint8_t *>(buffer) + i) = i;
+    }
+}
+
+static void ec_create_mt_success_cb(astraea_ec_task_create *task,
+                                    doca_data task_user_data,
+                                    doca_data ctx_user_data) {
+    (void)task;
+    (void)ctx_user_data;
+
+    ec_create_mt_slot *slot =
+        static_cast<ec_create_mt_slot *>(task_user_data.ptr);
+    ec_create_mt_worker *worker = slot->worker;
+
+    if (++worker->nb_finished == worker->nb_tasks) {
+        return;
+    }
+
+    /* Keep the slot busy until every task of this worker is submitted */
+    if (worker->nb_submitted < worker->nb_tasks &&
+        worker->submit(slot->id) != DOCA_SUCCESS) {
+        /* Drain what is in flight and report the failure */
+        worker->nb_tasks = worker->nb_submitted;
+        worker->nb_failed++;
+    }
+}
+
+static void ec_create_mt_error_cb(astraea_ec_task_create *task,
+                                  doca_data task_user_data,
+                                  doca_data ctx_user_data) {
+    ec_create_mt_slot *slot =
+        static_cast<ec_create_mt_slot *>(task_user_data.ptr);
+    slot->worker->nb_failed++;
+    DOCA_LOG_ERR("EC create task failed");
+    ec_create_mt_success_cb(task, task_user_data, ctx_user_data);
+}
+
+ec_create_mt_worker::~ec_create_mt_worker() {
+    /* Destroy ec related resources */
+    if (ctx) {
+        doca_error_t status = astraea_ctx_stop(ctx);
+        /**
+         * Make sure to finish the last inflight task
+         * before destroy ec and pe
+         */
+        while (status == DOCA_ERROR_IN_PROGRESS) {
+            (void)astraea_pe_progress(pe);
+            status = astraea_ctx_stop(ctx);
+        }
+    }
+    if (matrix)
+        astraea_ec_matrix_destroy(matrix);
+    if (ec)
+        astraea_ec_destroy(ec);
+
+    /* Destroy bufs, inventory and mmap */
+    for (doca_buf *dst_buf : dst_bufs)
+        doca_buf_dec_refcount(dst_buf, nullptr);
+    if (src_buf)
+        doca_buf_dec_refcount(src_buf, nullptr);
+    if (buf_inventory)
+        doca_buf_inventory_destroy(buf_inventory);
+    if (mmap)
+        doca_mmap_destroy(mmap);
+    if (mmap_buffer)
+        free(mmap_buffer);
+
+    /* Destroy pe */
+    if (pe)
+        astraea_pe_destroy(pe);
+}
+
+doca_error_t ec_create_mt_worker::setup(const ec_create_mt_config &cfg) {
+    doca_error_t status;
+
+    nb_tasks = cfg.nb_tasks;
+
+    status = astraea_pe_create(&pe);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create pe: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    /* Every worker draws from the token bucket of the same session */
+    status = astraea_ec_create(session, dev, &ec);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create ec: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = astraea_ec_task_create_set_conf(ec, ec_create_mt_success_cb,
+                                             ec_create_mt_error_cb,
+                                             MAX_NB_EC_TASKS);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set ec create task conf: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    ctx = astraea_ec_as_ctx(ec);
+    if (!ctx) {
+        DOCA_LOG_ERR("Failed to convert ec to ctx");
+        return DOCA_ERROR_UNEXPECTED;
+    }
+
+    status = astraea_ctx_set_inline_submit(ctx, cfg.inline_submit);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set submit mode: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = astraea_pe_connect_ctx(pe, ctx);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to connect pe to ctx: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = astraea_ctx_start(ctx);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start ctx: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = astraea_ec_matrix_create(ec, ASTRAEA_EC_MATRIX_TYPE_CAUCHY,
+                                      cfg.nb_data_blocks, cfg.nb_rdnc_blocks,
+                                      &matrix);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create ec matrix: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    /* One source shared by all slots, one parity area per slot */
+    status = doca_mmap_create(&mmap);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create mmap: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_mmap_add_dev(mmap, dev);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to add dev: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    const size_t data_buf_size = cfg.nb_data_blocks * cfg.block_size;
+    const size_t rdnc_buf_size = cfg.nb_rdnc_blocks * cfg.block_size;
+    const size_t mmap_size = data_buf_size + rdnc_buf_size * cfg.queue_depth;
+
+    int ret = posix_memalign(&mmap_buffer, 64, mmap_size);
+    if (ret) {
+        DOCA_LOG_ERR("Failed to alloc memory for mmap");
+        mmap_buffer = nullptr;
+        return DOCA_ERROR_NO_MEMORY;
+    }
+    mock_data(mmap_buffer, data_buf_size);
+
+    status = doca_mmap_set_memrange(mmap, mmap_buffer, mmap_size);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set memrange: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_mmap_start(mmap);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start mmap: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_buf_inventory_create(1 + cfg.queue_depth, &buf_inventory);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create buf inventory: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_buf_inventory_start(buf_inventory);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start buf inventory: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_buf_inventory_buf_get_by_addr(
+        buf_inventory, mmap, mmap_buffer, data_buf_size, &src_buf);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to alloc buf for data blocks: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_buf_set_data(src_buf, mmap_buffer, data_buf_size);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set data data: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    slots.resize(cfg.queue_depth);
+    for (uint32_t i = 0; i < cfg.queue_depth; i++) {
+        doca_buf *dst_buf;
+        status = doca_buf_inventory_buf_get_by_addr(
+            buf_inventory, mmap,
+            static_cast<uint8_t *>(mmap_buffer) + data_buf_size +
+                i * rdnc_buf_size,
+            rdnc_buf_size, &dst_buf);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to alloc buf for rdnc blocks: %s",
+                         doca_error_get_descr(status));
+            return status;
+        }
+        dst_bufs.push_back(dst_buf);
+        slots[i] = {.worker = this, .id = i};
+    }
+
+    return DOCA_SUCCESS;
+}
+
+doca_error_t ec_create_mt_worker::submit(uint32_t slot_id) {
+    astraea_ec_task_create *task;
+    doca_error_t status = astraea_ec_task_create_allocate_init(
+        ec, matrix, mmap, src_buf, mmap, dst_bufs[slot_id],
+        {.ptr = &slots[slot_id]}, &task);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to allocate and init ec task: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = astraea_task_submit(astraea_ec_task_create_as_task(task));
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to submit task: %s", doca_error_get_descr(status));
+        astraea_task_free(astraea_ec_task_create_as_task(task));
+        return status;
+    }
+    nb_submitted++;
+    return DOCA_SUCCESS;
+}
+
+doca_error_t ec_create_mt_worker::run() {
+    const uint32_t nb_slots = slots.size();
+    for (uint32_t i = 0; i < nb_slots && nb_submitted < nb_tasks; i++) {
+        doca_error_t status = submit(i);
+        if (status != DOCA_SUCCESS) {
+            return status;
+        }
+    }
+
+    while (nb_finished < nb_tasks) {
+        (void)astraea_pe_progress(pe);
+    }
+    return nb_failed == 0 ? DOCA_SUCCESS : DOCA_ERROR_IO_FAILED;
+}
+
+static doca_error_t open_dev(doca_dev **dev) {
+    doca_devinfo **devinfo_list;
+    uint32_t nb_devs;
+
+    doca_error_t status = doca_devinfo_create_list(&devinfo_list, &nb_devs);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create devinfo list: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    /* Simply choose the first device, that should work */
+    status = doca_dev_open(devinfo_list[0], dev);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to open dev: %s", doca_error_get_descr(status));
+    }
+
+    doca_devinfo_destroy_list(devinfo_list);
+    return status;
+}
+
+/**
+ * Encode cfg.nb_tasks tasks on each of nb_pes threads
+ * The clock starts once every worker is set up and stops when the last one
+ * finishes
+ */
+static doca_error_t run_round(const ec_create_mt_config &cfg,
+                              astraea_session *session, doca_dev *dev,
+                              uint32_t nb_pes) {
+    std::vector<std::unique_ptr<ec_create_mt_worker>> workers;
+    std::vector<doca_error_t> statuses(nb_pes, DOCA_SUCCESS);
+    std::vector<std::chrono::high_resolution_clock::time_point> end_times(
+        nb_pes);
+    for (uint32_t i = 0; i < nb_pes; i++) {
+        workers.push_back(std::make_unique<ec_create_mt_worker>());
+        workers[i]->dev = dev;
+        workers[i]->session = session;
+    }
+
+    std::latch ready(nb_pes);
+    std::latch go(1);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < nb_pes; i++) {
+        threads.emplace_back([&, i] {
+            ec_create_mt_worker *worker = workers[i].get();
+            statuses[i] = worker->setup(cfg);
+            ready.count_down();
+            go.wait();
+            if (statuses[i] == DOCA_SUCCESS) {
+                statuses[i] = worker->run();
+            }
+            end_times[i] = std::chrono::high_resolution_clock::now();
+            /* The pe and its ctx are torn down by the thread driving them */
+            workers[i].reset();
+        });
+    }
+
+    ready.wait();
+    const auto begin_time = std::chrono::high_resolution_clock::now();
+    go.count_down();
+
+    for (uint32_t i = 0; i < nb_pes; i++) {
+        threads[i].join();
+    }
+
+    doca_error_t status = DOCA_SUCCESS;
+    auto end_time = begin_time;
+    for (uint32_t i = 0; i < nb_pes; i++) {
+        if (statuses[i] != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Worker %u failed: %s", i,
+                         doca_error_get_descr(statuses[i]));
+            status = statuses[i];
+        }
+        if (end_times[i] > end_time) {
+            end_time = end_times[i];
+        }
+    }
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
+
+    const double time_cost_in_s =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end_time -
+                                                             begin_time)
+            .count() /
+        (double)1000000000;
+    const uint64_t nb_total_tasks = uint64_t{nb_pes} * cfg.nb_tasks;
+    const double data_size =
+        (double)nb_total_tasks * cfg.nb_data_blocks * cfg.block_size;
+    printf("%u,%lu,%f,%f,%f\n", nb_pes, nb_total_tasks,
+           time_cost_in_s * 1000, nb_total_tasks / time_cost_in_s,
+           data_size * 8 / time_cost_in_s / 1e9);
+    return DOCA_SUCCESS;
+}
+
+doca_error_t ec_create_mt(const ec_create_mt_config &cfg,
+                          astraea_session *session) {
+    doca_dev *dev = nullptr;
+    doca_error_t status = open_dev(&dev);
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
+
+    printf("nb_pes,nb_tasks,time_ms,tasks_per_s,data_gbps\n");
+    for (uint32_t nb_pes = 1;; nb_pes *= 2) {
+        if (nb_pes > cfg.nb_pes) {
+            nb_pes = cfg.nb_pes;
+        }
+
+        status = run_round(cfg, session, dev, nb_pes);
+        if (status != DOCA_SUCCESS) {
+            break;
+        }
+
+        if (nb_pes == cfg.nb_pes) {
+            break;
+        }
+    }
+
+    doca_dev_close(dev);
+    return status;
+}
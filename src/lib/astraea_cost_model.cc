@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <doca_error.h>
+#include <doca_log.h>
+
+#include "astraea_cost_model.h"
+
+DOCA_LOG_REGISTER(ASTRAEA : COST_MODEL);
+
+/* Fit of the first device Astraea was profiled on */
+static double builtin_time_us(uint32_t nb_data_blocks, uint32_t nb_rdnc_blocks,
+                              size_t block_size) {
+    /* This formula is derived from logarithmic fitting */
+    const double time_us = (2.82268116e-04 * nb_data_blocks + 2.55153425e-03) *
+                           (2.08178676e-03 * nb_rdnc_blocks + 6.82958278e-02) *
+                           (1.64268580e+00 * block_size - 7.53855770e+03);
+    return time_us > 0 ? time_us : 0;
+}
+
+/* (k, m, block size) */
+using cost_key = std::tuple<uint32_t, uint32_t, size_t>;
+
+/* Measurements of one matrix type, summed time and count per key */
+struct cost_table {
+    std::map<cost_key, std::pair<double, uint32_t>> samples;
+    std::vector<uint32_t> ks, ms;
+    std::vector<size_t> block_sizes;
+    /* Mean time of every axis combination, block size varies fastest */
+    std::vector<double> times_us;
+};
+
+/**
+ * Find the measured points around x and the weight of the upper one
+ * Outside the measured range the nearest point is used as is
+ */
+template <typename T>
+static void bracket(const std::vector<T> &axis, double x, uint32_t *lo,
+                    uint32_t *hi, double *weight) {
+    auto it = std::lower_bound(axis.begin(), axis.end(), x);
+    if (it == axis.begin()) {
+        *lo = *hi = 0;
+        *weight = 0;
+        return;
+    }
+    if (it == axis.end()) {
+        *lo = *hi = axis.size() - 1;
+        *weight = 0;
+        return;
+    }
+    *hi = it - axis.begin();
+    *lo = *hi - 1;
+    *weight = (x - static_cast<double>(axis[*lo])) /
+              static_cast<double>(axis[*hi] - axis[*lo]);
+}
+
+/* Lay the samples out densely, every combination must be measured */
+static doca_error_t densify(cost_table *table, const char *type) {
+    table->times_us.clear();
+    for (uint32_t k : table->ks) {
+        for (uint32_t m : table->ms) {
+            for (size_t block_size : table->block_sizes) {
+                auto it = table->samples.find({k, m, block_size});
+                if (it == table->samples.end()) {
+                    DOCA_LOG_ERR("Calibration of %s misses k = %u, m = %u, "
+                                 "block size = %lu",
+                                 type, k, m, block_size);
+                    return DOCA_ERROR_INVALID_VALUE;
+                }
+                table->times_us.push_back(it->second.first /
+                                          it->second.second);
+            }
+        }
+    }
+    return DOCA_SUCCESS;
+}
+
+static inline double table_time_us(const cost_table &table, uint32_t ki,
+                                   uint32_t mi, uint32_t bi) {
+    return table.times_us[(static_cast<size_t>(ki) * table.ms.size() + mi) *
+                              table.block_sizes.size() +
+                          bi];
+}
+
+/* Trilinear interpolation, linear extrapolation past the largest block */
+static double interpolate(const cost_table &table, uint32_t nb_data_blocks,
+                          uint32_t nb_rdnc_blocks, size_t block_size) {
+    uint32_t k0, k1, m0, m1, b0, b1;
+    double kw, mw, bw;
+    bracket(table.ks, nb_data_blocks, &k0, &k1, &kw);
+    bracket(table.ms, nb_rdnc_blocks, &m0, &m1, &mw);
+    bracket(table.block_sizes, static_cast<double>(block_size), &b0, &b1,
+            &bw);
+
+    auto at_block = [&](uint32_t bi) {
+        const double t00 = table_time_us(table, k0, m0, bi);
+        const double t01 = table_time_us(table, k0, m1, bi);
+        const double t10 = table_time_us(table, k1, m0, bi);
+        const double t11 = table_time_us(table, k1, m1, bi);
+        const double t0 = t00 + (t01 - t00) * mw;
+        const double t1 = t10 + (t11 - t10) * mw;
+        return t0 + (t1 - t0) * kw;
+    };
+
+    double time_us = at_block(b0) + (at_block(b1) - at_block(b0)) * bw;
+    const size_t max_block_size = table.block_sizes.back();
+    if (block_size > max_block_size) {
+        time_us *= static_cast<double>(block_size) / max_block_size;
+    }
+    return time_us;
+}
+
+/**
+ * k to read a borrowed encoding cost at
+ * An update reads the old and new copy of each changed block and the parity
+ */
+static uint32_t borrowed_nb_data_blocks(uint32_t type, uint32_t nb_data_blocks,
+                                        uint32_t nb_rdnc_blocks) {
+    if (type != ASTRAEA_COST_MATRIX_UPDATE) {
+        return nb_data_blocks;
+    }
+    const uint32_t nb_read_blocks = 2 * nb_data_blocks + nb_rdnc_blocks;
+    return nb_read_blocks < COST_MODEL_MAX_NB_DATA_BLOCKS
+               ? nb_read_blocks
+               : COST_MODEL_MAX_NB_DATA_BLOCKS;
+}
+
+static void fill_grid(astraea_cost_model *model, uint32_t type,
+                      const cost_table &table, bool is_borrowed) {
+    for (uint32_t k = 1; k <= COST_MODEL_MAX_NB_DATA_BLOCKS; k++) {
+        for (uint32_t m = 1; m <= COST_MODEL_MAX_NB_RDNC_BLOCKS; m++) {
+            const uint32_t table_k =
+                is_borrowed ? borrowed_nb_data_blocks(type, k, m) : k;
+            for (uint32_t bin = 0; bin < COST_MODEL_NB_BLOCK_BINS; bin++) {
+                const size_t block_size = size_t{1}
+                                          << (COST_MODEL_MIN_BLOCK_SHIFT + bin);
+                model->grid[astraea_cost_model_grid_index(type, k, m, bin)] =
+                    interpolate(table, table_k, m, block_size);
+            }
+        }
+    }
+}
+
+static doca_error_t parse_table(const char *path, cost_table *tables) {
+    std::ifstream file(path);
+    if (!file) {
+        DOCA_LOG_ERR("Failed to open calibration table %s", path);
+        return DOCA_ERROR_NOT_FOUND;
+    }
+
+    std::string line;
+    uint32_t line_no = 0;
+    while (std::getline(file, line)) {
+        line_no++;
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream fields(line);
+        std::string type_name;
+        if (!(fields >> type_name) || type_name[0] == '#' ||
+            type_name == "matrix_type") {
+            continue;
+        }
+
+        uint32_t type = 0;
+        while (type < ASTRAEA_COST_NB_MATRIX_TYPES &&
+               type_name != COST_MATRIX_TYPE_NAMES[type]) {
+            type++;
+        }
+        if (type == ASTRAEA_COST_NB_MATRIX_TYPES) {
+            DOCA_LOG_ERR("%s:%u: unknown matrix type %s", path, line_no,
+                         type_name.c_str());
+            return DOCA_ERROR_INVALID_VALUE;
+        }
+
+        uint32_t k, m;
+        size_t block_size;
+        double time_us;
+        if (!(fields >> k >> m >> block_size >> time_us) || k == 0 || m == 0 ||
+            block_size == 0 || time_us <= 0) {
+            DOCA_LOG_ERR("%s:%u: malformed measurement", path, line_no);
+            return DOCA_ERROR_INVALID_VALUE;
+        }
+
+        auto &sample = tables[type].samples[{k, m, block_size}];
+        sample.first += time_us;
+        sample.second++;
+    }
+
+    for (uint32_t type = 0; type < ASTRAEA_COST_NB_MATRIX_TYPES; type++) {
+        cost_table &table = tables[type];
+        for (const auto &[key, sample] : table.samples) {
+            table.ks.push_back(std::get<0>(key));
+            table.ms.push_back(std::get<1>(key));
+            table.block_sizes.push_back(std::get<2>(key));
+        }
+        for (auto *axis : {&table.ks, &table.ms}) {
+            std::sort(axis->begin(), axis->end());
+            axis->erase(std::unique(axis->begin(), axis->end()), axis->end());
+        }
+        std::sort(table.block_sizes.begin(), table.block_sizes.end());
+        table.block_sizes.erase(
+            std::unique(table.block_sizes.begin(), table.block_sizes.end()),
+            table.block_sizes.end());
+    }
+    return DOCA_SUCCESS;
+}
+
+static doca_error_t load(const char *path,
+                         std::unique_ptr<astraea_cost_model> *model) {
+    cost_table tables[ASTRAEA_COST_NB_MATRIX_TYPES];
+    doca_error_t status = parse_table(path, tables);
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
+
+    int32_t fallback = -1;
+    for (uint32_t type = 0; type < ASTRAEA_COST_NB_MATRIX_TYPES; type++) {
+        if (tables[type].samples.empty()) {
+            continue;
+        }
+        status = densify(&tables[type], COST_MATRIX_TYPE_NAMES[type]);
+        if (status != DOCA_SUCCESS) {
+            return status;
+        }
+        if (fallback < 0) {
+            fallback = type;
+        }
+    }
+    if (fallback < 0) {
+        DOCA_LOG_ERR("Calibration table %s has no measurement", path);
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+
+    auto new_model = std::make_unique<astraea_cost_model>();
+    new_model->source = path;
+    new_model->grid.resize(ASTRAEA_COST_NB_MATRIX_TYPES *
+                           COST_MODEL_MAX_NB_DATA_BLOCKS *
+                           COST_MODEL_MAX_NB_RDNC_BLOCKS *
+                           COST_MODEL_NB_BLOCK_BINS);
+    for (uint32_t type = 0; type < ASTRAEA_COST_NB_MATRIX_TYPES; type++) {
+        const bool is_borrowed = tables[type].samples.empty();
+        fill_grid(new_model.get(), type,
+                  is_borrowed ? tables[fallback] : tables[type], is_borrowed);
+    }
+
+    const double base_time_us = astraea_cost_model_time_us(
+        new_model.get(), ASTRAEA_COST_MATRIX_CAUCHY,
+        COST_MODEL_BASE_NB_DATA_BLOCKS, COST_MODEL_BASE_NB_RDNC_BLOCKS,
+        COST_MODEL_BASE_BLOCK_SIZE);
+    if (base_time_us <= 0) {
+        DOCA_LOG_ERR("Calibration table %s predicts no time for the base task",
+                     path);
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+
+    DOCA_LOG_INFO("Loaded cost model %s, base task takes %fus (%.2f tokens)",
+                  path, base_time_us, base_time_us / COST_MODEL_TOKEN_TIME_US);
+    *model = std::move(new_model);
+    return DOCA_SUCCESS;
+}
+
+/* Models live until the process exits, ecs only keep raw pointers */
+static std::mutex models_lock;
+static std::map<std::string, std::unique_ptr<astraea_cost_model>> models;
+
+doca_error_t astraea_cost_model_get(const char *path,
+                                    const astraea_cost_model **model) {
+    std::lock_guard<std::mutex> guard(models_lock);
+    auto it = models.find(path);
+    if (it == models.end()) {
+        std::unique_ptr<astraea_cost_model> new_model;
+        doca_error_t status = load(path, &new_model);
+        if (status != DOCA_SUCCESS) {
+            return status;
+        }
+        it = models.emplace(path, std::move(new_model)).first;
+    }
+    *model = it->second.get();
+    return DOCA_SUCCESS;
+}
+
+static astraea_cost_model make_builtin() {
+    astraea_cost_model model;
+    model.source = "builtin";
+    model.grid.resize(ASTRAEA_COST_NB_MATRIX_TYPES *
+                      COST_MODEL_MAX_NB_DATA_BLOCKS *
+                      COST_MODEL_MAX_NB_RDNC_BLOCKS * COST_MODEL_NB_BLOCK_BINS);
+
+    /* The fit does not depend on the matrix type, only on the blocks read */
+    for (uint32_t type = 0; type < ASTRAEA_COST_NB_MATRIX_TYPES; type++) {
+        for (uint32_t k = 1; k <= COST_MODEL_MAX_NB_DATA_BLOCKS; k++) {
+            for (uint32_t m = 1; m <= COST_MODEL_MAX_NB_RDNC_BLOCKS; m++) {
+                const uint32_t fit_k = borrowed_nb_data_blocks(type, k, m);
+                for (uint32_t bin = 0; bin < COST_MODEL_NB_BLOCK_BINS; bin++) {
+                    const size_t block_size =
+                        size_t{1} << (COST_MODEL_MIN_BLOCK_SHIFT + bin);
+                    model.grid[astraea_cost_model_grid_index(type, k, m,
+                                                             bin)] =
+                        builtin_time_us(fit_k, m, block_size);
+                }
+            }
+        }
+    }
+    return model;
+}
+
+const astraea_cost_model *astraea_cost_model_builtin() {
+    static const astraea_cost_model builtin = make_builtin();
+    return &builtin;
+}
@@ -0,0 +1,140 @@
+#ifndef ASTRAEA_COST_MODEL_H__
+#define ASTRAEA_COST_MODEL_H__
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <doca_error.h>
+
+/* Environment variable naming the calibration table of new ecs */
+constexpr const char *COST_MODEL_ENV = "ASTRAEA_COST_MODEL";
+
+/**
+ * Recover prices k available blocks against m recovered blocks, update
+ * prices k changed data blocks against m parity blocks
+ */
+enum astraea_cost_matrix_type {
+    ASTRAEA_COST_MATRIX_CAUCHY,
+    ASTRAEA_COST_MATRIX_VANDERMONDE,
+    ASTRAEA_COST_MATRIX_RECOVER,
+    ASTRAEA_COST_MATRIX_UPDATE,
+    ASTRAEA_COST_NB_MATRIX_TYPES,
+};
+
+/* Names of the types in calibration tables */
+constexpr const char *COST_MATRIX_TYPE_NAMES[ASTRAEA_COST_NB_MATRIX_TYPES] = {
+    "cauchy", "vandermonde", "recover", "update"};
+
+/* Grid axes, k and m are exact, block sizes are powers of two */
+constexpr uint32_t COST_MODEL_MAX_NB_DATA_BLOCKS = 128;
+constexpr uint32_t COST_MODEL_MAX_NB_RDNC_BLOCKS = 32;
+constexpr uint32_t COST_MODEL_MIN_BLOCK_SHIFT = 9;
+constexpr uint32_t COST_MODEL_MAX_BLOCK_SHIFT = 24;
+constexpr uint32_t COST_MODEL_NB_BLOCK_BINS =
+    COST_MODEL_MAX_BLOCK_SHIFT - COST_MODEL_MIN_BLOCK_SHIFT + 1;
+
+/**
+ * Device time a token stands for, the same for every model so that the
+ * tokens the scheduler hands out each ms mean the same whatever table an
+ * ec loaded. MAX_TOKENS_PER_MS of the scheduler is sized in this unit
+ */
+constexpr double COST_MODEL_TOKEN_TIME_US = 73.672188;
+
+/* Reference task a loaded table is checked and logged against */
+constexpr uint32_t COST_MODEL_BASE_NB_DATA_BLOCKS = 128;
+constexpr uint32_t COST_MODEL_BASE_NB_RDNC_BLOCKS = 32;
+constexpr size_t COST_MODEL_BASE_BLOCK_SIZE = 8192;
+
+/**
+ * Predicted time of an ec create task on one device
+ *
+ * The calibration table is interpolated once into a dense grid over
+ * (matrix type, k, m, log2 block size), lookups only read two cells.
+ * Models are immutable and shared by every ec that loaded the same file.
+ */
+struct astraea_cost_model {
+    /* Path of the table, or "builtin" for the fit shipped with the library */
+    std::string source;
+    /* Task time in us, see grid_index */
+    std::vector<float> grid;
+};
+
+/**
+ * Return the model built from the table at path, loading it on first use
+ *
+ * The table has one measurement per line, fields separated by spaces or
+ * commas:
+ *     matrix_type nb_data_blocks nb_rdnc_blocks block_size time_us
+ * with matrix_type "cauchy", "vandermonde", "recover" or "update". Lines
+ * starting with '#' and a header line are skipped. Each matrix type present
+ * must cover every combination of the k, m and block sizes it lists, a
+ * missing type borrows cauchy, or the first type present. A borrowed update
+ * of k blocks is priced as encoding the 2k + m blocks it reads.
+ */
+doca_error_t astraea_cost_model_get(const char *path,
+                                    const astraea_cost_model **model);
+
+/* The logarithmic fit the library used before calibration tables */
+const astraea_cost_model *astraea_cost_model_builtin();
+
+static inline size_t
+astraea_cost_model_grid_index(uint32_t type, uint32_t nb_data_blocks,
+                              uint32_t nb_rdnc_blocks, uint32_t block_bin) {
+    return ((static_cast<size_t>(type) * COST_MODEL_MAX_NB_DATA_BLOCKS +
+             (nb_data_blocks - 1)) *
+                COST_MODEL_MAX_NB_RDNC_BLOCKS +
+            (nb_rdnc_blocks - 1)) *
+               COST_MODEL_NB_BLOCK_BINS +
+           block_bin;
+}
+
+/**
+ * Predicted task time in us
+ * Block sizes between two powers of two are interpolated linearly, sizes
+ * past the grid scale with the largest bin
+ */
+static inline double astraea_cost_model_time_us(const astraea_cost_model *model,
+                                                uint32_t type,
+                                                uint32_t nb_data_blocks,
+                                                uint32_t nb_rdnc_blocks,
+                                                size_t block_size) {
+    if (nb_data_blocks > COST_MODEL_MAX_NB_DATA_BLOCKS) {
+        nb_data_blocks = COST_MODEL_MAX_NB_DATA_BLOCKS;
+    }
+    if (nb_rdnc_blocks > COST_MODEL_MAX_NB_RDNC_BLOCKS) {
+        nb_rdnc_blocks = COST_MODEL_MAX_NB_RDNC_BLOCKS;
+    }
+    const size_t index = astraea_cost_model_grid_index(
+        type, nb_data_blocks ? nb_data_blocks : 1,
+        nb_rdnc_blocks ? nb_rdnc_blocks : 1, 0);
+    const float *bins = &model->grid[index];
+
+    const uint32_t shift = std::bit_width(block_size) - 1;
+    if (block_size == 0 || shift < COST_MODEL_MIN_BLOCK_SHIFT) {
+        return bins[0];
+    }
+    if (shift >= COST_MODEL_MAX_BLOCK_SHIFT) {
+        return bins[COST_MODEL_NB_BLOCK_BINS - 1] *
+               (static_cast<double>(block_size) /
+                (size_t{1} << COST_MODEL_MAX_BLOCK_SHIFT));
+    }
+
+    const uint32_t bin = shift - COST_MODEL_MIN_BLOCK_SHIFT;
+    const size_t low = size_t{1} << shift;
+    const double weight = static_cast<double>(block_size - low) / low;
+    return bins[bin] + (bins[bin + 1] - bins[bin]) * weight;
+}
+
+/* Tokens a task costs, see COST_MODEL_TOKEN_TIME_US */
+static inline uint32_t astraea_cost_model_tokens(
+    const astraea_cost_model *model, uint32_t type, uint32_t nb_data_blocks,
+    uint32_t nb_rdnc_blocks, size_t block_size) {
+    return astraea_cost_model_time_us(model, type, nb_data_blocks,
+                                      nb_rdnc_blocks, block_size) /
+           COST_MODEL_TOKEN_TIME_US;
+}
+
+#endif
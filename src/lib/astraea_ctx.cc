@@ -1,10 +1,11 @@
-#include <chrono>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <mutex>
 #include <semaphore.h>
 #include <stop_token>
 #include <thread>
+#include <time.h>
 
 #include <doca_ctx.h>
 #include <doca_error.h>
@@ -12,80 +13,425 @@
 #include <doca_pe.h>
 
 #include "astraea_ctx.h"
+#include "astraea_doorbell.h"
 #include "astraea_ec.h"
 #include "doca_erasure_coding.h"
 #include "resource_mgmt.h"
 
 DOCA_LOG_REGISTER(ASTRAEA : CTX);
 
-extern sem_t *ec_token_sem;
-extern shared_resources *shm_data;
-extern uint32_t app_id;
+static inline astraea_session *ctx_session(astraea_ctx *ctx) {
+    switch (ctx->type) {
+    case EC:
+        return ctx->ec->session;
+    }
+    return nullptr;
+}
 
-static void worker(std::stop_token stoken, astraea_ctx *ctx) {
-    while (!stoken.stop_requested()) {
-        switch (ctx->type) {
-        case EC:
-            astraea_ec *ec = ctx->ec;
-            uint32_t nb_submitted_tasks = 0;
-            uint32_t nb_avail_tokens = 0;
+static inline uint32_t load_token_epoch(astraea_session *session) {
+    return std::atomic_ref<uint32_t>(session->shm_data->token_epoch)
+        .load(std::memory_order_acquire);
+}
 
-            /* Get avail tokens */
-            if (sem_wait(ec_token_sem)) {
-                DOCA_LOG_ERR("Failed to get ec_token_sem");
-                break;
-            }
+/**
+ * Give back tokens reserved for strips that were not submitted
+ * A refresh since the reservation already refilled the bucket, the tokens
+ * are dropped then instead of going over what the scheduler allocated
+ */
+static void refund_tokens(astraea_ctx *ctx, uint32_t nb_tokens,
+                          uint32_t reserve_epoch) {
+    astraea_session *session = ctx_session(ctx);
+    if (sem_wait(session->ec_token_sem)) {
+        DOCA_LOG_ERR("Failed to get ec_token_sem");
+        return;
+    }
 
-            nb_avail_tokens = shm_data->ec_tokens[app_id];
+    const bool is_refunded = load_token_epoch(session) == reserve_epoch;
+    if (is_refunded) {
+        session->shm_data->ec_tokens[session->app_id] += nb_tokens;
+    }
 
-            if (sem_post(ec_token_sem)) {
-                DOCA_LOG_ERR("Failed to post ec_token_sem");
-                break;
-            }
+    if (sem_post(session->ec_token_sem)) {
+        DOCA_LOG_ERR("Failed to post ec_token_sem");
+    }
+    if (is_refunded) {
+        ctx->nb_refunded_tokens.fetch_add(nb_tokens,
+                                          std::memory_order_relaxed);
+    }
+}
+
+static void record_burst(astraea_ctx *ctx, uint32_t nb_submitted) {
+    uint32_t bucket = 0;
+    while (bucket < NB_SUBMIT_BATCH_BUCKETS - 1 &&
+           (2u << bucket) <= nb_submitted) {
+        bucket++;
+    }
+
+    ctx->nb_bursts.fetch_add(1, std::memory_order_relaxed);
+    ctx->nb_submitted.fetch_add(nb_submitted, std::memory_order_relaxed);
+    ctx->burst_size_hist[bucket].fetch_add(1, std::memory_order_relaxed);
+    if (nb_submitted > ctx->max_burst_size.load(std::memory_order_relaxed)) {
+        ctx->max_burst_size.store(nb_submitted, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Hand strips to the spillover workers of the ec while its bucket is empty,
+ * as many as finish before the scheduler refreshes it
+ * A refresh that is late or never happened spills nothing
+ */
+static uint32_t spill_ec_burst(astraea_ctx *ctx) {
+    astraea_ec *ec = ctx->ec;
+    if (ec->spillover == nullptr) {
+        return 0;
+    }
+
+    const uint64_t refresh_ns =
+        std::atomic_ref<uint64_t>(ec->session->shm_data->token_refresh_ns)
+            .load(std::memory_order_relaxed);
+    const uint64_t next_refresh_ns = refresh_ns + TOKEN_REFRESH_PERIOD_NS;
+    const uint64_t now_ns = astraea_now_ns();
+    if (refresh_ns == 0 || next_refresh_ns <= now_ns) {
+        return 0;
+    }
+    return astraea_ec_spill(
+        ec, next_refresh_ns - now_ns,
+        ctx->submit_batch_size.load(std::memory_order_relaxed));
+}
+
+/**
+ * Reserve tokens for up to a batch of queued strips in one critical section,
+ * submit them deferred and flush once. Each strip takes the tokens its task
+ * costs per strip, one dearer than what is left still goes out on credit
+ * Without tokens, strips may spill to the CPU instead. While DOCA refuses
+ * strips nothing is reserved, is_blocked is set until a strip comes back
+ * Return the number of strips handed to DOCA or spilled
+ */
+static uint32_t submit_ec_burst(astraea_ctx *ctx, bool *is_out_of_tokens,
+                                bool *is_blocked) {
+    astraea_ec *ec = ctx->ec;
+    astraea_session *session = ec->session;
+    *is_out_of_tokens = false;
+    *is_blocked = false;
+
+    /* Read before dispatching, a strip back since then may unblock DOCA */
+    const uint32_t return_seq =
+        ec->strip_return_seq.load(std::memory_order_acquire);
+    if (ctx->is_dispatch_blocked) {
+        if (return_seq == ctx->blocked_seq) {
+            *is_blocked = true;
+            return 0;
+        }
+        ctx->is_dispatch_blocked = false;
+        ec->is_dispatch_blocked.store(false, std::memory_order_relaxed);
+    }
+
+    const uint32_t nb_queued = astraea_ec_nb_queued_subtasks(ec);
+    if (nb_queued == 0) {
+        return 0;
+    }
+    const uint32_t batch_size =
+        ctx->submit_batch_size.load(std::memory_order_relaxed);
+    /* Tokens of about a batch, strips of different tasks cost differently */
+    uint64_t nb_wanted = astraea_ec_nb_queued_tokens(ec);
+    if (nb_queued > batch_size) {
+        nb_wanted = (nb_wanted * batch_size + nb_queued - 1) / nb_queued;
+    }
+    nb_wanted += ctx->token_debt;
 
-            ec->subtask_locks[ec->cons_pos].lock();
-            ec->subtask_locks[ec->cons_pos].unlock();
-
-            if (nb_avail_tokens > 0 && ec->cons_pos < ec->prod_pos) {
-
-                ctx->ctx_lock.lock();
-                doca_error_t status =
-                    doca_task_submit(doca_ec_task_create_as_task(
-                        ctx->ec->subtask_queue[ec->cons_pos]));
-
-                ctx->ctx_lock.unlock();
-                if (status == DOCA_SUCCESS) {
-                    ec->cons_pos++;
-                    nb_avail_tokens--;
-                    nb_submitted_tasks++;
-                } else {
-                    DOCA_LOG_ERR("Failed to submit sub task: %s",
-                                 doca_error_get_descr(status));
-                }
+    if (sem_wait(session->ec_token_sem)) {
+        DOCA_LOG_ERR("Failed to get ec_token_sem");
+        return 0;
+    }
+
+    /* The scheduler bumps it under the semaphore, see refund_tokens */
+    const uint32_t reserve_epoch = load_token_epoch(session);
+    uint32_t &nb_tokens = session->shm_data->ec_tokens[session->app_id];
+    const uint32_t nb_reserved =
+        nb_tokens < nb_wanted ? nb_tokens : static_cast<uint32_t>(nb_wanted);
+    nb_tokens -= nb_reserved;
+
+    if (sem_post(session->ec_token_sem)) {
+        DOCA_LOG_ERR("Failed to post ec_token_sem");
+    }
+
+    const uint64_t nb_repaid =
+        ctx->token_debt < nb_reserved ? ctx->token_debt : nb_reserved;
+    ctx->token_debt -= nb_repaid;
+    uint32_t nb_left = nb_reserved - nb_repaid;
+    if (nb_left == 0) {
+        *is_out_of_tokens = true;
+        return spill_ec_burst(ctx);
+    }
+
+    /**
+     * Inline ctxs are only touched by the thread calling pe progress
+     * Software ecs encode here and share no DOCA ctx with the pe, so the
+     * pe is not held off while they do
+     */
+    const bool needs_lock = !ctx->is_inline && !ec->is_software;
+    uint32_t nb_submitted = 0;
+    if (needs_lock) {
+        ctx->ctx_lock.lock();
+    }
+    while (nb_left > 0 && nb_submitted < batch_size) {
+        uint32_t subtask_id;
+        if (!astraea_ec_peek_subtask(ec, &subtask_id)) {
+            break;
+        }
+        /* Read before dispatching, the task may be reused once it is done */
+        const _astraea_ec_task *task =
+            ec->subtask_pool[subtask_id].user_data.origin_task;
+        const uint32_t token_cost = task->strip_token_cost;
+
+        doca_error_t status;
+        if (ec->is_software) {
+            status = astraea_ec_sw_submit(ec, subtask_id);
+        } else {
+            status = astraea_ec_arm_subtask(ec, subtask_id);
+            if (status == DOCA_SUCCESS) {
+                status = doca_task_submit_ex(
+                    ec->subtask_pool[subtask_id].task,
+                    DOCA_TASK_SUBMIT_FLAG_NONE);
             }
+        }
+        if (is_backpressure(status)) {
+            ctx->is_dispatch_blocked = true;
+            ctx->blocked_seq = return_seq;
+            break;
+        }
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to submit sub task: %s",
+                         doca_error_get_descr(status));
+            break;
+        }
+        astraea_ec_pop_subtask(ec);
+        nb_submitted++;
 
-            if (sem_wait(ec_token_sem)) {
-                DOCA_LOG_ERR("Failed to get ec_token_sem");
-                break;
+        /* The last reserved tokens start a dearer strip, the rest is owed */
+        if (token_cost > nb_left) {
+            ctx->token_debt += token_cost - nb_left;
+            nb_left = 0;
+        } else {
+            nb_left -= token_cost;
+        }
+    }
+
+    if (nb_submitted > 0 && !ec->is_software) {
+        doca_error_t status = doca_ctx_flush_tasks(ctx->ctx);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to flush sub tasks: %s",
+                         doca_error_get_descr(status));
+        }
+    }
+    if (needs_lock) {
+        ctx->ctx_lock.unlock();
+    }
+
+    if (ctx->is_dispatch_blocked) {
+        /* Pairs with the fence of completions, either side sees the other */
+        ec->is_dispatch_blocked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    if (nb_left > 0) {
+        refund_tokens(ctx, nb_left, reserve_epoch);
+    }
+    if (nb_submitted > 0) {
+        record_burst(ctx, nb_submitted);
+    }
+    return nb_submitted;
+}
+
+static inline void update_max(std::atomic<uint64_t> &max, uint64_t value) {
+    if (value > max.load(std::memory_order_relaxed)) {
+        max.store(value, std::memory_order_relaxed);
+    }
+}
+
+static void record_wakeup(astraea_ctx *ctx, std::atomic<uint64_t> &counter,
+                          uint64_t latency_ns) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+    ctx->total_wakeup_latency_ns.fetch_add(latency_ns,
+                                           std::memory_order_relaxed);
+    update_max(ctx->max_wakeup_latency_ns, latency_ns);
+}
+
+static void record_cpu_time(astraea_ctx *ctx) {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    ctx->cpu_ns.store(static_cast<uint64_t>(ts.tv_sec) * 1000000000 +
+                          ts.tv_nsec,
+                      std::memory_order_relaxed);
+}
+
+/**
+ * Park until a strip is queued or, when the queue is stuck on an empty
+ * bucket, until the scheduler refreshes tokens. A submitter DOCA refused
+ * parks until a strip comes back
+ * Return how long the submitter was parked
+ */
+static uint64_t park(astraea_ctx *ctx, astraea_doorbell *doorbell,
+                     bool is_out_of_tokens, bool is_blocked,
+                     uint32_t seen_seq, uint32_t seen_epoch) {
+    astraea_session *session = ctx_session(ctx);
+    const uint64_t begin_ns = astraea_now_ns();
+    ctx->nb_parks.fetch_add(1, std::memory_order_relaxed);
+
+    if (is_out_of_tokens) {
+        astraea_futex_wait(&session->shm_data->token_epoch, seen_epoch,
+                           TOKEN_PARK_TIMEOUT_NS, true);
+        if (load_token_epoch(session) != seen_epoch) {
+            const uint64_t refresh_ns =
+                std::atomic_ref<uint64_t>(session->shm_data->token_refresh_ns)
+                    .load(std::memory_order_relaxed);
+            const uint64_t now_ns = astraea_now_ns();
+            record_wakeup(ctx, ctx->nb_refill_wakeups,
+                          now_ns > refresh_ns ? now_ns - refresh_ns : 0);
+        }
+    } else {
+        doorbell->park(seen_seq, SUBMIT_PARK_TIMEOUT_NS, [ctx, is_blocked] {
+            if (is_blocked) {
+                return ctx->ec->strip_return_seq.load(
+                           std::memory_order_acquire) != ctx->blocked_seq;
+            }
+            return astraea_ec_get_queue_occupancy(ctx->ec) > 0;
+        });
+        if (doorbell->seq.load(std::memory_order_acquire) != seen_seq) {
+            /* The ring only stamps its time when it had to wake us up */
+            const uint64_t ring_ns =
+                doorbell->ring_time_ns.load(std::memory_order_relaxed);
+            const uint64_t now_ns = astraea_now_ns();
+            if (ring_ns >= begin_ns) {
+                record_wakeup(ctx, ctx->nb_submit_wakeups, now_ns - ring_ns);
             }
+        }
+    }
 
-            shm_data->ec_tokens[app_id] -= nb_submitted_tasks;
+    const uint64_t parked_ns = astraea_now_ns() - begin_ns;
+    ctx->parked_ns.fetch_add(parked_ns, std::memory_order_relaxed);
+    record_cpu_time(ctx);
+    return parked_ns;
+}
 
-            if (sem_post(ec_token_sem)) {
-                DOCA_LOG_ERR("Failed to post ec_token_sem");
+/**
+ * When there is nothing to submit, spin for an adaptive window watching for
+ * new strips or new tokens, then park
+ * A park shorter than the spin limit means spinning a bit longer would
+ * have caught the work, so the window grows, otherwise it shrinks
+ */
+static void worker(std::stop_token stoken, astraea_ctx *ctx) {
+    astraea_doorbell *doorbell = nullptr;
+    switch (ctx->type) {
+    case EC:
+        doorbell = &ctx->ec->doorbell;
+        break;
+    }
+
+    astraea_session *session = ctx_session(ctx);
+    std::stop_callback wake_on_stop(stoken, [doorbell, session] {
+        doorbell->ring();
+        astraea_futex_wake_all(&session->shm_data->token_epoch, true);
+    });
+
+    uint32_t spin_window_us = ctx->spin_window_us.load();
+    while (!stoken.stop_requested()) {
+        const uint32_t seen_seq = doorbell->seq.load(std::memory_order_acquire);
+        const uint32_t seen_epoch = load_token_epoch(session);
+
+        uint32_t nb_submitted = 0;
+        bool is_out_of_tokens = false;
+        bool is_blocked = false;
+        switch (ctx->type) {
+        case EC:
+            nb_submitted =
+                submit_ec_burst(ctx, &is_out_of_tokens, &is_blocked);
+            break;
+        }
+        if (nb_submitted > 0) {
+            continue;
+        }
+
+        /* Watch the words a park would wait on, no semaphore while spinning */
+        const uint64_t spin_begin_ns = astraea_now_ns();
+        const uint64_t spin_end_ns = spin_begin_ns + spin_window_us * 1000ull;
+        uint64_t now_ns = spin_begin_ns;
+        bool has_work = false;
+        while (now_ns < spin_end_ns && !stoken.stop_requested()) {
+            has_work = is_out_of_tokens
+                           ? load_token_epoch(session) != seen_epoch
+                           : doorbell->seq.load(std::memory_order_acquire) !=
+                                 seen_seq;
+            if (has_work) {
                 break;
             }
+            astraea_cpu_relax();
+            now_ns = astraea_now_ns();
+        }
+        ctx->spin_ns.fetch_add(now_ns - spin_begin_ns,
+                               std::memory_order_relaxed);
+        if (has_work || stoken.stop_requested()) {
+            continue;
+        }
+
+        const uint64_t parked_ns = park(ctx, doorbell, is_out_of_tokens,
+                                        is_blocked, seen_seq, seen_epoch);
+
+        const uint32_t max_spin_us =
+            ctx->max_spin_us.load(std::memory_order_relaxed);
+        if (parked_ns < max_spin_us * 1000ull) {
+            spin_window_us = spin_window_us ? spin_window_us * 2 : 1;
+        } else {
+            spin_window_us /= 2;
         }
-        std::this_thread::sleep_for(std::chrono::microseconds(1));
+        if (spin_window_us > max_spin_us) {
+            spin_window_us = max_spin_us;
+        }
+        ctx->spin_window_us.store(spin_window_us, std::memory_order_relaxed);
     }
+    record_cpu_time(ctx);
 }
 
 doca_error_t astraea_ctx_start(astraea_ctx *ctx) {
-    doca_error_t status = doca_ctx_start(ctx->ctx);
-    if (status != DOCA_SUCCESS) {
-        return status;
+    doca_error_t status;
+    if (ctx->type == EC) {
+        status = astraea_ec_prepare_scratch(ctx->ec);
+        if (status != DOCA_SUCCESS) {
+            return status;
+        }
+    }
+
+    /* Software ecs have no DOCA ctx to start */
+    if (ctx->ctx) {
+        status = doca_ctx_start(ctx->ctx);
+        if (status != DOCA_SUCCESS) {
+            return status;
+        }
+    }
+    if (ctx->type == EC) {
+        /* Matrices need a started ctx */
+        status = astraea_ec_prewarm_matrices(ctx->ec);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to prewarm ec matrices: %s",
+                         doca_error_get_descr(status));
+            if (ctx->ctx) {
+                doca_ctx_stop(ctx->ctx);
+            }
+            return status;
+        }
+
+        status = astraea_ec_start_spillover(ctx->ec);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to start spillover workers: %s",
+                         doca_error_get_descr(status));
+            if (ctx->ctx) {
+                doca_ctx_stop(ctx->ctx);
+            }
+            return status;
+        }
+    }
+    if (!ctx->is_inline) {
+        ctx->submitter = new std::jthread{worker, ctx};
     }
-    ctx->submitter = new std::jthread{worker, ctx};
     return status;
 }
 
@@ -97,28 +443,102 @@ doca_error_t astraea_ctx_stop(astraea_ctx *ctx) {
      */
     if (ctx->submitter) {
         ctx->submitter->request_stop();
-        if (ctx->type == EC) {
-            for (uint32_t i = ctx->ec->prod_pos; i < MAX_NB_INFLIGHT_EC_TASKS;
-                 i++) {
-                ctx->ec->subtask_locks[i].unlock();
-            }
-        }
         delete ctx->submitter;
         ctx->submitter = nullptr;
     }
 
+    /**
+     * Strips still waiting in the queue were never handed to DOCA
+     * The submitted ones come back to the idle list through their
+     * completion callbacks, the spilled ones complete here
+     */
     if (ctx->type == EC) {
-        for (uint32_t i = 0; i < MAX_NB_INFLIGHT_EC_TASKS; i++) {
-            astraea_ec_task_create *task = ctx->ec->task_pool[i];
-            for (uint32_t j = 0; j < MAX_NB_SUBTASKS_PER_TASK; j++) {
-                _astraea_ec_subtask_create *subtask = task->subtask_pool[j];
-                if (subtask->task) {
-                    doca_task_free(doca_ec_task_create_as_task(subtask->task));
-                }
-            }
-        }
+        astraea_ec_stop_spillover(ctx->ec);
+        astraea_ec_free_idle_tasks(ctx->ec);
     }
 
     /* Astraea will release astraea_ctx's memory in astraea_pe_progress */
+    if (ctx->ctx == nullptr) {
+        return DOCA_SUCCESS;
+    }
     return doca_ctx_stop(ctx->ctx);
-}
\ No newline at end of file
+}
+
+doca_error_t astraea_ctx_set_submit_batch_size(astraea_ctx *ctx,
+                                               uint32_t batch_size) {
+    if (batch_size == 0 || batch_size > MAX_SUBMIT_BATCH_SIZE) {
+        DOCA_LOG_ERR("Submit batch size must be in [1, %u]",
+                     MAX_SUBMIT_BATCH_SIZE);
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    ctx->submit_batch_size.store(batch_size, std::memory_order_relaxed);
+    return DOCA_SUCCESS;
+}
+
+void astraea_ctx_get_submit_stats(astraea_ctx *ctx,
+                                  astraea_submit_stats *stats) {
+    stats->nb_bursts = ctx->nb_bursts.load(std::memory_order_relaxed);
+    stats->nb_submitted = ctx->nb_submitted.load(std::memory_order_relaxed);
+    stats->nb_refunded_tokens =
+        ctx->nb_refunded_tokens.load(std::memory_order_relaxed);
+    stats->max_burst_size = ctx->max_burst_size.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < NB_SUBMIT_BATCH_BUCKETS; i++) {
+        stats->burst_size_hist[i] =
+            ctx->burst_size_hist[i].load(std::memory_order_relaxed);
+    }
+}
+
+doca_error_t astraea_ctx_set_spin_limit(astraea_ctx *ctx,
+                                        uint32_t max_spin_us) {
+    if (max_spin_us > MAX_SPIN_US) {
+        DOCA_LOG_ERR("Spin limit must be at most %uus", MAX_SPIN_US);
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    ctx->max_spin_us.store(max_spin_us, std::memory_order_relaxed);
+    return DOCA_SUCCESS;
+}
+
+void astraea_ctx_get_idle_stats(astraea_ctx *ctx, astraea_idle_stats *stats) {
+    stats->nb_parks = ctx->nb_parks.load(std::memory_order_relaxed);
+    stats->nb_submit_wakeups =
+        ctx->nb_submit_wakeups.load(std::memory_order_relaxed);
+    stats->nb_refill_wakeups =
+        ctx->nb_refill_wakeups.load(std::memory_order_relaxed);
+    stats->total_wakeup_latency_ns =
+        ctx->total_wakeup_latency_ns.load(std::memory_order_relaxed);
+    stats->max_wakeup_latency_ns =
+        ctx->max_wakeup_latency_ns.load(std::memory_order_relaxed);
+    stats->spin_ns = ctx->spin_ns.load(std::memory_order_relaxed);
+    stats->parked_ns = ctx->parked_ns.load(std::memory_order_relaxed);
+    stats->cpu_ns = ctx->cpu_ns.load(std::memory_order_relaxed);
+    stats->spin_window_us = ctx->spin_window_us.load(std::memory_order_relaxed);
+}
+
+doca_error_t astraea_ctx_set_inline_submit(astraea_ctx *ctx, bool is_inline) {
+    if (ctx->submitter) {
+        DOCA_LOG_ERR("Submit mode can't change while the ctx runs");
+        return DOCA_ERROR_BAD_STATE;
+    }
+    ctx->is_inline = is_inline;
+    return DOCA_SUCCESS;
+}
+
+uint32_t astraea_ctx_submit_inline(astraea_ctx *ctx) {
+    /* An empty bucket stays empty until the scheduler refreshes it */
+    const uint32_t epoch = load_token_epoch(ctx_session(ctx));
+    if (ctx->is_out_of_tokens && epoch == ctx->out_of_tokens_epoch) {
+        return ctx->type == EC ? spill_ec_burst(ctx) : 0;
+    }
+
+    uint32_t nb_submitted = 0;
+    bool is_out_of_tokens = false;
+    bool is_blocked = false;
+    switch (ctx->type) {
+    case EC:
+        nb_submitted = submit_ec_burst(ctx, &is_out_of_tokens, &is_blocked);
+        break;
+    }
+    ctx->is_out_of_tokens = is_out_of_tokens;
+    ctx->out_of_tokens_epoch = epoch;
+    return nb_submitted;
+}
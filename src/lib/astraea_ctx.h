@@ -1,6 +1,8 @@
 #ifndef ASTRAEA_CTX_H__
 #define ASTRAEA_CTX_H__
 
+#include <atomic>
+#include <cstdint>
 #include <mutex>
 #include <stop_token>
 #include <thread>
@@ -15,7 +17,48 @@ struct astraea_ec;
 
 enum ctx_type { EC };
 
+/* Strips the submitter hands to DOCA per token reservation */
+constexpr uint32_t DEFAULT_SUBMIT_BATCH_SIZE = 32;
+constexpr uint32_t MAX_SUBMIT_BATCH_SIZE = 256;
+/* Bucket i counts bursts of [2^i, 2^(i+1)) strips */
+constexpr uint32_t NB_SUBMIT_BATCH_BUCKETS = 9;
+
+struct astraea_submit_stats {
+    uint64_t nb_bursts;
+    uint64_t nb_submitted;
+    /* Reserved tokens left unused, DOCA refused or the batch cost less */
+    uint64_t nb_refunded_tokens;
+    uint32_t max_burst_size;
+    uint64_t burst_size_hist[NB_SUBMIT_BATCH_BUCKETS];
+};
+
+/* Longest an idle submitter spins, see astraea_ctx_set_spin_limit */
+constexpr uint32_t DEFAULT_MAX_SPIN_US = 50;
+constexpr uint32_t MAX_SPIN_US = 10 * 1000;
+/* Park timeouts only guard against lost wake ups, they are not a period */
+constexpr uint64_t SUBMIT_PARK_TIMEOUT_NS = 10 * 1000 * 1000;
+/* Tokens are refreshed every ms */
+constexpr uint64_t TOKEN_PARK_TIMEOUT_NS = 2 * 1000 * 1000;
+
+struct astraea_idle_stats {
+    uint64_t nb_parks;
+    /* Parks ended by astraea_task_submit or by a token refresh */
+    uint64_t nb_submit_wakeups;
+    uint64_t nb_refill_wakeups;
+    /* From the ring or refresh to the submitter running again */
+    uint64_t total_wakeup_latency_ns;
+    uint64_t max_wakeup_latency_ns;
+    /* Idle time burnt spinning and time given back to the OS */
+    uint64_t spin_ns;
+    uint64_t parked_ns;
+    /* CPU time of the submitter thread since ctx start */
+    uint64_t cpu_ns;
+    /* Current adaptive spin window */
+    uint32_t spin_window_us;
+};
+
 struct astraea_ctx {
+    /* nullptr for software ecs, see astraea_ec_create_software */
     doca_ctx *ctx;
     std::jthread *submitter;
     ctx_type type;
@@ -23,10 +66,80 @@ struct astraea_ctx {
         astraea_ec *ec;
     };
     std::mutex ctx_lock;
+
+    /**
+     * Strips are submitted by astraea_pe_progress on the caller's thread,
+     * there is no submitter thread and ctx_lock is never taken
+     */
+    bool is_inline;
+    /* Inline mode skips the token semaphore until the next refresh */
+    bool is_out_of_tokens;
+    uint32_t out_of_tokens_epoch;
+    /**
+     * DOCA refused a strip, no tokens are reserved until a strip comes
+     * back and moves astraea_ec::strip_return_seq past blocked_seq
+     */
+    bool is_dispatch_blocked;
+    uint32_t blocked_seq;
+    /**
+     * Tokens strips were dispatched on without having been reserved, paid
+     * back from the next reservations before another strip goes out
+     */
+    uint64_t token_debt;
+
+    std::atomic<uint32_t> submit_batch_size;
+    /* Written by the submitter only, see astraea_ctx_get_submit_stats */
+    std::atomic<uint64_t> nb_bursts;
+    std::atomic<uint64_t> nb_submitted;
+    std::atomic<uint64_t> nb_refunded_tokens;
+    std::atomic<uint32_t> max_burst_size;
+    std::atomic<uint64_t> burst_size_hist[NB_SUBMIT_BATCH_BUCKETS];
+
+    std::atomic<uint32_t> max_spin_us;
+    /* Written by the submitter only, see astraea_ctx_get_idle_stats */
+    std::atomic<uint32_t> spin_window_us;
+    std::atomic<uint64_t> nb_parks;
+    std::atomic<uint64_t> nb_submit_wakeups;
+    std::atomic<uint64_t> nb_refill_wakeups;
+    std::atomic<uint64_t> total_wakeup_latency_ns;
+    std::atomic<uint64_t> max_wakeup_latency_ns;
+    std::atomic<uint64_t> spin_ns;
+    std::atomic<uint64_t> parked_ns;
+    std::atomic<uint64_t> cpu_ns;
 };
 
 doca_error_t astraea_ctx_start(astraea_ctx *ctx);
 
 doca_error_t astraea_ctx_stop(astraea_ctx *ctx);
 
+/**
+ * Bound the strips submitted per token reservation
+ * 1 submits strip by strip, it may be changed while the ctx runs
+ */
+doca_error_t astraea_ctx_set_submit_batch_size(astraea_ctx *ctx,
+                                               uint32_t batch_size);
+
+void astraea_ctx_get_submit_stats(astraea_ctx *ctx,
+                                  astraea_submit_stats *stats);
+
+/**
+ * Bound how long an idle submitter spins before it parks
+ * The window adapts between 1us and max_spin_us to the gaps between strips,
+ * 0 parks right away and gives the lowest CPU use for the highest wake up
+ * latency
+ */
+doca_error_t astraea_ctx_set_spin_limit(astraea_ctx *ctx, uint32_t max_spin_us);
+
+void astraea_ctx_get_idle_stats(astraea_ctx *ctx, astraea_idle_stats *stats);
+
+/**
+ * Run token-gated submission inside astraea_pe_progress instead of a
+ * dedicated thread, for apps that poll the pe from a single core
+ * Must be called before astraea_ctx_start
+ */
+doca_error_t astraea_ctx_set_inline_submit(astraea_ctx *ctx, bool is_inline);
+
+/* Submit one burst of an inline ctx, called by astraea_pe_progress */
+uint32_t astraea_ctx_submit_inline(astraea_ctx *ctx);
+
 #endif
\ No newline at end of file
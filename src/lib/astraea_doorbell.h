@@ -0,0 +1,84 @@
+#ifndef ASTRAEA_DOORBELL_H__
+#define ASTRAEA_DOORBELL_H__
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* CLOCK_MONOTONIC is shared by every process on the host */
+static inline uint64_t astraea_now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static inline void astraea_cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+/**
+ * Sleep while *addr == expected, at most timeout_ns
+ * Words in shared memory must not use the private flavour
+ */
+static inline void astraea_futex_wait(uint32_t *addr, uint32_t expected,
+                                      uint64_t timeout_ns, bool is_shared) {
+    timespec timeout = {.tv_sec = static_cast<time_t>(timeout_ns / 1000000000),
+                        .tv_nsec = static_cast<long>(timeout_ns % 1000000000)};
+    syscall(SYS_futex, addr, is_shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE,
+            expected, &timeout, nullptr, 0);
+}
+
+static inline void astraea_futex_wake_all(uint32_t *addr, bool is_shared) {
+    syscall(SYS_futex, addr, is_shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE,
+            INT_MAX, nullptr, nullptr, 0);
+}
+
+/**
+ * Producers ring it after queueing work, the submitter parks on it
+ * The futex syscall is only paid when the submitter is actually parked
+ */
+struct astraea_doorbell {
+    std::atomic<uint32_t> seq{0};
+    std::atomic<bool> is_parked{false};
+    /* When the ring that woke the submitter happened */
+    std::atomic<uint64_t> ring_time_ns{0};
+
+    void ring() {
+        seq.fetch_add(1, std::memory_order_seq_cst);
+        /* Pairs with the fence in park, either side sees the other */
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (is_parked.load(std::memory_order_relaxed)) {
+            ring_time_ns.store(astraea_now_ns(), std::memory_order_relaxed);
+            astraea_futex_wake_all(reinterpret_cast<uint32_t *>(&seq), false);
+        }
+    }
+
+    /**
+     * Park unless the doorbell rang since seen_seq was read or has_work
+     * reports pending work after the submitter announced itself
+     */
+    template <typename F>
+    void park(uint32_t seen_seq, uint64_t timeout_ns, F &&has_work) {
+        is_parked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!has_work()) {
+            astraea_futex_wait(reinterpret_cast<uint32_t *>(&seq), seen_seq,
+                               timeout_ns, false);
+        }
+        is_parked.store(false, std::memory_order_relaxed);
+    }
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+              "futex needs a plain 32-bit word");
+
+#endif
@@ -1,9 +1,11 @@
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
-#include <utility>
+#include <mutex>
+#include <vector>
 
 #include <doca_buf.h>
 #include <doca_buf_inventory.h>
@@ -15,37 +17,262 @@
 #include <doca_types.h>
 
 #include "astraea_ctx.h"
+#include "astraea_doorbell.h"
 #include "astraea_ec.h"
 #include "astraea_pe.h"
 #include "resource_mgmt.h"
 
 DOCA_LOG_REGISTER(ASTRAEA : EC);
 
-extern sem_t *ec_deficit_sem;
-extern shared_resources *shm_data;
-extern uint32_t app_id;
-extern sem_t *ec_token_sem;
+/* Blocks a strip of a software ec reads at most, an update of k blocks */
+constexpr uint32_t MAX_NB_SW_SRC_BLOCKS =
+    2 * MAX_NB_DATA_BLOCKS + MAX_NB_RDNC_BLOCKS;
+/* Geometry timed when spillover workers start */
+constexpr uint32_t SPILLOVER_CALIBRATION_NB_DATA_BLOCKS = 8;
+constexpr uint32_t SPILLOVER_CALIBRATION_NB_RDNC_BLOCKS = 4;
+constexpr size_t SPILLOVER_CALIBRATION_BLOCK_SIZE = 64 * 1024;
+/* Strips a class dispatches per round while other classes wait */
+constexpr int32_t TASK_CLASS_QUANTA[ASTRAEA_NB_TASK_CLASSES] = {16, 4, 1};
+/**
+ * Deficit a missed deadline charges the app with, background misses ask
+ * the scheduler for no tokens
+ */
+constexpr uint32_t TASK_CLASS_MISS_DEFICITS[ASTRAEA_NB_TASK_CLASSES] = {2, 1,
+                                                                         0};
 
-extern bool has_finished_task;
+/**
+ * Descriptors are recycled as soon as DOCA hands the strip back
+ * The DOCA task is kept for the next strip instead of being freed
+ */
+static inline void park_doca_task(astraea_ec *ec,
+                                  _astraea_ec_subtask &subtask) {
+    /* Strips of software ecs and strips never dispatched have no DOCA task */
+    if (subtask.task == nullptr) {
+        return;
+    }
+    switch (subtask.user_data.origin_task->kind) {
+    case EC_TASK_KIND_CREATE:
+        ec->idle_doca_tasks.push_back(subtask.create_task);
+        break;
+    case EC_TASK_KIND_RECOVER:
+        ec->idle_recover_tasks.push_back(subtask.recover_task);
+        break;
+    case EC_TASK_KIND_UPDATE:
+        ec->idle_update_tasks.push_back(subtask.update_task);
+        break;
+    }
+    subtask.task = nullptr;
+}
 
-void subtask_success_cb(doca_ec_task_create *task, doca_data task_user_data,
-                        doca_data ctx_user_data) {
-    (void)ctx_user_data;
-    const _astraea_ec_subtask_create_user_data *user_data =
-        static_cast<_astraea_ec_subtask_create_user_data *>(task_user_data.ptr);
+static inline void release_subtask(astraea_ec *ec, uint32_t subtask_id) {
+    park_doca_task(ec, ec->subtask_pool[subtask_id]);
+    ec->subtask_pool.free(subtask_id);
+}
+
+/* Give back the bufs and the scratch region the strips were built on */
+static void release_task_bufs(astraea_ec *ec, _astraea_ec_task *task) {
+    for (doca_buf *sub_dst_buf : task->sub_dst_bufs) {
+        doca_buf_dec_refcount(sub_dst_buf, nullptr);
+    }
+    ec->nb_task_bufs -= task->sub_dst_bufs.size();
+    task->sub_dst_bufs.clear();
+    if (task->sgl_plan) {
+        ec->sgl_cache.release(task->sgl_plan);
+        task->sgl_plan = nullptr;
+    }
+    if (task->has_scratch) {
+        ec->scratch_allocator.free(task->scratch_offset);
+        task->has_scratch = false;
+    }
+}
+
+static inline void release_task(_astraea_ec_task *task) {
+    task->state = EC_TASK_STATE_FREE;
+    switch (task->kind) {
+    case EC_TASK_KIND_CREATE:
+        task->ec->task_pool.free(task->id);
+        break;
+    case EC_TASK_KIND_RECOVER:
+        task->ec->recover_task_pool.free(task->id);
+        break;
+    case EC_TASK_KIND_UPDATE:
+        task->ec->update_task_pool.free(task->id);
+        break;
+    }
+}
+
+static void report_granularity(
+    _astraea_ec_task *task,
+    std::chrono::high_resolution_clock::time_point finish_time) {
+    astraea_ec *ec = task->ec;
+    const bool is_miss = finish_time > task->expected_time;
+
+    ec->granularity_stats.nb_tasks++;
+    if (task->nb_subtasks > 1) {
+        ec->granularity_stats.nb_sliced_tasks++;
+    }
+    if (is_miss && !task->has_failed_subtask) {
+        ec->granularity_stats.nb_sla_misses++;
+    }
+
+    if (ec->granularity_ops->feedback == nullptr) {
+        return;
+    }
+    const astraea_granularity_feedback feedback = {
+        .block_size = task->origin_block_size,
+        .granularity = task->sub_block_size,
+        .nb_data_blocks = task->matrix->nb_data_blocks,
+        .nb_strips = task->nb_subtasks,
+        .latency_ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                finish_time - task->submit_time)
+                .count()),
+        .slack_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        task->expected_time - finish_time)
+                        .count(),
+        .has_failed = task->has_failed_subtask};
+    ec->granularity_ops->feedback(ec->granularity_state, &feedback);
+}
+
+/* Callbacks are set for both outcomes or for none, see set_conf */
+static bool has_callbacks(const _astraea_ec_task *task) {
+    const astraea_ec *ec = task->ec;
+    switch (task->kind) {
+    case EC_TASK_KIND_CREATE:
+        return ec->success_cb != nullptr;
+    case EC_TASK_KIND_RECOVER:
+        return ec->recover_success_cb != nullptr;
+    case EC_TASK_KIND_UPDATE:
+        return ec->update_success_cb != nullptr;
+    }
+    return false;
+}
+
+/* Queue a task without callbacks on its pe, astraea_pe_progress reaps it */
+static void queue_completed_task(_astraea_ec_task *task) {
+    astraea_pe *pe = task->ec->pe;
+    task->state = EC_TASK_STATE_COMPLETED;
+    task->completed_next = nullptr;
+    if (pe->completed_tail) {
+        pe->completed_tail->completed_next = task;
+    } else {
+        pe->completed_head = task;
+    }
+    pe->completed_tail = task;
+}
+
+static void notify_user(_astraea_ec_task *task, bool is_success) {
+    astraea_ec *ec = task->ec;
+    switch (task->kind) {
+    case EC_TASK_KIND_CREATE: {
+        auto cb = is_success ? ec->success_cb : ec->error_cb;
+        cb(static_cast<astraea_ec_task_create *>(task), task->user_data,
+           {.u64 = 0});
+        break;
+    }
+    case EC_TASK_KIND_RECOVER: {
+        auto cb = is_success ? ec->recover_success_cb : ec->recover_error_cb;
+        cb(static_cast<astraea_ec_task_recover *>(task), task->user_data,
+           {.u64 = 0});
+        break;
+    }
+    case EC_TASK_KIND_UPDATE: {
+        auto cb = is_success ? ec->update_success_cb : ec->update_error_cb;
+        cb(static_cast<astraea_ec_task_update *>(task), task->user_data,
+           {.u64 = 0});
+        break;
+    }
+    }
+}
+
+/**
+ * Runs once every strip of the task has come back from DOCA
+ * The user is notified without alloc_lock, its callback may allocate the
+ * next task. Tasks without callbacks wait on the pe to be reaped
+ */
+static void finish_task(_astraea_ec_task *task) {
+    astraea_ec *ec = task->ec;
+    astraea_session *session = ec->session;
+    const auto cur_time = std::chrono::high_resolution_clock::now();
+    const bool is_reaped = !has_callbacks(task);
+    task->finish_time = cur_time;
+    const bool is_sla_missed =
+        !task->has_failed_subtask && cur_time > task->expected_time;
+    {
+        std::lock_guard<std::mutex> guard(ec->alloc_lock);
+        release_task_bufs(ec, task);
+        report_granularity(task, cur_time);
+
+        astraea_ec_class_stats &class_stats =
+            ec->class_stats[task->task_class];
+        class_stats.nb_tasks++;
+        class_stats.total_latency_us +=
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                cur_time - task->submit_time)
+                .count();
+        if (is_sla_missed) {
+            class_stats.nb_sla_misses++;
+        }
+    }
+
+    if (task->has_failed_subtask) {
+        if (!is_reaped) {
+            notify_user(task, false);
+        }
+    } else {
+        const uint32_t deficit = TASK_CLASS_MISS_DEFICITS[task->task_class];
+        if (is_sla_missed && deficit > 0) {
+            if (sem_wait(session->ec_deficit_sem)) {
+                DOCA_LOG_ERR("Failed to get ec_deficit_sem");
+            } else {
+                session->shm_data->deficits[session->app_id] += deficit;
+
+                if (sem_post(session->ec_deficit_sem)) {
+                    DOCA_LOG_ERR("Failed to post ec_deficit_sem");
+                }
+            }
+        }
+
+        if (!is_reaped) {
+            notify_user(task, true);
+        }
+    }
+    if (is_reaped) {
+        queue_completed_task(task);
+    } else {
+        std::lock_guard<std::mutex> guard(ec->alloc_lock);
+        release_task(task);
+    }
+    if (ec->pe) {
+        ec->pe->has_finished_task.store(true, std::memory_order_relaxed);
+    }
+}
+
+/* The strip gave back what a blocked submitter waits for */
+static void wake_blocked_submitter(astraea_ec *ec) {
+    ec->strip_return_seq.fetch_add(1, std::memory_order_release);
+    /* Pairs with the fence in submit_ec_burst, either side sees the other */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ec->is_dispatch_blocked.load(std::memory_order_relaxed) &&
+        ec->is_dispatch_blocked.exchange(false, std::memory_order_acq_rel)) {
+        ec->doorbell.ring();
+    }
+}
+
+/* dst is the buf the strip wrote into */
+static void complete_subtask(_astraea_ec_subtask_user_data *user_data,
+                             const doca_buf *dst, bool has_failed) {
+    _astraea_ec_task *origin_task = user_data->origin_task;
 
-    if (user_data->is_sub) {
-        const doca_buf *sub_dst_buf = doca_ec_task_create_get_rdnc_blocks(task);
+    /* Only strips staged in the scratch region need reassembly */
+    if (!has_failed && user_data->is_sub && origin_task->has_scratch) {
         uint8_t *dst_data;
-        doca_buf_get_data(sub_dst_buf, (void **)&dst_data);
+        doca_buf_get_data(dst, (void **)&dst_data);
 
-        const size_t origin_block_size =
-            user_data->origin_task->origin_block_size;
-        const size_t sub_block_size = user_data->origin_task->sub_block_size;
-        const uint32_t nb_rdnc_blocks =
-            user_data->origin_task->matrix->nb_rdnc_blocks;
-        uint8_t *dst_base_addr =
-            static_cast<uint8_t *>(user_data->origin_task->dst_base_addr);
+        const size_t origin_block_size = origin_task->origin_block_size;
+        const size_t sub_block_size = origin_task->sub_block_size;
+        const uint32_t nb_rdnc_blocks = origin_task->matrix->nb_rdnc_blocks;
+        uint8_t *dst_base_addr = origin_task->dst_base_addr;
 
         for (uint32_t i = 0; i < nb_rdnc_blocks; i++) {
             memcpy(dst_base_addr + i * origin_block_size +
@@ -54,109 +281,483 @@ void subtask_success_cb(doca_ec_task_create *task, doca_data task_user_data,
         }
     }
 
-    if (user_data->is_last) {
-        auto cur_time = std::chrono::high_resolution_clock::now();
-        if (cur_time > user_data->origin_task->expected_time) {
-            if (sem_wait(ec_deficit_sem)) {
-                DOCA_LOG_ERR("Failed to get ec_token_sem");
-                return;
-            }
-
-            shm_data->deficits[app_id]++;
-
-            if (sem_post(ec_deficit_sem)) {
-                DOCA_LOG_ERR("Failed to post ec_token_sem");
-                return;
-            }
-        }
+    {
+        std::lock_guard<std::mutex> guard(origin_task->ec->alloc_lock);
+        release_subtask(origin_task->ec, user_data->subtask_id);
+    }
+    wake_blocked_submitter(origin_task->ec);
 
-        user_data->origin_task->ec->success_cb(
-            user_data->origin_task, user_data->origin_task->user_data,
-            {.u64 = 0});
-        has_finished_task = true;
+    if (has_failed) {
+        origin_task->has_failed_subtask = true;
+    }
+    if (--origin_task->nb_pending_subtasks == 0) {
+        finish_task(origin_task);
     }
 }
 
+void subtask_success_cb(doca_ec_task_create *task, doca_data task_user_data,
+                        doca_data ctx_user_data) {
+    (void)ctx_user_data;
+    complete_subtask(
+        static_cast<_astraea_ec_subtask_user_data *>(task_user_data.ptr),
+        doca_ec_task_create_get_rdnc_blocks(task), false);
+}
+
 void subtask_error_cb(doca_ec_task_create *task, doca_data task_user_data,
                       doca_data ctx_user_data) {
+    (void)task;
+    (void)ctx_user_data;
+    complete_subtask(
+        static_cast<_astraea_ec_subtask_user_data *>(task_user_data.ptr),
+        nullptr, true);
+}
+
+static void recover_subtask_success_cb(doca_ec_task_recover *task,
+                                       doca_data task_user_data,
+                                       doca_data ctx_user_data) {
     (void)ctx_user_data;
-    _astraea_ec_subtask_create_user_data *user_data =
-        static_cast<_astraea_ec_subtask_create_user_data *>(task_user_data.ptr);
+    complete_subtask(
+        static_cast<_astraea_ec_subtask_user_data *>(task_user_data.ptr),
+        doca_ec_task_recover_get_recovered_data(task), false);
+}
+
+static void recover_subtask_error_cb(doca_ec_task_recover *task,
+                                     doca_data task_user_data,
+                                     doca_data ctx_user_data) {
+    (void)task;
+    (void)ctx_user_data;
+    complete_subtask(
+        static_cast<_astraea_ec_subtask_user_data *>(task_user_data.ptr),
+        nullptr, true);
+}
 
-    if (user_data->is_last) {
-        user_data->origin_task->ec->error_cb(user_data->origin_task,
-                                             user_data->origin_task->user_data,
-                                             {.u64 = 0});
-        has_finished_task = true;
+static void update_subtask_success_cb(doca_ec_task_update *task,
+                                      doca_data task_user_data,
+                                      doca_data ctx_user_data) {
+    (void)ctx_user_data;
+    complete_subtask(
+        static_cast<_astraea_ec_subtask_user_data *>(task_user_data.ptr),
+        doca_ec_task_update_get_updated_rdnc_blocks(task), false);
+}
+
+static void update_subtask_error_cb(doca_ec_task_update *task,
+                                    doca_data task_user_data,
+                                    doca_data ctx_user_data) {
+    (void)task;
+    (void)ctx_user_data;
+    complete_subtask(
+        static_cast<_astraea_ec_subtask_user_data *>(task_user_data.ptr),
+        nullptr, true);
+}
+
+/**
+ * Point blocks at the nb_blocks blocks of block_size bytes a chain holds, a
+ * buf may hold several of them
+ * Sources are the data of each buf, destinations are appended after it and
+ * counted in its data length, as DOCA does
+ */
+static bool gather_blocks(doca_buf *buf, bool is_dst, uint32_t nb_blocks,
+                          size_t block_size, uint8_t **blocks) {
+    uint32_t nb_found = 0;
+    while (buf && nb_found < nb_blocks) {
+        void *data;
+        size_t data_len;
+        doca_buf_get_data(buf, &data);
+        doca_buf_get_data_len(buf, &data_len);
+
+        uint8_t *begin = static_cast<uint8_t *>(data);
+        size_t len = data_len;
+        if (is_dst) {
+            void *head;
+            size_t buf_len;
+            doca_buf_get_head(buf, &head);
+            doca_buf_get_len(buf, &buf_len);
+            begin += data_len;
+            len = static_cast<uint8_t *>(head) + buf_len - begin;
+        }
+
+        size_t nb_used = 0;
+        for (; nb_used + block_size <= len && nb_found < nb_blocks;
+             nb_used += block_size) {
+            blocks[nb_found++] = begin + nb_used;
+        }
+        if (is_dst && nb_used > 0) {
+            doca_buf_set_data(buf, data, data_len + nb_used);
+        }
+        doca_buf_get_next_in_list(buf, &buf);
     }
+    return nb_found == nb_blocks;
 }
 
-doca_error_t astraea_ec_create(doca_dev *dev, astraea_ec **ec) {
-    astraea_ec *new_ec = new astraea_ec;
-    *ec = nullptr;
+/* Encode one strip with the matrix of its task */
+static bool run_sw_strip(astraea_ec *ec, _astraea_ec_subtask &subtask) {
+    const astraea_ec_matrix *matrix = subtask.user_data.origin_task->matrix;
+    if (matrix->nb_data_blocks > MAX_NB_SW_SRC_BLOCKS ||
+        matrix->nb_rdnc_blocks > MAX_NB_RDNC_BLOCKS) {
+        DOCA_LOG_ERR("Matrix (%u, %u) is too large for the software backend",
+                     matrix->nb_data_blocks, matrix->nb_rdnc_blocks);
+        return false;
+    }
 
-    new_ec->dev = dev;
+    size_t src_len = 0;
+    for (doca_buf *buf = subtask.src_buf; buf;) {
+        size_t data_len;
+        doca_buf_get_data_len(buf, &data_len);
+        src_len += data_len;
+        doca_buf_get_next_in_list(buf, &buf);
+    }
+    const size_t block_size = src_len / matrix->nb_data_blocks;
+
+    uint8_t *src[MAX_NB_SW_SRC_BLOCKS];
+    uint8_t *dst[MAX_NB_RDNC_BLOCKS];
+    if (block_size == 0 ||
+        !gather_blocks(subtask.src_buf, false, matrix->nb_data_blocks,
+                       block_size, src) ||
+        !gather_blocks(subtask.dst_buf, true, matrix->nb_rdnc_blocks,
+                       block_size, dst)) {
+        DOCA_LOG_ERR("Strip bufs do not hold (%u, %u) blocks of %lu bytes",
+                     matrix->nb_data_blocks, matrix->nb_rdnc_blocks,
+                     block_size);
+        return false;
+    }
 
-    doca_error_t status = doca_ec_create(dev, &new_ec->ec);
-    if (status != DOCA_SUCCESS) {
-        delete new_ec;
-        return status;
+    astraea_gf_encode(ec->gf_kernel, block_size, matrix->nb_data_blocks,
+                      matrix->nb_rdnc_blocks, matrix->gf_tables.data(), src,
+                      dst);
+    return true;
+}
+
+/**
+ * Take in the tasks astraea_task_submit published
+ * Each is published by its first strip, none of its strips is dispatched
+ * before it is queued here
+ */
+static void drain_submissions(astraea_ec *ec) {
+    uint32_t subtask_id;
+    while (ec->subtask_queue.try_pop(subtask_id)) {
+        _astraea_ec_task *task =
+            ec->subtask_pool[subtask_id].user_data.origin_task;
+        ec->edf_queues[task->task_class].push(task);
     }
+}
 
-    int ret =
-        posix_memalign(&new_ec->tmp_rdnc_buffer, 64, TMP_RDNC_BUFFER_SIZE);
-    if (ret) {
-        DOCA_LOG_ERR("Failed to alloc memory");
-        doca_ec_destroy(new_ec->ec);
-        delete new_ec;
-        return status;
+/**
+ * Deficit round robin: the current class dispatches while it has credit,
+ * the next class with queued strips is then topped up by its quantum
+ * An idle class keeps no credit, it can't save up for a burst later
+ */
+bool astraea_ec_peek_subtask(astraea_ec *ec, uint32_t *subtask_id) {
+    drain_submissions(ec);
+
+    /* Each class is visited twice at most, the second visit has credit */
+    for (uint32_t i = 0; i < 2 * ASTRAEA_NB_TASK_CLASSES; i++) {
+        const uint32_t task_class = ec->dispatch_class;
+        astraea_edf_queue &queue = ec->edf_queues[task_class];
+        if (queue.size() == 0) {
+            ec->class_credits[task_class] = 0;
+        } else if (ec->class_credits[task_class] > 0) {
+            return queue.peek(*subtask_id);
+        }
+
+        ec->dispatch_class = (task_class + 1) % ASTRAEA_NB_TASK_CLASSES;
+        if (ec->edf_queues[ec->dispatch_class].size() > 0) {
+            ec->class_credits[ec->dispatch_class] +=
+                TASK_CLASS_QUANTA[ec->dispatch_class];
+        }
     }
-    status = doca_mmap_create(&new_ec->dst_mmap);
-    if (status != DOCA_SUCCESS) {
-        DOCA_LOG_ERR("Failed to create dst mmap: %s",
-                     doca_error_get_descr(status));
-        doca_ec_destroy(new_ec->ec);
-        delete new_ec;
-        return status;
+    return false;
+}
+
+void astraea_ec_pop_subtask(astraea_ec *ec) {
+    ec->edf_queues[ec->dispatch_class].pop();
+    ec->class_credits[ec->dispatch_class]--;
+}
+
+uint32_t astraea_ec_nb_queued_subtasks(astraea_ec *ec) {
+    drain_submissions(ec);
+    uint32_t nb_queued = 0;
+    for (const astraea_edf_queue &queue : ec->edf_queues) {
+        nb_queued += queue.size();
     }
+    return nb_queued;
+}
 
-    status = doca_mmap_add_dev(new_ec->dst_mmap, dev);
-    if (status != DOCA_SUCCESS) {
-        DOCA_LOG_ERR("Failed to add dev to dst mmap: %s",
-                     doca_error_get_descr(status));
-        doca_mmap_destroy(new_ec->dst_mmap);
-        doca_ec_destroy(new_ec->ec);
-        delete new_ec;
-        return status;
+uint64_t astraea_ec_nb_queued_tokens(astraea_ec *ec) {
+    drain_submissions(ec);
+    uint64_t nb_tokens = 0;
+    for (const astraea_edf_queue &queue : ec->edf_queues) {
+        nb_tokens += queue.nb_tokens();
     }
+    return nb_tokens;
+}
 
-    status = doca_mmap_set_memrange(new_ec->dst_mmap, new_ec->tmp_rdnc_buffer,
-                                    TMP_RDNC_BUFFER_SIZE);
-    if (status != DOCA_SUCCESS) {
-        DOCA_LOG_ERR("Failed to set mmap memrange: %s",
-                     doca_error_get_descr(status));
-        doca_mmap_destroy(new_ec->dst_mmap);
-        doca_ec_destroy(new_ec->ec);
-        delete new_ec;
-        return status;
+doca_error_t astraea_ec_sw_submit(astraea_ec *ec, uint32_t subtask_id) {
+    /* The submitter is the only producer, room seen here stays */
+    if (ec->sw_completions.size() == ec->sw_completions.capacity()) {
+        return DOCA_ERROR_AGAIN;
     }
 
-    status = doca_mmap_start(new_ec->dst_mmap);
-    if (status != DOCA_SUCCESS) {
-        DOCA_LOG_ERR("Failed to start dst mmap: %s",
-                     doca_error_get_descr(status));
-        doca_mmap_destroy(new_ec->dst_mmap);
-        doca_ec_destroy(new_ec->ec);
-        delete new_ec;
-        return status;
+    _astraea_ec_subtask &subtask = ec->subtask_pool[subtask_id];
+    const bool has_failed = !run_sw_strip(ec, subtask);
+    ec->sw_completions.try_push(
+        {.subtask_id = subtask_id, .has_failed = has_failed});
+    if (ec->pe) {
+        astraea_pe_notify(ec->pe);
+    }
+    return DOCA_SUCCESS;
+}
+
+bool astraea_ec_has_cpu_completions(astraea_ec *ec) {
+    return ec->sw_completions.size() > 0 ||
+           (ec->spillover && ec->spillover->has_completions());
+}
+
+static task_type as_task_type(astraea_ec_task_kind kind) {
+    switch (kind) {
+    case EC_TASK_KIND_CREATE:
+        return EC_CREATE;
+    case EC_TASK_KIND_RECOVER:
+        return EC_RECOVER;
+    case EC_TASK_KIND_UPDATE:
+        return EC_UPDATE;
+    }
+    return EC_CREATE;
+}
+
+void astraea_ec_reap_task(_astraea_ec_task *task,
+                          astraea_completion *completion) {
+    *completion = {
+        .type = as_task_type(task->kind),
+        .user_data = task->user_data,
+        .status =
+            task->has_failed_subtask ? DOCA_ERROR_IO_FAILED : DOCA_SUCCESS,
+        .task_class = task->task_class,
+        .latency_ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                task->finish_time - task->submit_time)
+                .count()),
+        .is_sla_miss = task->finish_time > task->expected_time};
+
+    std::lock_guard<std::mutex> guard(task->ec->alloc_lock);
+    release_task(task);
+}
+
+uint32_t astraea_ec_sw_progress(astraea_ec *ec) {
+    uint32_t nb_completed = 0;
+    astraea_ec_sw_completion completion;
+    while (ec->sw_completions.try_pop(completion)) {
+        _astraea_ec_subtask &subtask =
+            ec->subtask_pool[completion.subtask_id];
+        complete_subtask(&subtask.user_data, subtask.dst_buf,
+                         completion.has_failed);
+        nb_completed++;
+    }
+
+    if (ec->spillover == nullptr) {
+        return nb_completed;
+    }
+    astraea_spill_completion spill_completion;
+    while (ec->spillover->try_pop_completion(spill_completion)) {
+        _astraea_ec_subtask &subtask =
+            ec->subtask_pool[spill_completion.job_id];
+        complete_subtask(&subtask.user_data, subtask.dst_buf,
+                         spill_completion.has_failed);
+        nb_completed++;
+    }
+    return nb_completed;
+}
+
+static bool run_spilled_strip(void *arg, uint32_t subtask_id) {
+    astraea_ec *ec = static_cast<astraea_ec *>(arg);
+    return run_sw_strip(ec, ec->subtask_pool[subtask_id]);
+}
+
+static void notify_spilled_strip(void *arg) {
+    astraea_ec *ec = static_cast<astraea_ec *>(arg);
+    if (ec->pe) {
+        astraea_pe_notify(ec->pe);
+    }
+}
+
+/* Time one pass of the ec's kernel to seed the estimate of the workers */
+static double calibrate_spillover(astraea_ec *ec) {
+    constexpr uint32_t nb_data_blocks = SPILLOVER_CALIBRATION_NB_DATA_BLOCKS;
+    constexpr uint32_t nb_rdnc_blocks = SPILLOVER_CALIBRATION_NB_RDNC_BLOCKS;
+    constexpr size_t block_size = SPILLOVER_CALIBRATION_BLOCK_SIZE;
+
+    uint8_t coefs[nb_data_blocks * nb_rdnc_blocks];
+    astraea_gf_gen_cauchy(nb_data_blocks, nb_rdnc_blocks, coefs);
+    std::vector<uint8_t> tables(sizeof(coefs) * GF_TABLE_SIZE);
+    astraea_gf_init_tables(coefs, nb_rdnc_blocks, nb_data_blocks,
+                           tables.data());
+
+    std::vector<uint8_t> blocks((nb_data_blocks + nb_rdnc_blocks) *
+                                block_size);
+    const uint8_t *src[nb_data_blocks];
+    uint8_t *dst[nb_rdnc_blocks];
+    for (uint32_t i = 0; i < nb_data_blocks; i++) {
+        src[i] = blocks.data() + i * block_size;
+    }
+    for (uint32_t i = 0; i < nb_rdnc_blocks; i++) {
+        dst[i] = blocks.data() + (nb_data_blocks + i) * block_size;
+    }
+
+    /* The first pass only warms the caches */
+    uint64_t elapsed_ns = 0;
+    for (uint32_t i = 0; i < 2; i++) {
+        const uint64_t begin_ns = astraea_now_ns();
+        astraea_gf_encode(ec->gf_kernel, block_size, nb_data_blocks,
+                          nb_rdnc_blocks, tables.data(), src, dst);
+        elapsed_ns = astraea_now_ns() - begin_ns;
+    }
+    return static_cast<double>(elapsed_ns) /
+           (block_size * nb_data_blocks * nb_rdnc_blocks);
+}
+
+doca_error_t astraea_ec_set_spillover(astraea_ec *ec, uint32_t nb_workers) {
+    if (ec->is_software) {
+        DOCA_LOG_ERR("Software ecs already run every strip on the CPU");
+        return DOCA_ERROR_NOT_SUPPORTED;
+    }
+    if (nb_workers > MAX_NB_SPILLOVER_WORKERS) {
+        DOCA_LOG_ERR("Spillover workers must be at most %u",
+                     MAX_NB_SPILLOVER_WORKERS);
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    if (ec->spillover && ec->spillover->is_started()) {
+        DOCA_LOG_ERR("Spillover can't change while the ctx runs");
+        return DOCA_ERROR_BAD_STATE;
+    }
+    if (nb_workers > 0) {
+        std::lock_guard<std::mutex> guard(ec->alloc_lock);
+        doca_error_t status = ec->matrix_cache.enable_cpu_coefs();
+        if (status != DOCA_SUCCESS) {
+            return status;
+        }
+    }
+
+    ec->nb_spillover_workers = nb_workers;
+    if (nb_workers > 0 && ec->spillover == nullptr) {
+        ec->spillover = new astraea_spillover_pool;
+    }
+    return DOCA_SUCCESS;
+}
+
+doca_error_t astraea_ec_start_spillover(astraea_ec *ec) {
+    if (ec->spillover == nullptr || ec->nb_spillover_workers == 0) {
+        return DOCA_SUCCESS;
     }
+    const double ns_per_unit = calibrate_spillover(ec);
+    DOCA_LOG_INFO("Spill strips to %u workers, %s kernel at %.3fns per "
+                  "byte and coefficient",
+                  ec->nb_spillover_workers, GF_KERNEL_NAMES[ec->gf_kernel],
+                  ns_per_unit);
+    return ec->spillover->start(ec->nb_spillover_workers, run_spilled_strip,
+                                notify_spilled_strip, ec, ns_per_unit);
+}
+
+void astraea_ec_stop_spillover(astraea_ec *ec) {
+    if (ec->spillover == nullptr) {
+        return;
+    }
+    ec->spillover->stop();
+    /* Their DOCA tasks must be idle before astraea_ec_free_idle_tasks */
+    (void)astraea_ec_sw_progress(ec);
+}
+
+uint32_t astraea_ec_spill(astraea_ec *ec, uint64_t budget_ns,
+                          uint32_t max_nb_strips) {
+    if (ec->spillover == nullptr || !ec->spillover->is_started()) {
+        return 0;
+    }
+
+    uint32_t nb_spilled = 0;
+    uint32_t subtask_id;
+    while (nb_spilled < max_nb_strips &&
+           astraea_ec_peek_subtask(ec, &subtask_id)) {
+        const _astraea_ec_task *task =
+            ec->subtask_pool[subtask_id].user_data.origin_task;
+        const astraea_ec_matrix *matrix = task->matrix;
+        if (matrix->gf_tables.empty()) {
+            break;
+        }
+
+        /* Strips stay in dispatch order, the head waits for the refresh */
+        const uint64_t nb_units = task->sub_block_size *
+                                  matrix->nb_data_blocks *
+                                  matrix->nb_rdnc_blocks;
+        if (!ec->spillover->try_dispatch(subtask_id, nb_units, budget_ns)) {
+            break;
+        }
+        astraea_ec_pop_subtask(ec);
+        nb_spilled++;
+    }
+    return nb_spilled;
+}
+
+void astraea_ec_get_spillover_stats(astraea_ec *ec,
+                                    astraea_spillover_stats *stats) {
+    if (ec->spillover == nullptr) {
+        *stats = {};
+        return;
+    }
+    ec->spillover->get_stats(stats);
+}
+
+doca_error_t astraea_ec_create(doca_dev *dev, astraea_ec **ec) {
+    return astraea_ec_create(astraea_default_session(), dev, ec);
+}
+
+doca_error_t astraea_ec_create_software(astraea_ec **ec) {
+    return astraea_ec_create_software(astraea_default_session(), ec);
+}
+
+/* A nullptr dev creates a software ec */
+static doca_error_t create_ec(astraea_session *session, doca_dev *dev,
+                              astraea_ec **ec) {
+    *ec = nullptr;
+    if (session == nullptr || session->shm_data == nullptr) {
+        DOCA_LOG_ERR("No registered session, create astraea_authenticator "
+                     "first");
+        return DOCA_ERROR_BAD_STATE;
+    }
+
+    astraea_ec *new_ec = new astraea_ec;
+    new_ec->dev = dev;
+    new_ec->session = session;
+    new_ec->pe = nullptr;
+    new_ec->dispatch_class = ASTRAEA_TASK_CLASS_CRITICAL;
+    for (uint32_t i = 0; i < ASTRAEA_NB_TASK_CLASSES; i++) {
+        new_ec->class_credits[i] = 0;
+        new_ec->class_stats[i] = {};
+    }
+    new_ec->is_software = dev == nullptr;
+    new_ec->gf_kernel = astraea_gf_best_kernel();
+    new_ec->ec = nullptr;
+    new_ec->nb_spillover_workers = 0;
+    new_ec->spillover = nullptr;
+
+    doca_error_t status;
+    if (!new_ec->is_software) {
+        status = doca_ec_create(dev, &new_ec->ec);
+        if (status != DOCA_SUCCESS) {
+            delete new_ec;
+            return status;
+        }
+    }
+
+    new_ec->rdnc_scratch = nullptr;
+    new_ec->rdnc_scratch_size = DEFAULT_RDNC_SCRATCH_SIZE;
+    new_ec->dst_mmap = nullptr;
+    new_ec->nb_task_bufs = 0;
 
     status = doca_buf_inventory_create(MAX_NB_CTX_BUFS, &new_ec->buf_inventory);
     if (status != DOCA_SUCCESS) {
         DOCA_LOG_ERR("Failed to create buf inventory: %s",
                      doca_error_get_descr(status));
-        doca_mmap_destroy(new_ec->dst_mmap);
-        doca_ec_destroy(new_ec->ec);
+        if (new_ec->ec) {
+            doca_ec_destroy(new_ec->ec);
+        }
         delete new_ec;
         return status;
     }
@@ -166,145 +767,369 @@ doca_error_t astraea_ec_create(doca_dev *dev, astraea_ec **ec) {
         DOCA_LOG_ERR("Failed to start buf inventory: %s",
                      doca_error_get_descr(status));
         doca_buf_inventory_destroy(new_ec->buf_inventory);
-        doca_mmap_destroy(new_ec->dst_mmap);
-        doca_ec_destroy(new_ec->ec);
+        if (new_ec->ec) {
+            doca_ec_destroy(new_ec->ec);
+        }
         delete new_ec;
         return status;
     }
-
-    new_ec->prod_pos = 0;
-    new_ec->cons_pos = 0;
-    new_ec->alloc_pos = 0;
-    for (uint32_t i = 0; i < MAX_NB_INFLIGHT_EC_TASKS; i++) {
-        /* Lock all subtasks */
-        new_ec->subtask_locks[i].lock();
-
-        new_ec->task_pool[i] = new astraea_ec_task_create;
-        new_ec->task_pool[i]->cur_subtask_pos = 0;
-        new_ec->task_pool[i]->is_free = false;
-        for (uint32_t j = 0; j < MAX_NB_SUBTASKS_PER_TASK; j++) {
-            new_ec->task_pool[i]->subtask_pool[j] =
-                new _astraea_ec_subtask_create;
-            new_ec->task_pool[i]->subtask_pool[j]->user_data =
-                new _astraea_ec_subtask_create_user_data;
-            new_ec->task_pool[i]->subtask_pool[j]->task = nullptr;
-        }
+    new_ec->sgl_cache.init(new_ec->buf_inventory, MAX_NB_SGL_CACHED_BUFS);
+    new_ec->matrix_cache.init(new_ec->ec, new_ec);
+    new_ec->idle_doca_tasks.reserve(MAX_NB_INFLIGHT_EC_TASKS);
+    new_ec->cost_model.store(astraea_cost_model_builtin(),
+                             std::memory_order_relaxed);
+    const char *cost_model_path = getenv(COST_MODEL_ENV);
+    if (cost_model_path &&
+        astraea_ec_load_cost_model(new_ec, cost_model_path) != DOCA_SUCCESS) {
+        DOCA_LOG_WARN("Keep the builtin cost model");
     }
+    new_ec->granularity_ops = &astraea_granularity_adaptive;
+    new_ec->granularity_state = new_ec->granularity_ops->create();
+    new_ec->granularity_stats = {};
 
     *ec = new_ec;
 
     return DOCA_SUCCESS;
 }
 
-doca_error_t astraea_ec_destroy(astraea_ec *ec) {
-    for (uint32_t i = 0; i < MAX_NB_INFLIGHT_EC_TASKS; i++) {
-        astraea_ec_task_create *task = ec->task_pool[i];
-        for (uint32_t j = 0; j < MAX_NB_SUBTASKS_PER_TASK; j++) {
-            _astraea_ec_subtask_create *subtask = task->subtask_pool[j];
-            /* DOCA tasks are free in astraea_ctx_stop */
-            delete subtask->user_data;
-            delete subtask;
-        }
-        for (std::pair<doca_buf *, doca_buf *> sub_buf_pair :
-             task->sub_buf_pairs) {
-            doca_buf_dec_refcount(sub_buf_pair.first, nullptr);
-            doca_buf_dec_refcount(sub_buf_pair.second, nullptr);
+doca_error_t astraea_ec_create(astraea_session *session, doca_dev *dev,
+                               astraea_ec **ec) {
+    if (dev == nullptr) {
+        *ec = nullptr;
+        DOCA_LOG_ERR("No device, use astraea_ec_create_software instead");
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    return create_ec(session, dev, ec);
+}
+
+doca_error_t astraea_ec_create_software(astraea_session *session,
+                                        astraea_ec **ec) {
+    doca_error_t status = create_ec(session, nullptr, ec);
+    if (status == DOCA_SUCCESS) {
+        DOCA_LOG_INFO("Software ec encodes with the %s kernel",
+                      GF_KERNEL_NAMES[(*ec)->gf_kernel]);
+    }
+    return status;
+}
+
+/* Unlink the unreaped tasks of ec, they would outlive their pool on the pe */
+static void drop_completed_tasks(astraea_ec *ec) {
+    astraea_pe *pe = ec->pe;
+    _astraea_ec_task *task = pe->completed_head;
+    pe->completed_head = pe->completed_tail = nullptr;
+    while (task) {
+        _astraea_ec_task *next = task->completed_next;
+        if (task->ec != ec) {
+            queue_completed_task(task);
         }
+        task = next;
+    }
+}
 
-        delete task;
+doca_error_t astraea_ec_destroy(astraea_ec *ec) {
+    /**
+     * Only walk chunks that were actually allocated
+     * Finished tasks hold nothing, only those cut short by astraea_ctx_stop
+     * DOCA tasks are free in the completion callbacks or astraea_ctx_stop
+     */
+    astraea_ec_resource_stats stats;
+    astraea_ec_get_resource_stats(ec, &stats);
+    if (stats.nb_tasks > 0) {
+        DOCA_LOG_WARN("Destroying ec with %u tasks neither completed nor "
+                      "freed",
+                      stats.nb_tasks);
+    }
+    if (ec->pe) {
+        drop_completed_tasks(ec);
+    }
+    for (uint32_t i = 0; i < ec->task_pool.nb_reserved(); i++) {
+        release_task_bufs(ec, &ec->task_pool[i]);
+    }
+    for (uint32_t i = 0; i < ec->recover_task_pool.nb_reserved(); i++) {
+        release_task_bufs(ec, &ec->recover_task_pool[i]);
     }
+    for (uint32_t i = 0; i < ec->update_task_pool.nb_reserved(); i++) {
+        release_task_bufs(ec, &ec->update_task_pool[i]);
+    }
+    if (ec->spillover) {
+        ec->spillover->stop();
+        delete ec->spillover;
+    }
+    ec->sgl_cache.clear();
+    ec->matrix_cache.clear();
+    ec->granularity_ops->destroy(ec->granularity_state);
     doca_error_t status;
-    status = doca_ec_destroy(ec->ec);
+    if (ec->ec) {
+        status = doca_ec_destroy(ec->ec);
+    }
     status = doca_buf_inventory_destroy(ec->buf_inventory);
-    status = doca_mmap_destroy(ec->dst_mmap);
-    free(ec->tmp_rdnc_buffer);
+    if (ec->dst_mmap) {
+        status = doca_mmap_destroy(ec->dst_mmap);
+    }
+    free(ec->rdnc_scratch);
 
     delete ec;
 
     return status;
 }
 
+doca_error_t astraea_ec_set_gf_kernel(astraea_ec *ec,
+                                      astraea_gf_kernel kernel) {
+    if (ec->spillover && ec->spillover->is_started()) {
+        DOCA_LOG_ERR("Kernel can't change while spillover workers run");
+        return DOCA_ERROR_BAD_STATE;
+    }
+    if (kernel >= ASTRAEA_GF_NB_KERNELS ||
+        !astraea_gf_kernel_is_supported(kernel)) {
+        DOCA_LOG_ERR("This CPU does not run the %s kernel",
+                     kernel < ASTRAEA_GF_NB_KERNELS ? GF_KERNEL_NAMES[kernel]
+                                                    : "unknown");
+        return DOCA_ERROR_NOT_SUPPORTED;
+    }
+    ec->gf_kernel = kernel;
+    return DOCA_SUCCESS;
+}
+
+doca_error_t astraea_ec_set_scratch_size(astraea_ec *ec, size_t size) {
+    if (ec->dst_mmap) {
+        DOCA_LOG_ERR("Scratch region is already registered");
+        return DOCA_ERROR_BAD_STATE;
+    }
+    if (size < (size_t{1} << SCRATCH_MIN_ORDER)) {
+        DOCA_LOG_ERR("Scratch size %lu is too small", size);
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    ec->rdnc_scratch_size = size;
+    return DOCA_SUCCESS;
+}
+
+doca_error_t astraea_ec_prepare_scratch(astraea_ec *ec) {
+    /* ctx may be restarted, keep the registered region */
+    if (ec->dst_mmap) {
+        return DOCA_SUCCESS;
+    }
+
+    int ret = posix_memalign(&ec->rdnc_scratch, 64, ec->rdnc_scratch_size);
+    if (ret) {
+        DOCA_LOG_ERR("Failed to alloc memory");
+        ec->rdnc_scratch = nullptr;
+        return DOCA_ERROR_NO_MEMORY;
+    }
+
+    doca_error_t status = doca_mmap_create(&ec->dst_mmap);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create dst mmap: %s",
+                     doca_error_get_descr(status));
+        ec->dst_mmap = nullptr;
+        return status;
+    }
+
+    /* Software ecs read the scratch region from the CPU only */
+    if (ec->dev) {
+        status = doca_mmap_add_dev(ec->dst_mmap, ec->dev);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to add dev to dst mmap: %s",
+                         doca_error_get_descr(status));
+            doca_mmap_destroy(ec->dst_mmap);
+            ec->dst_mmap = nullptr;
+            return status;
+        }
+    }
+
+    status = doca_mmap_set_memrange(ec->dst_mmap, ec->rdnc_scratch,
+                                    ec->rdnc_scratch_size);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set mmap memrange: %s",
+                     doca_error_get_descr(status));
+        doca_mmap_destroy(ec->dst_mmap);
+        ec->dst_mmap = nullptr;
+        return status;
+    }
+
+    status = doca_mmap_start(ec->dst_mmap);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start dst mmap: %s",
+                     doca_error_get_descr(status));
+        doca_mmap_destroy(ec->dst_mmap);
+        ec->dst_mmap = nullptr;
+        return status;
+    }
+
+    ec->scratch_allocator.init(ec->rdnc_scratch_size);
+    return DOCA_SUCCESS;
+}
+
+void astraea_ec_free_idle_tasks(astraea_ec *ec) {
+    uint32_t subtask_id;
+    while (astraea_ec_peek_subtask(ec, &subtask_id)) {
+        park_doca_task(ec, ec->subtask_pool[subtask_id]);
+        astraea_ec_pop_subtask(ec);
+    }
+
+    for (doca_ec_task_create *task : ec->idle_doca_tasks) {
+        doca_task_free(doca_ec_task_create_as_task(task));
+    }
+    ec->idle_doca_tasks.clear();
+    for (doca_ec_task_recover *task : ec->idle_recover_tasks) {
+        doca_task_free(doca_ec_task_recover_as_task(task));
+    }
+    ec->idle_recover_tasks.clear();
+    for (doca_ec_task_update *task : ec->idle_update_tasks) {
+        doca_task_free(doca_ec_task_update_as_task(task));
+    }
+    ec->idle_update_tasks.clear();
+}
+
 astraea_ctx *astraea_ec_as_ctx(astraea_ec *ec) {
     astraea_ctx *ctx = new astraea_ctx;
 
-    ctx->ctx = doca_ec_as_ctx(ec->ec);
-    if (ctx->ctx == nullptr) {
+    /* Software ecs have no DOCA ctx, the pe drives them directly */
+    ctx->ctx = ec->is_software ? nullptr : doca_ec_as_ctx(ec->ec);
+    if (ctx->ctx == nullptr && !ec->is_software) {
         delete ctx;
         return nullptr;
     }
     ctx->type = EC;
     ctx->ec = ec;
     ctx->submitter = nullptr;
+    ctx->is_inline = false;
+    ctx->is_out_of_tokens = false;
+    ctx->out_of_tokens_epoch = 0;
+    ctx->is_dispatch_blocked = false;
+    ctx->blocked_seq = 0;
+    ctx->token_debt = 0;
+    ctx->submit_batch_size = DEFAULT_SUBMIT_BATCH_SIZE;
+    ctx->max_spin_us = DEFAULT_MAX_SPIN_US;
+    ctx->spin_window_us = DEFAULT_MAX_SPIN_US;
 
     return ctx;
 }
 
+/* Both callbacks or none, tasks without them are reaped from the pe */
+template <typename completion_cb_t>
+static doca_error_t check_callbacks(completion_cb_t success_cb,
+                                    completion_cb_t error_cb) {
+    if ((success_cb == nullptr) != (error_cb == nullptr)) {
+        DOCA_LOG_ERR("Set both completion callbacks or none of them");
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    return DOCA_SUCCESS;
+}
+
 doca_error_t astraea_ec_task_create_set_conf(
     astraea_ec *ec,
     astraea_ec_task_create_completion_cb_t successful_task_completion_cb,
     astraea_ec_task_create_completion_cb_t error_task_completion_cb,
     uint32_t num_tasks) {
     (void)num_tasks;
+    doca_error_t status = check_callbacks(successful_task_completion_cb,
+                                          error_task_completion_cb);
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
     ec->success_cb = successful_task_completion_cb;
     ec->error_cb = error_task_completion_cb;
+    if (ec->is_software) {
+        return DOCA_SUCCESS;
+    }
     return doca_ec_task_create_set_conf(
         ec->ec, subtask_success_cb, subtask_error_cb, MAX_NB_INFLIGHT_EC_TASKS);
 }
 
-/* Base time cost when params are 128, 32, 8192 */
-constexpr double base_time_cost = 73.672188;
-static inline uint32_t calc_token_cost(uint32_t nb_data_blocks,
-                                       uint32_t nb_rdnc_blocks,
-                                       size_t block_size) {
-    /* This formula is derived from logarithmic fitting */
-    double time_cost_prediction =
-        (2.82268116e-04 * nb_data_blocks + 2.55153425e-03) *
-        (2.08178676e-03 * nb_rdnc_blocks + 6.82958278e-02) *
-        (1.64268580e+00 * block_size - 7.53855770e+03);
-    return time_cost_prediction / base_time_cost;
+doca_error_t astraea_ec_task_recover_set_conf(
+    astraea_ec *ec,
+    astraea_ec_task_recover_completion_cb_t successful_task_completion_cb,
+    astraea_ec_task_recover_completion_cb_t error_task_completion_cb,
+    uint32_t num_tasks) {
+    (void)num_tasks;
+    doca_error_t status = check_callbacks(successful_task_completion_cb,
+                                          error_task_completion_cb);
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
+    ec->recover_success_cb = successful_task_completion_cb;
+    ec->recover_error_cb = error_task_completion_cb;
+    if (ec->is_software) {
+        return DOCA_SUCCESS;
+    }
+    ec->idle_recover_tasks.reserve(MAX_NB_INFLIGHT_EC_TASKS);
+    return doca_ec_task_recover_set_conf(ec->ec, recover_subtask_success_cb,
+                                         recover_subtask_error_cb,
+                                         MAX_NB_INFLIGHT_EC_TASKS);
+}
+
+doca_error_t astraea_ec_task_update_set_conf(
+    astraea_ec *ec,
+    astraea_ec_task_update_completion_cb_t successful_task_completion_cb,
+    astraea_ec_task_update_completion_cb_t error_task_completion_cb,
+    uint32_t num_tasks) {
+    (void)num_tasks;
+    doca_error_t status = check_callbacks(successful_task_completion_cb,
+                                          error_task_completion_cb);
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
+    ec->update_success_cb = successful_task_completion_cb;
+    ec->update_error_cb = error_task_completion_cb;
+    if (ec->is_software) {
+        return DOCA_SUCCESS;
+    }
+    ec->idle_update_tasks.reserve(MAX_NB_INFLIGHT_EC_TASKS);
+    return doca_ec_task_update_set_conf(ec->ec, update_subtask_success_cb,
+                                        update_subtask_error_cb,
+                                        MAX_NB_INFLIGHT_EC_TASKS);
+}
+
+/* Updates are priced by the blocks they change, not by the blocks they read */
+static inline uint32_t calc_token_cost(_astraea_ec_task *task) {
+    const astraea_ec_matrix *matrix = task->matrix;
+    return astraea_cost_model_tokens(
+        task->ec->cost_model.load(std::memory_order_acquire),
+        matrix->cost_type, matrix->cost_nb_data_blocks,
+        matrix->nb_rdnc_blocks, task->origin_block_size);
 }
 
 /**
- * This function should be modify later!
- * The granularity should be calculated according to real time metadata
- * Which must incurs semaphore operations
+ * Ask the strategy for a strip size given the tokens left right now
+ * Sizes that would leave a partial strip keep the task whole. A task is cut
+ * into no more strips than the tokens it costs, so strips of cheap tasks do
+ * not each pay a token for a sliver of work
  */
-static size_t calc_granularity(astraea_ec_task_create *task) {
-    size_t granularity = 0;
+static size_t calc_granularity(_astraea_ec_task *task, uint32_t token_cost) {
+    astraea_ec *ec = task->ec;
+    astraea_session *session = ec->session;
 
-    uint32_t token_cost =
-        calc_token_cost(task->matrix->nb_data_blocks,
-                        task->matrix->nb_rdnc_blocks, task->origin_block_size);
-
-    if (sem_wait(ec_token_sem)) {
+    if (sem_wait(session->ec_token_sem)) {
         DOCA_LOG_ERR("Failed to get ec_token_sem");
         return 1024;
     }
 
-    const uint32_t nb_avail_tokens = shm_data->ec_tokens[app_id];
+    const uint32_t nb_avail_tokens =
+        session->shm_data->ec_tokens[session->app_id];
 
-    if (token_cost < nb_avail_tokens) {
-        granularity = task->origin_block_size;
-    } else {
-        granularity = nb_avail_tokens < 2      ? 1 * 1024
-                      : nb_avail_tokens < 4    ? 2 * 1024
-                      : nb_avail_tokens < 8    ? 4 * 1024
-                      : nb_avail_tokens < 16   ? 8 * 1024
-                      : nb_avail_tokens < 32   ? 16 * 1024
-                      : nb_avail_tokens < 64   ? 32 * 1024
-                      : nb_avail_tokens < 128  ? 64 * 1024
-                      : nb_avail_tokens < 256  ? 128 * 1024
-                      : nb_avail_tokens < 512  ? 256 * 1024
-                      : nb_avail_tokens < 1024 ? 512 * 1024
-                                               : 1024 * 1024;
-        granularity /= 2;
-    }
-
-    if (sem_post(ec_token_sem)) {
+    if (sem_post(session->ec_token_sem)) {
         DOCA_LOG_ERR("Failed to post ec_token_sem");
         return 1024;
     }
 
+    const astraea_granularity_input input = {
+        .nb_data_blocks = task->matrix->nb_data_blocks,
+        .nb_rdnc_blocks = task->matrix->nb_rdnc_blocks,
+        .block_size = task->origin_block_size,
+        .token_cost = token_cost,
+        .nb_avail_tokens = nb_avail_tokens};
+    size_t granularity =
+        ec->granularity_ops->choose(ec->granularity_state, &input);
+
+    if (granularity == 0 || granularity >= task->origin_block_size ||
+        task->origin_block_size % granularity != 0) {
+        return task->origin_block_size;
+    }
+    const size_t max_nb_strips = token_cost > 1 ? token_cost : 1;
+    while (task->origin_block_size / granularity > max_nb_strips &&
+           task->origin_block_size % (granularity * 2) == 0) {
+        granularity *= 2;
+    }
     return granularity;
 }
 
@@ -313,71 +1138,250 @@ struct subtask_create_ctx {
     doca_buf *sub_src_buf;
     doca_buf *sub_dst_buf;
     uint32_t strip_id;
-    bool is_last;
     bool is_sub;
-    astraea_ec_task_create *origin_task;
+    _astraea_ec_task *origin_task;
 };
 
+/* Re-arm a DOCA task whose strip has completed, or allocate one */
+static doca_error_t arm_create_task(astraea_ec *ec,
+                                    _astraea_ec_subtask &subtask) {
+    const doca_ec_matrix *matrix =
+        subtask.user_data.origin_task->matrix->matrix;
+    const doca_data task_user_data = {.ptr = &subtask.user_data};
+    doca_ec_task_create *task;
+    if (!ec->idle_doca_tasks.empty()) {
+        task = ec->idle_doca_tasks.back();
+        ec->idle_doca_tasks.pop_back();
+        doca_ec_task_create_set_coding_matrix(task, matrix);
+        doca_ec_task_create_set_original_data_blocks(task, subtask.src_buf);
+        doca_ec_task_create_set_rdnc_blocks(task, subtask.dst_buf);
+        doca_task_set_user_data(doca_ec_task_create_as_task(task),
+                                task_user_data);
+    } else {
+        doca_error_t status = doca_ec_task_create_allocate_init(
+            ec->ec, matrix, subtask.src_buf, subtask.dst_buf, task_user_data,
+            &task);
+        if (status != DOCA_SUCCESS) {
+            if (!is_backpressure(status)) {
+                DOCA_LOG_ERR("Failed to allocate and init ec create task: %s",
+                             doca_error_get_descr(status));
+            }
+            return status;
+        }
+    }
+    subtask.create_task = task;
+    subtask.task = doca_ec_task_create_as_task(task);
+    return DOCA_SUCCESS;
+}
+
+static doca_error_t arm_recover_task(astraea_ec *ec,
+                                     _astraea_ec_subtask &subtask) {
+    const doca_ec_matrix *matrix =
+        subtask.user_data.origin_task->matrix->matrix;
+    const doca_data task_user_data = {.ptr = &subtask.user_data};
+    doca_ec_task_recover *task;
+    if (!ec->idle_recover_tasks.empty()) {
+        task = ec->idle_recover_tasks.back();
+        ec->idle_recover_tasks.pop_back();
+        doca_ec_task_recover_set_recover_matrix(task, matrix);
+        doca_ec_task_recover_set_available_blocks(task, subtask.src_buf);
+        doca_ec_task_recover_set_recovered_data(task, subtask.dst_buf);
+        doca_task_set_user_data(doca_ec_task_recover_as_task(task),
+                                task_user_data);
+    } else {
+        doca_error_t status = doca_ec_task_recover_allocate_init(
+            ec->ec, matrix, subtask.src_buf, subtask.dst_buf, task_user_data,
+            &task);
+        if (status != DOCA_SUCCESS) {
+            if (!is_backpressure(status)) {
+                DOCA_LOG_ERR("Failed to allocate and init ec recover task: %s",
+                             doca_error_get_descr(status));
+            }
+            return status;
+        }
+    }
+    subtask.recover_task = task;
+    subtask.task = doca_ec_task_recover_as_task(task);
+    return DOCA_SUCCESS;
+}
+
+static doca_error_t arm_update_task(astraea_ec *ec,
+                                    _astraea_ec_subtask &subtask) {
+    const doca_ec_matrix *matrix =
+        subtask.user_data.origin_task->matrix->matrix;
+    const doca_data task_user_data = {.ptr = &subtask.user_data};
+    doca_ec_task_update *task;
+    if (!ec->idle_update_tasks.empty()) {
+        task = ec->idle_update_tasks.back();
+        ec->idle_update_tasks.pop_back();
+        doca_ec_task_update_set_update_matrix(task, matrix);
+        doca_ec_task_update_set_original_updated_and_rdnc_blocks(
+            task, subtask.src_buf);
+        doca_ec_task_update_set_updated_rdnc_blocks(task, subtask.dst_buf);
+        doca_task_set_user_data(doca_ec_task_update_as_task(task),
+                                task_user_data);
+    } else {
+        doca_error_t status = doca_ec_task_update_allocate_init(
+            ec->ec, matrix, subtask.src_buf, subtask.dst_buf, task_user_data,
+            &task);
+        if (status != DOCA_SUCCESS) {
+            if (!is_backpressure(status)) {
+                DOCA_LOG_ERR("Failed to allocate and init ec update task: %s",
+                             doca_error_get_descr(status));
+            }
+            return status;
+        }
+    }
+    subtask.update_task = task;
+    subtask.task = doca_ec_task_update_as_task(task);
+    return DOCA_SUCCESS;
+}
+
+doca_error_t astraea_ec_arm_subtask(astraea_ec *ec, uint32_t subtask_id) {
+    _astraea_ec_subtask &subtask = ec->subtask_pool[subtask_id];
+    if (subtask.task) {
+        return DOCA_SUCCESS;
+    }
+    switch (subtask.user_data.origin_task->kind) {
+    case EC_TASK_KIND_CREATE:
+        return arm_create_task(ec, subtask);
+    case EC_TASK_KIND_RECOVER:
+        return arm_recover_task(ec, subtask);
+    default:
+        return arm_update_task(ec, subtask);
+    }
+}
+
 static inline doca_error_t
 create_subtask(const subtask_create_ctx &stsk_ctx,
-               _astraea_ec_subtask_create **subtask) {
+               _astraea_ec_subtask **subtask) {
     *subtask = nullptr;
-    _astraea_ec_subtask_create *new_subtask =
-        stsk_ctx.origin_task
-            ->subtask_pool[stsk_ctx.origin_task->cur_subtask_pos++];
-
-    new_subtask->user_data->is_sub = stsk_ctx.is_sub;
-    new_subtask->user_data->is_last = stsk_ctx.is_last;
-    new_subtask->user_data->strip_id = stsk_ctx.strip_id;
-    new_subtask->user_data->origin_task = stsk_ctx.origin_task;
-
-    doca_error_t status = doca_ec_task_create_allocate_init(
-        stsk_ctx.origin_task->ec->ec, stsk_ctx.origin_task->matrix->matrix,
-        stsk_ctx.sub_src_buf, stsk_ctx.sub_dst_buf,
-        {.ptr = new_subtask->user_data}, &new_subtask->task);
-    if (status != DOCA_SUCCESS) {
-        DOCA_LOG_ERR("Failed to allocate and init ec create task: %s",
-                     doca_error_get_descr(status));
-        return status;
+    _astraea_ec_task *origin_task = stsk_ctx.origin_task;
+    astraea_ec *ec = origin_task->ec;
+
+    const uint32_t subtask_id = ec->subtask_pool.alloc();
+    if (subtask_id == ASTRAEA_INVALID_ID) {
+        DOCA_LOG_ERR("Failed to alloc sub task: pool exhausted");
+        return DOCA_ERROR_NO_MEMORY;
+    }
+    _astraea_ec_subtask *new_subtask = &ec->subtask_pool[subtask_id];
+
+    new_subtask->user_data.is_sub = stsk_ctx.is_sub;
+    new_subtask->user_data.strip_id = stsk_ctx.strip_id;
+    new_subtask->user_data.subtask_id = subtask_id;
+    new_subtask->user_data.origin_task = origin_task;
+    new_subtask->next = ASTRAEA_INVALID_ID;
+
+    /* The submitter arms the DOCA task, see astraea_ec_arm_subtask */
+    new_subtask->task = nullptr;
+    new_subtask->src_buf = stsk_ctx.sub_src_buf;
+    new_subtask->dst_buf = stsk_ctx.sub_dst_buf;
+
+    /* Append to the strip chain of the origin task */
+    if (origin_task->nb_subtasks == 0) {
+        origin_task->first_subtask = subtask_id;
+    } else {
+        ec->subtask_pool[origin_task->last_subtask].next = subtask_id;
     }
+    origin_task->last_subtask = subtask_id;
+    origin_task->nb_subtasks++;
 
     *subtask = new_subtask;
     return DOCA_SUCCESS;
 }
 
-doca_error_t astraea_ec_task_create_allocate_init(
-    astraea_ec *ec, astraea_ec_matrix *coding_matrix, doca_mmap *src_mmap,
-    doca_buf *original_data_blocks, doca_buf *rdnc_blocks, doca_data user_data,
-    astraea_ec_task_create **task) {
-    *task = nullptr;
-    astraea_ec_task_create *new_task = ec->task_pool[ec->alloc_pos++];
+/* Give back the strips created so far and the task slot itself */
+static void discard_task(_astraea_ec_task *task) {
+    astraea_ec *ec = task->ec;
+    uint32_t subtask_id = task->first_subtask;
+    for (uint32_t i = 0; i < task->nb_subtasks; i++) {
+        const uint32_t next = ec->subtask_pool[subtask_id].next;
+        release_subtask(ec, subtask_id);
+        subtask_id = next;
+    }
+    release_task_bufs(ec, task);
+    release_task(task);
+}
+
+/**
+ * Chain one buf per rdnc block, each pointing at this strip's slice of the
+ * block inside the user's rdnc_blocks
+ */
+static doca_error_t create_strided_dst(astraea_ec *ec, _astraea_ec_task *task,
+                                       doca_mmap *dst_mmap, uint32_t strip_id,
+                                       doca_buf **sub_dst_buf) {
+    const size_t sub_block_size = task->sub_block_size;
+    doca_error_t status;
+
+    for (uint32_t i = 0; i < task->matrix->nb_rdnc_blocks; i++) {
+        uint8_t *addr = task->dst_base_addr + i * task->origin_block_size +
+                        strip_id * sub_block_size;
+
+        doca_buf *buf;
+        status = doca_buf_inventory_buf_get_by_addr(
+            ec->buf_inventory, dst_mmap, addr, sub_block_size, &buf);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to alloc buf for rdnc blocks: %s",
+                         doca_error_get_descr(status));
+            if (i > 0) {
+                doca_buf_dec_refcount(*sub_dst_buf, nullptr);
+            }
+            return status;
+        }
+
+        if (i == 0) {
+            *sub_dst_buf = buf;
+            continue;
+        }
+
+        status = doca_buf_chain_list(*sub_dst_buf, buf);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to chain list: %s",
+                         doca_error_get_descr(status));
+            doca_buf_dec_refcount(buf, nullptr);
+            doca_buf_dec_refcount(*sub_dst_buf, nullptr);
+            return status;
+        }
+    }
+    return DOCA_SUCCESS;
+}
 
+/* Slice the task into strips against the tokens available right now */
+static doca_error_t build_strips(astraea_ec *ec, astraea_ec_matrix *matrix,
+                                 doca_mmap *src_mmap, doca_buf *src_blocks,
+                                 doca_mmap *dst_mmap, doca_buf *dst_blocks,
+                                 doca_data user_data,
+                                 _astraea_ec_task *new_task) {
     size_t src_buf_size;
-    doca_error_t status =
-        doca_buf_get_data_len(original_data_blocks, &src_buf_size);
+    doca_error_t status = doca_buf_get_data_len(src_blocks, &src_buf_size);
     if (status != DOCA_SUCCESS) {
         DOCA_LOG_ERR("Failed to get block size: %s",
                      doca_error_get_descr(status));
         return status;
     }
 
-    const size_t origin_block_size =
-        src_buf_size / coding_matrix->nb_data_blocks;
+    const size_t origin_block_size = src_buf_size / matrix->nb_data_blocks;
 
     new_task->origin_block_size = origin_block_size;
     new_task->user_data = user_data;
-    new_task->original_data_blocks = original_data_blocks;
-    new_task->rdnc_blocks = rdnc_blocks;
+    new_task->src_blocks = src_blocks;
+    new_task->dst_blocks = dst_blocks;
     new_task->ec = ec;
-    new_task->matrix = coding_matrix;
+    new_task->matrix = matrix;
 
-    const size_t sub_block_size = calc_granularity(new_task);
+    const uint32_t token_cost = calc_token_cost(new_task);
+    const size_t sub_block_size = calc_granularity(new_task, token_cost);
+    const uint32_t nb_strips = origin_block_size > sub_block_size
+                                   ? origin_block_size / sub_block_size
+                                   : 1;
 
     new_task->sub_block_size = sub_block_size;
+    new_task->strip_token_cost =
+        token_cost > nb_strips ? (token_cost + nb_strips - 1) / nb_strips : 1;
 
     if (origin_block_size > sub_block_size) {
         void *dst_base_addr = nullptr;
-        status = doca_buf_get_data(rdnc_blocks, &dst_base_addr);
+        status = doca_buf_get_data(dst_blocks, &dst_base_addr);
         if (status != DOCA_SUCCESS) {
             DOCA_LOG_ERR("Failed to get rdnc buf addr: %s",
                          doca_error_get_descr(status));
@@ -387,103 +1391,257 @@ doca_error_t astraea_ec_task_create_allocate_init(
         new_task->dst_base_addr = static_cast<uint8_t *>(dst_base_addr);
 
         void *src_base_addr = nullptr;
-        status = doca_buf_get_data(original_data_blocks, &src_base_addr);
+        status = doca_buf_get_data(src_blocks, &src_base_addr);
         if (status != DOCA_SUCCESS) {
             DOCA_LOG_ERR("Failed to get data buf addr: %s",
                          doca_error_get_descr(status));
             return status;
         }
 
-        const uint32_t nb_strips = origin_block_size / sub_block_size;
-        for (uint32_t i = 0; i < nb_strips; i++) {
-            doca_buf *sub_src_buf, *sub_dst_buf;
+        const size_t strip_rdnc_size = sub_block_size * matrix->nb_rdnc_blocks;
+
+        /* Tasks in flight never share parity space */
+        uint8_t *scratch_base = nullptr;
+        if (!dst_mmap) {
+            if (!ec->scratch_allocator.alloc(nb_strips * strip_rdnc_size,
+                                             &new_task->scratch_offset)) {
+                DOCA_LOG_ERR("Failed to alloc parity scratch: %lu of %lu "
+                             "bytes in use",
+                             ec->scratch_allocator.nb_used_bytes(),
+                             ec->scratch_allocator.capacity());
+                return DOCA_ERROR_AGAIN;
+            }
+            new_task->has_scratch = true;
+            scratch_base = static_cast<uint8_t *>(ec->rdnc_scratch) +
+                           new_task->scratch_offset;
+        }
 
-            doca_buf *tmp_bufs[MAX_NB_DATA_BLOCKS];
-            // create scatter gather list
-            for (uint32_t j = 0; j < coding_matrix->nb_data_blocks; j++) {
-                uint8_t *addr = static_cast<uint8_t *>(src_base_addr) +
-                                j * origin_block_size + i * sub_block_size;
+        const astraea_sgl_key sgl_key = {
+            .mmap = src_mmap,
+            .base_addr = static_cast<uint8_t *>(src_base_addr),
+            .nb_data_blocks = matrix->nb_data_blocks,
+            .block_size = origin_block_size,
+            .granularity = sub_block_size};
+        status = ec->sgl_cache.acquire(sgl_key, &new_task->sgl_plan);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to build scatter gather lists: %s",
+                         doca_error_get_descr(status));
+            return status;
+        }
 
+        for (uint32_t i = 0; i < nb_strips; i++) {
+            doca_buf *sub_dst_buf;
+            if (dst_mmap) {
+                status = create_strided_dst(ec, new_task, dst_mmap, i,
+                                            &sub_dst_buf);
+            } else {
                 status = doca_buf_inventory_buf_get_by_addr(
-                    ec->buf_inventory, src_mmap, addr, sub_block_size,
-                    &tmp_bufs[j]);
-                if (status != DOCA_SUCCESS) {
-                    DOCA_LOG_ERR("Failed to alloc buf for data blocks: %s",
-                                 doca_error_get_descr(status));
-                    return status;
-                }
-
-                status = doca_buf_set_data(tmp_bufs[j], addr, sub_block_size);
-                if (status != DOCA_SUCCESS) {
-                    DOCA_LOG_ERR("Failed to set buf data for data bufs: %s",
-                                 doca_error_get_descr(status));
-                    return status;
-                }
-
-                if (j == 0) {
-                    sub_src_buf = tmp_bufs[j];
-                } else {
-                    status = doca_buf_chain_list(sub_src_buf, tmp_bufs[j]);
-                    if (status != DOCA_SUCCESS) {
-                        DOCA_LOG_ERR("Failed to chain list: %s",
-                                     doca_error_get_descr(status));
-                        return status;
-                    }
-                }
+                    ec->buf_inventory, ec->dst_mmap,
+                    scratch_base + i * strip_rdnc_size, strip_rdnc_size,
+                    &sub_dst_buf);
             }
-
-            status = doca_buf_inventory_buf_get_by_addr(
-                ec->buf_inventory, ec->dst_mmap,
-                static_cast<uint8_t *>(ec->tmp_rdnc_buffer) +
-                    i * sub_block_size * coding_matrix->nb_rdnc_blocks,
-                sub_block_size * coding_matrix->nb_rdnc_blocks, &sub_dst_buf);
             if (status != DOCA_SUCCESS) {
                 DOCA_LOG_ERR("Failed to alloc buf for rdnc blocks: %s",
                              doca_error_get_descr(status));
                 return status;
             }
+            new_task->sub_dst_bufs.push_back(sub_dst_buf);
+            ec->nb_task_bufs++;
 
             const subtask_create_ctx stsk_ctx = {
-                .sub_src_buf = sub_src_buf,
+                .sub_src_buf = new_task->sgl_plan->strips[i],
                 .sub_dst_buf = sub_dst_buf,
                 .strip_id = i,
-                .is_last = i == nb_strips - 1 ? true : false,
                 .is_sub = true,
                 .origin_task = new_task};
 
-            _astraea_ec_subtask_create *subtask = nullptr;
+            _astraea_ec_subtask *subtask = nullptr;
             status = create_subtask(stsk_ctx, &subtask);
             if (status != DOCA_SUCCESS) {
                 DOCA_LOG_ERR("Failed to create sub task");
                 return status;
             }
-            new_task->sub_buf_pairs.push_back(
-                std::make_pair(stsk_ctx.sub_src_buf, stsk_ctx.sub_dst_buf));
         }
     } else {
-        const subtask_create_ctx stsk_ctx = {.sub_src_buf =
-                                                 original_data_blocks,
-                                             .sub_dst_buf = rdnc_blocks,
+        const subtask_create_ctx stsk_ctx = {.sub_src_buf = src_blocks,
+                                             .sub_dst_buf = dst_blocks,
                                              .strip_id = 0,
-                                             .is_last = true,
                                              .is_sub = false,
                                              .origin_task = new_task};
-        _astraea_ec_subtask_create *subtask = nullptr;
+        _astraea_ec_subtask *subtask = nullptr;
         status = create_subtask(stsk_ctx, &subtask);
         if (status != DOCA_SUCCESS) {
             DOCA_LOG_ERR("Failed to create sub task");
             return status;
         }
     }
+    return DOCA_SUCCESS;
+}
+
+/* Take a descriptor from the pool of its kind */
+static _astraea_ec_task *alloc_task(astraea_ec *ec, astraea_ec_task_kind kind) {
+    uint32_t task_id;
+    _astraea_ec_task *task;
+    astraea_task handle;
+    switch (kind) {
+    case EC_TASK_KIND_CREATE:
+        task_id = ec->task_pool.alloc();
+        task = task_id == ASTRAEA_INVALID_ID ? nullptr
+                                             : &ec->task_pool[task_id];
+        handle.type = EC_CREATE;
+        handle.ec_task_create = static_cast<astraea_ec_task_create *>(task);
+        break;
+    case EC_TASK_KIND_RECOVER:
+        task_id = ec->recover_task_pool.alloc();
+        task = task_id == ASTRAEA_INVALID_ID ? nullptr
+                                             : &ec->recover_task_pool[task_id];
+        handle.type = EC_RECOVER;
+        handle.ec_task_recover = static_cast<astraea_ec_task_recover *>(task);
+        break;
+    default:
+        task_id = ec->update_task_pool.alloc();
+        task = task_id == ASTRAEA_INVALID_ID ? nullptr
+                                             : &ec->update_task_pool[task_id];
+        handle.type = EC_UPDATE;
+        handle.ec_task_update = static_cast<astraea_ec_task_update *>(task);
+        break;
+    }
+    if (task) {
+        task->kind = kind;
+        task->id = task_id;
+        task->handle = handle;
+        task->state = EC_TASK_STATE_ALLOCATED;
+    }
+    return task;
+}
+
+/* Set up a descriptor and slice it into strips, from any thread */
+static doca_error_t init_task(astraea_ec *ec, astraea_ec_task_kind kind,
+                              astraea_ec_matrix *matrix, doca_mmap *src_mmap,
+                              doca_buf *src_blocks, doca_mmap *dst_mmap,
+                              doca_buf *dst_blocks, doca_data user_data,
+                              _astraea_ec_task **task) {
+    *task = nullptr;
+    std::lock_guard<std::mutex> guard(ec->alloc_lock);
+    _astraea_ec_task *new_task = alloc_task(ec, kind);
+    if (new_task == nullptr) {
+        DOCA_LOG_ERR("Failed to alloc ec task: pool exhausted");
+        return DOCA_ERROR_NO_MEMORY;
+    }
+    new_task->ec = ec;
+    new_task->nb_subtasks = 0;
+    new_task->first_subtask = ASTRAEA_INVALID_ID;
+    new_task->last_subtask = ASTRAEA_INVALID_ID;
+    new_task->has_failed_subtask = false;
+    new_task->has_scratch = false;
+    new_task->sgl_plan = nullptr;
+    new_task->task_class = ASTRAEA_TASK_CLASS_NORMAL;
+    new_task->latency_sla = std::chrono::microseconds{0};
+
+    doca_error_t status =
+        build_strips(ec, matrix, src_mmap, src_blocks, dst_mmap, dst_blocks,
+                     user_data, new_task);
+    if (status != DOCA_SUCCESS) {
+        discard_task(new_task);
+        return status;
+    }
+    new_task->nb_pending_subtasks = new_task->nb_subtasks;
     *task = new_task;
     return DOCA_SUCCESS;
 }
 
+doca_error_t astraea_ec_task_create_allocate_init(
+    astraea_ec *ec, astraea_ec_matrix *coding_matrix, doca_mmap *src_mmap,
+    doca_buf *original_data_blocks, doca_mmap *dst_mmap, doca_buf *rdnc_blocks,
+    doca_data user_data, astraea_ec_task_create **task) {
+    *task = nullptr;
+    if (coding_matrix->cost_type != ASTRAEA_COST_MATRIX_CAUCHY &&
+        coding_matrix->cost_type != ASTRAEA_COST_MATRIX_VANDERMONDE) {
+        DOCA_LOG_ERR("Create tasks need a coding matrix");
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    _astraea_ec_task *new_task;
+    doca_error_t status =
+        init_task(ec, EC_TASK_KIND_CREATE, coding_matrix, src_mmap,
+                  original_data_blocks, dst_mmap, rdnc_blocks, user_data,
+                  &new_task);
+    if (status == DOCA_SUCCESS) {
+        *task = static_cast<astraea_ec_task_create *>(new_task);
+    }
+    return status;
+}
+
+doca_error_t astraea_ec_task_recover_allocate_init(
+    astraea_ec *ec, astraea_ec_matrix *recover_matrix, doca_mmap *src_mmap,
+    doca_buf *available_blocks, doca_mmap *dst_mmap,
+    doca_buf *recovered_data_blocks, doca_data user_data,
+    astraea_ec_task_recover **task) {
+    *task = nullptr;
+    if (recover_matrix->cost_type != ASTRAEA_COST_MATRIX_RECOVER) {
+        DOCA_LOG_ERR("Recover tasks need a recover matrix");
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    _astraea_ec_task *new_task;
+    doca_error_t status =
+        init_task(ec, EC_TASK_KIND_RECOVER, recover_matrix, src_mmap,
+                  available_blocks, dst_mmap, recovered_data_blocks,
+                  user_data, &new_task);
+    if (status == DOCA_SUCCESS) {
+        *task = static_cast<astraea_ec_task_recover *>(new_task);
+    }
+    return status;
+}
+
+doca_error_t astraea_ec_task_update_allocate_init(
+    astraea_ec *ec, astraea_ec_matrix *update_matrix, doca_mmap *src_mmap,
+    doca_buf *original_updated_and_rdnc_blocks, doca_mmap *dst_mmap,
+    doca_buf *updated_rdnc_blocks, doca_data user_data,
+    astraea_ec_task_update **task) {
+    *task = nullptr;
+    if (update_matrix->cost_type != ASTRAEA_COST_MATRIX_UPDATE) {
+        DOCA_LOG_ERR("Update tasks need an update matrix");
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    _astraea_ec_task *new_task;
+    doca_error_t status =
+        init_task(ec, EC_TASK_KIND_UPDATE, update_matrix, src_mmap,
+                  original_updated_and_rdnc_blocks, dst_mmap,
+                  updated_rdnc_blocks, user_data, &new_task);
+    if (status == DOCA_SUCCESS) {
+        *task = static_cast<astraea_ec_task_update *>(new_task);
+    }
+    return status;
+}
+
+void astraea_ec_task_free(_astraea_ec_task *task) {
+    switch (task->state) {
+    case EC_TASK_STATE_ALLOCATED: {
+        std::lock_guard<std::mutex> guard(task->ec->alloc_lock);
+        discard_task(task);
+        break;
+    }
+    case EC_TASK_STATE_SUBMITTED:
+        /* Its last strip gives it back */
+        break;
+    case EC_TASK_STATE_COMPLETED:
+        /* astraea_pe_progress gives it back once reaped */
+        break;
+    case EC_TASK_STATE_FREE:
+        DOCA_LOG_WARN("Task %u is already free", task->id);
+        break;
+    }
+}
+
 astraea_task *astraea_ec_task_create_as_task(astraea_ec_task_create *task) {
-    astraea_task *general_task = new astraea_task;
-    general_task->type = EC_CREATE;
-    general_task->ec_task_create = task;
-    return general_task;
+    return &task->handle;
+}
+
+astraea_task *astraea_ec_task_recover_as_task(astraea_ec_task_recover *task) {
+    return &task->handle;
+}
+
+astraea_task *astraea_ec_task_update_as_task(astraea_ec_task_update *task) {
+    return &task->handle;
 }
 
 doca_error_t astraea_ec_matrix_create(astraea_ec *ec,
@@ -491,28 +1649,140 @@ doca_error_t astraea_ec_matrix_create(astraea_ec *ec,
                                       size_t data_block_count,
                                       size_t rdnc_block_count,
                                       astraea_ec_matrix **matrix) {
-    *matrix = new astraea_ec_matrix;
-    (*matrix)->nb_data_blocks = data_block_count;
-    (*matrix)->nb_rdnc_blocks = rdnc_block_count;
+    std::lock_guard<std::mutex> guard(ec->alloc_lock);
+    return ec->matrix_cache.acquire(type, data_block_count, rdnc_block_count,
+                                    matrix);
+}
+
+doca_error_t astraea_ec_matrix_create_recover(astraea_ec *ec,
+                                              astraea_ec_matrix *coding_matrix,
+                                              const uint32_t *missing_indices,
+                                              size_t nb_missing,
+                                              astraea_ec_matrix **matrix) {
+    std::lock_guard<std::mutex> guard(ec->alloc_lock);
+    return ec->matrix_cache.acquire_recover(coding_matrix, missing_indices,
+                                            nb_missing, matrix);
+}
+
+doca_error_t astraea_ec_matrix_create_update(astraea_ec *ec,
+                                             astraea_ec_matrix *coding_matrix,
+                                             const uint32_t *updated_indices,
+                                             size_t nb_updated,
+                                             astraea_ec_matrix **matrix) {
+    std::lock_guard<std::mutex> guard(ec->alloc_lock);
+    return ec->matrix_cache.acquire_update(coding_matrix, updated_indices,
+                                           nb_updated, matrix);
+}
+
+doca_error_t astraea_ec_matrix_destroy(astraea_ec_matrix *matrix) {
+    std::lock_guard<std::mutex> guard(matrix->owner->alloc_lock);
+    return astraea_matrix_cache::release(matrix);
+}
+
+doca_error_t
+astraea_ec_set_matrix_prewarm(astraea_ec *ec,
+                              const astraea_ec_matrix_geometry *geometries,
+                              uint32_t nb_geometries) {
+    ec->prewarm_geometries.assign(geometries, geometries + nb_geometries);
+    return DOCA_SUCCESS;
+}
 
-    doca_ec_matrix_type demt = type == ASTRAEA_EC_MATRIX_TYPE_CAUCHY
-                                   ? DOCA_EC_MATRIX_TYPE_CAUCHY
-                                   : DOCA_EC_MATRIX_TYPE_VANDERMONDE;
+doca_error_t astraea_ec_prewarm_matrices(astraea_ec *ec) {
+    std::lock_guard<std::mutex> guard(ec->alloc_lock);
+    return ec->matrix_cache.prewarm(ec->prewarm_geometries.data(),
+                                    ec->prewarm_geometries.size());
+}
+
+void astraea_ec_trim_matrix_cache(astraea_ec *ec) {
+    std::lock_guard<std::mutex> guard(ec->alloc_lock);
+    ec->matrix_cache.trim();
+}
 
-    doca_error_t status = doca_ec_matrix_create(
-        ec->ec, demt, data_block_count, rdnc_block_count, &(*matrix)->matrix);
+void astraea_ec_get_matrix_cache_stats(astraea_ec *ec,
+                                       astraea_matrix_cache_stats *stats) {
+    std::lock_guard<std::mutex> guard(ec->alloc_lock);
+    ec->matrix_cache.get_stats(stats);
+}
+
+doca_error_t astraea_ec_load_cost_model(astraea_ec *ec, const char *path) {
+    const astraea_cost_model *model;
+    doca_error_t status = astraea_cost_model_get(path, &model);
     if (status != DOCA_SUCCESS) {
-        delete *matrix;
-        *matrix = nullptr;
+        DOCA_LOG_ERR("Failed to load cost model %s: %s", path,
+                     doca_error_get_descr(status));
+        return status;
     }
+    ec->cost_model.store(model, std::memory_order_release);
+    return DOCA_SUCCESS;
+}
 
-    return status;
+void astraea_ec_set_granularity_ops(astraea_ec *ec,
+                                    const astraea_granularity_ops *ops) {
+    std::lock_guard<std::mutex> guard(ec->alloc_lock);
+    ec->granularity_ops->destroy(ec->granularity_state);
+    ec->granularity_ops = ops;
+    ec->granularity_state = ops->create();
 }
 
-doca_error_t astraea_ec_matrix_destroy(astraea_ec_matrix *matrix) {
-    doca_error_t status = doca_ec_matrix_destroy(matrix->matrix);
+void astraea_ec_get_granularity_stats(astraea_ec *ec,
+                                      astraea_granularity_stats *stats) {
+    std::lock_guard<std::mutex> guard(ec->alloc_lock);
+    *stats = ec->granularity_stats;
+    if (ec->granularity_ops->get_stats) {
+        ec->granularity_ops->get_stats(ec->granularity_state, stats);
+    }
+}
+
+uint32_t astraea_ec_get_queue_occupancy(astraea_ec *ec) {
+    uint32_t occupancy = ec->subtask_queue.size();
+    for (const astraea_edf_queue &queue : ec->edf_queues) {
+        occupancy += queue.size();
+    }
+    return occupancy;
+}
 
-    delete matrix;
+void astraea_ec_get_resource_stats(astraea_ec *ec,
+                                   astraea_ec_resource_stats *stats) {
+    std::lock_guard<std::mutex> guard(ec->alloc_lock);
+    stats->nb_tasks = ec->task_pool.nb_in_use() +
+                      ec->recover_task_pool.nb_in_use() +
+                      ec->update_task_pool.nb_in_use();
+    stats->nb_subtasks = ec->subtask_pool.nb_in_use();
+    stats->nb_task_bufs = ec->nb_task_bufs;
+    stats->nb_scratch_bytes = ec->scratch_allocator.nb_used_bytes();
+    stats->nb_free_bufs = 0;
+    doca_buf_inventory_get_num_free_elements(ec->buf_inventory,
+                                             &stats->nb_free_bufs);
+    stats->nb_idle_doca_tasks = ec->idle_doca_tasks.size() +
+                                ec->idle_recover_tasks.size() +
+                                ec->idle_update_tasks.size();
+}
 
-    return status;
+doca_error_t astraea_ec_get_class_stats(astraea_ec *ec,
+                                        astraea_task_class task_class,
+                                        astraea_ec_class_stats *stats) {
+    if (task_class >= ASTRAEA_NB_TASK_CLASSES) {
+        DOCA_LOG_ERR("Unknown task class %d", task_class);
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    std::lock_guard<std::mutex> guard(ec->alloc_lock);
+    *stats = ec->class_stats[task_class];
+    return DOCA_SUCCESS;
+}
+
+void astraea_ec_invalidate_sgl_cache(astraea_ec *ec, doca_mmap *mmap) {
+    std::lock_guard<std::mutex> guard(ec->alloc_lock);
+    ec->sgl_cache.invalidate(mmap);
+}
+
+void astraea_ec_invalidate_sgl_range(astraea_ec *ec, doca_mmap *mmap,
+                                     const void *addr, size_t len) {
+    std::lock_guard<std::mutex> guard(ec->alloc_lock);
+    ec->sgl_cache.invalidate_range(mmap, addr, len);
+}
+
+void astraea_ec_get_sgl_cache_stats(astraea_ec *ec,
+                                    astraea_sgl_cache_stats *stats) {
+    std::lock_guard<std::mutex> guard(ec->alloc_lock);
+    *stats = ec->sgl_cache.get_stats();
 }
@@ -1,11 +1,10 @@
 #ifndef ASTRAEA_EC_H__
 #define ASTRAEA_EC_H__
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <mutex>
-#include <queue>
-#include <utility>
 #include <vector>
 
 #include <doca_buf.h>
@@ -16,119 +15,645 @@
 #include <doca_mmap.h>
 #include <doca_types.h>
 
+#include "astraea_cost_model.h"
+#include "astraea_doorbell.h"
+#include "astraea_edf.h"
+#include "astraea_gf.h"
+#include "astraea_granularity.h"
+#include "astraea_matrix_cache.h"
+#include "astraea_pe.h"
+#include "astraea_ring.h"
+#include "astraea_scratch.h"
+#include "astraea_sgl_cache.h"
+#include "astraea_slab.h"
+#include "astraea_spillover.h"
+
 constexpr uint32_t MAX_NB_SUBTASKS_PER_TASK = 1024;
 constexpr uint32_t MAX_NB_INFLIGHT_EC_TASKS = 8192;
+constexpr uint32_t EC_SUBTASK_QUEUE_SIZE = 8192;
 constexpr uint32_t MAX_NB_CTX_BUFS = 1024 * 1024;
-constexpr size_t TMP_RDNC_BUFFER_SIZE = 32 * 1024 * 1024 * 32;
+/* In-flight parity bytes of sliced tasks, see astraea_ec_set_scratch_size */
+constexpr size_t DEFAULT_RDNC_SCRATCH_SIZE = 64 * 1024 * 1024;
 constexpr uint32_t MAX_NB_DATA_BLOCKS = 128;
 constexpr uint32_t MAX_NB_RDNC_BLOCKS = 32;
+/* Share of the ctx bufs that prebuilt source chains may keep */
+constexpr uint32_t MAX_NB_SGL_CACHED_BUFS = MAX_NB_CTX_BUFS / 4;
+
+/* Task descriptors grow 64 at a time, subtask descriptors 1024 at a time */
+constexpr uint32_t EC_TASK_SLAB_CHUNK_SHIFT = 6;
+constexpr uint32_t EC_SUBTASK_SLAB_CHUNK_SHIFT = 10;
+constexpr uint32_t EC_TASK_SLAB_NB_CHUNKS =
+    MAX_NB_INFLIGHT_EC_TASKS >> EC_TASK_SLAB_CHUNK_SHIFT;
+constexpr uint32_t EC_SUBTASK_SLAB_NB_CHUNKS =
+    (MAX_NB_INFLIGHT_EC_TASKS * MAX_NB_SUBTASKS_PER_TASK) >>
+    EC_SUBTASK_SLAB_CHUNK_SHIFT;
 
 /**
  * Forward declarations
  */
 struct astraea_task;
 struct astraea_ctx;
+struct astraea_pe;
+struct astraea_session;
 
 /* Forward declaration for structs in this file */
 struct astraea_ec;
+struct _astraea_ec_task;
 struct astraea_ec_task_create;
+struct astraea_ec_task_recover;
+struct astraea_ec_task_update;
 ///////////////////////
 
 typedef void (*astraea_ec_task_create_completion_cb_t)(
     astraea_ec_task_create *task, doca_data task_user_data,
     doca_data ctx_user_data);
 
-struct _astraea_ec_subtask_create_user_data {
-    bool is_sub;
-    bool is_last;
-    uint32_t strip_id;
-    astraea_ec_task_create *origin_task;
+typedef void (*astraea_ec_task_recover_completion_cb_t)(
+    astraea_ec_task_recover *task, doca_data task_user_data,
+    doca_data ctx_user_data);
+
+typedef void (*astraea_ec_task_update_completion_cb_t)(
+    astraea_ec_task_update *task, doca_data task_user_data,
+    doca_data ctx_user_data);
+
+/**
+ * A descriptor is taken from its pool by allocate_init and goes back when
+ * its last strip completes, or when it is freed before being submitted
+ * Tasks of a kind configured without callbacks go back once reaped instead
+ */
+enum astraea_ec_task_state {
+    EC_TASK_STATE_FREE,
+    EC_TASK_STATE_ALLOCATED,
+    EC_TASK_STATE_SUBMITTED,
+    /* Waits in astraea_pe::completed_tasks for astraea_pe_progress */
+    EC_TASK_STATE_COMPLETED,
 };
 
-struct _astraea_ec_subtask_create {
-    doca_ec_task_create *task;
-    _astraea_ec_subtask_create_user_data *user_data;
+/* The DOCA task each strip of an ec task runs */
+enum astraea_ec_task_kind {
+    EC_TASK_KIND_CREATE,
+    EC_TASK_KIND_RECOVER,
+    EC_TASK_KIND_UPDATE,
 };
 
-struct astraea_ec_matrix {
-    doca_ec_matrix *matrix;
-    uint32_t nb_data_blocks;
-    uint32_t nb_rdnc_blocks;
+struct _astraea_ec_subtask_user_data {
+    bool is_sub;
+    uint32_t strip_id;
+    uint32_t subtask_id;
+    _astraea_ec_task *origin_task;
+};
+
+struct _astraea_ec_subtask {
+    /**
+     * What the submitter hands to DOCA, whatever the kind
+     * Armed by the submitter, nullptr until then and on software ecs
+     */
+    doca_task *task;
+    union {
+        doca_ec_task_create *create_task;
+        doca_ec_task_recover *recover_task;
+        doca_ec_task_update *update_task;
+    };
+    /* The blocks the strip reads and writes */
+    doca_buf *src_buf;
+    doca_buf *dst_buf;
+    _astraea_ec_subtask_user_data user_data;
+    /* Id of the next strip of the same task */
+    uint32_t next;
 };
 
-struct astraea_ec_task_create {
+/**
+ * Everything sliced, token-gated ec tasks have in common
+ * Strips read nb_data_blocks blocks of src_blocks and write nb_rdnc_blocks
+ * blocks of dst_blocks, as the matrix of the task says
+ */
+struct _astraea_ec_task {
+    astraea_ec_task_kind kind;
+    /* What astraea_ec_task_*_as_task hands out, set when allocated */
+    astraea_task handle;
     /* Resources managed by task itself */
-    // std::vector<_astraea_ec_subtask_create *> subtasks;
-    std::vector<std::pair<doca_buf *, doca_buf *>> sub_buf_pairs;
-    _astraea_ec_subtask_create *subtask_pool[MAX_NB_SUBTASKS_PER_TASK];
-    uint32_t cur_subtask_pos;
+    /* Parity bufs of each strip, returned when the task finishes */
+    std::vector<doca_buf *> sub_dst_bufs;
+    /* Source chains of sliced tasks, shared through astraea_ec::sgl_cache */
+    astraea_sgl_plan *sgl_plan = nullptr;
+    /* Strips are chained through _astraea_ec_subtask::next */
+    uint32_t first_subtask, last_subtask;
+    uint32_t nb_subtasks;
+    uint32_t id;
+    /* The task completes when the last outstanding strip comes back */
+    uint32_t nb_pending_subtasks;
+    bool has_failed_subtask;
+    /* Parity region of sliced tasks inside astraea_ec::rdnc_scratch */
+    size_t scratch_offset;
+    bool has_scratch = false;
 
     /* Metadatas that we only want to set once */
     size_t origin_block_size;
     size_t sub_block_size;
     uint8_t *dst_base_addr;
+    /* Tokens each strip reserves, the modelled cost spread over the strips */
+    uint32_t strip_token_cost;
 
     /* Resources managed by other objects */
     doca_data user_data;
-    doca_buf *original_data_blocks;
-    doca_buf *rdnc_blocks;
+    /**
+     * Data blocks to encode, the blocks left to recover from, or the old and
+     * new copies of the changed blocks followed by the old parity
+     */
+    doca_buf *src_blocks;
+    /* Parity blocks, the recovered blocks, or the new parity */
+    doca_buf *dst_blocks;
     astraea_ec *ec;
     astraea_ec_matrix *matrix;
+    std::chrono::high_resolution_clock::time_point submit_time;
     std::chrono::high_resolution_clock::time_point expected_time;
-    bool is_free;
+    std::chrono::high_resolution_clock::time_point finish_time;
+    astraea_ec_task_state state = EC_TASK_STATE_FREE;
+    /* Set by astraea_task_set_class and astraea_task_set_latency_sla */
+    astraea_task_class task_class;
+    std::chrono::microseconds latency_sla;
+
+    /* Owned by astraea_ec::edf_queues while strips wait for tokens */
+    _astraea_ec_task *edf_next;
+    uint64_t edf_slot;
+    uint32_t next_queued_subtask;
+    uint32_t nb_queued_subtasks;
+
+    /* Owned by the pe while the task waits to be reaped */
+    _astraea_ec_task *completed_next;
+};
+
+struct astraea_ec_task_create : _astraea_ec_task {};
+
+/* Rebuilds lost blocks, scheduled and sliced like a create task */
+struct astraea_ec_task_recover : _astraea_ec_task {};
+
+/* Folds changed data blocks into the parity instead of encoding the stripe */
+struct astraea_ec_task_update : _astraea_ec_task {};
+
+/**
+ * What tasks that have not completed or been freed hold, constant under a
+ * steady load, see astraea_ec_get_resource_stats
+ */
+struct astraea_ec_resource_stats {
+    uint32_t nb_tasks;
+    uint32_t nb_subtasks;
+    /* Parity bufs of sliced strips */
+    uint32_t nb_task_bufs;
+    size_t nb_scratch_bytes;
+    /* Bufs left in the inventory, prebuilt source chains hold some too */
+    uint32_t nb_free_bufs;
+    /* DOCA tasks kept for the next strips */
+    uint32_t nb_idle_doca_tasks;
 };
 
-enum astraea_ec_matrix_type {
-    ASTRAEA_EC_MATRIX_TYPE_CAUCHY = DOCA_EC_MATRIX_TYPE_CAUCHY,
-    ASTRAEA_EC_MATRIX_TYPE_VANDERMONDE = DOCA_EC_MATRIX_TYPE_VANDERMONDE,
+/* Tasks of one class that finished, see astraea_ec_get_class_stats */
+struct astraea_ec_class_stats {
+    uint64_t nb_tasks;
+    uint64_t nb_sla_misses;
+    /* Submission to completion, summed over nb_tasks */
+    uint64_t total_latency_us;
+};
+
+/* A strip the software backend has run, see astraea_ec_create_software */
+struct astraea_ec_sw_completion {
+    uint32_t subtask_id;
+    bool has_failed;
 };
 
 struct astraea_ec {
+    /* nullptr on software ecs */
     doca_ec *ec;
     astraea_ec_task_create_completion_cb_t success_cb;
     astraea_ec_task_create_completion_cb_t error_cb;
+    astraea_ec_task_recover_completion_cb_t recover_success_cb;
+    astraea_ec_task_recover_completion_cb_t recover_error_cb;
+    astraea_ec_task_update_completion_cb_t update_success_cb;
+    astraea_ec_task_update_completion_cb_t update_error_cb;
     doca_dev *dev;
+    /* Token bucket and sla the ctx is scheduled under */
+    astraea_session *session;
+    /* Set by astraea_pe_connect_ctx, told when a task finishes */
+    astraea_pe *pe;
 
-    void *tmp_rdnc_buffer;
+    /**
+     * Producers may allocate tasks from any thread while the pe thread
+     * completes them, descriptors, bufs, scratch, source chains, the
+     * granularity strategy and the matrix cache are only touched under this
+     * lock. It is never held across a DOCA ctx call or a user callback
+     */
+    std::mutex alloc_lock;
+
+    /**
+     * Predicts task time and token cost, shared with other ecs
+     * Swapped by astraea_ec_load_cost_model while producers read it, models
+     * are immutable and never freed
+     */
+    std::atomic<const astraea_cost_model *> cost_model;
+
+    /* Picks the strip size of new tasks, told how each task went */
+    const astraea_granularity_ops *granularity_ops;
+    void *granularity_state;
+    astraea_granularity_stats granularity_stats;
+
+    /**
+     * Sliced tasks write parity here before it is copied to rdnc_blocks
+     * Each task owns a region until its last strip completes
+     */
+    void *rdnc_scratch;
+    size_t rdnc_scratch_size;
+    astraea_scratch_allocator scratch_allocator;
     doca_mmap *dst_mmap;
     doca_buf_inventory *buf_inventory;
+    /* Bufs the sub_dst_bufs of tasks hold */
+    uint32_t nb_task_bufs;
+    astraea_sgl_cache sgl_cache;
+    astraea_matrix_cache matrix_cache;
+    /* Matrices created when the ctx starts */
+    std::vector<astraea_ec_matrix_geometry> prewarm_geometries;
 
-    astraea_ec_task_create *task_pool[MAX_NB_INFLIGHT_EC_TASKS];
+    /* Descriptors are handed out lazily and recycled on completion */
+    astraea_slab<astraea_ec_task_create, EC_TASK_SLAB_CHUNK_SHIFT,
+                 EC_TASK_SLAB_NB_CHUNKS>
+        task_pool;
+    astraea_slab<astraea_ec_task_recover, EC_TASK_SLAB_CHUNK_SHIFT,
+                 EC_TASK_SLAB_NB_CHUNKS>
+        recover_task_pool;
+    astraea_slab<astraea_ec_task_update, EC_TASK_SLAB_CHUNK_SHIFT,
+                 EC_TASK_SLAB_NB_CHUNKS>
+        update_task_pool;
+    astraea_slab<_astraea_ec_subtask, EC_SUBTASK_SLAB_CHUNK_SHIFT,
+                 EC_SUBTASK_SLAB_NB_CHUNKS>
+        subtask_pool;
+    /**
+     * DOCA tasks of completed strips, re-armed through the setters
+     * At most MAX_NB_INFLIGHT_EC_TASKS of each kind are ever allocated from
+     * the ctx. Only the submitter and completions touch them, under the ctx
+     * lock
+     */
+    std::vector<doca_ec_task_create *> idle_doca_tasks;
+    std::vector<doca_ec_task_recover *> idle_recover_tasks;
+    std::vector<doca_ec_task_update *> idle_update_tasks;
     /**
      * It is a producer-consumer model
-     * prod_pos will move only when a task is submitted
-     * We assume tasks are submitted in FIFO
+     * astraea_task_submit pushes the first strip of a task, from any
+     * thread. The submitter moves the task to the edf queue of its class
+     * and dispatches its strips from there
+     */
+    astraea_mpsc_ring<uint32_t, EC_SUBTASK_QUEUE_SIZE> subtask_queue;
+    astraea_edf_queue edf_queues[ASTRAEA_NB_TASK_CLASSES];
+    /**
+     * Deficit round robin over the classes with queued strips, each
+     * dispatched strip is charged to the credit of its class
+     */
+    uint32_t dispatch_class;
+    int32_t class_credits[ASTRAEA_NB_TASK_CLASSES];
+    /* Under alloc_lock, completions and readers run on different threads */
+    astraea_ec_class_stats class_stats[ASTRAEA_NB_TASK_CLASSES];
+    /* Rung after every push so a parked submitter wakes up */
+    astraea_doorbell doorbell;
+    /**
+     * Bumped by every strip that comes back, giving up its DOCA task or its
+     * room in sw_completions. After DOCA refused a strip the submitter
+     * raises is_dispatch_blocked and waits for the sequence to move, the
+     * strip that lowers it rings the doorbell
+     */
+    std::atomic<uint32_t> strip_return_seq{0};
+    std::atomic<bool> is_dispatch_blocked{false};
+
+    /**
+     * Strips run on the CPU, in the submitter, under the same tokens
+     * Their completions wait here until astraea_pe_progress
      */
-    doca_ec_task_create *subtask_queue[MAX_NB_INFLIGHT_EC_TASKS];
-    std::mutex subtask_locks[MAX_NB_INFLIGHT_EC_TASKS];
-    uint32_t prod_pos, cons_pos, alloc_pos;
+    bool is_software;
+    astraea_gf_kernel gf_kernel;
+    astraea_spsc_ring<astraea_ec_sw_completion, EC_SUBTASK_QUEUE_SIZE>
+        sw_completions;
+
+    /**
+     * Device ecs in hybrid mode, workers that run the strips the bucket has
+     * no tokens for, see astraea_ec_set_spillover
+     */
+    uint32_t nb_spillover_workers;
+    astraea_spillover_pool *spillover;
 };
 
+/**
+ * DOCA is out of tasks or queue room, or the completions of a software ec
+ * are not drained yet. The strip waits for another one to come back
+ */
+static inline bool is_backpressure(doca_error_t status) {
+    return status == DOCA_ERROR_NO_MEMORY || status == DOCA_ERROR_AGAIN;
+}
+
+/**
+ * ctxs of the same session share its token bucket, they may be driven by
+ * different pes on different threads
+ */
+doca_error_t astraea_ec_create(astraea_session *session, doca_dev *dev,
+                               astraea_ec **ec);
+
+/* Uses the session of the process's astraea_authenticator */
 doca_error_t astraea_ec_create(doca_dev *dev, astraea_ec **ec);
 
+/**
+ * An ec that encodes on the CPU with the GF(2^8) kernels of astraea_gf.h,
+ * for hosts without a device
+ * Matrices, tasks, tokens and completions work as on a DOCA ec and parity
+ * is byte-identical. Memory only needs an mmap that is started, with no
+ * device added.
+ */
+doca_error_t astraea_ec_create_software(astraea_session *session,
+                                        astraea_ec **ec);
+
+doca_error_t astraea_ec_create_software(astraea_ec **ec);
+
 doca_error_t astraea_ec_destroy(astraea_ec *ec);
 
+/**
+ * Pick the kernel strips run on the CPU with, those of a software ec and
+ * spilled ones, the default is astraea_gf_best_kernel
+ */
+doca_error_t astraea_ec_set_gf_kernel(astraea_ec *ec,
+                                      astraea_gf_kernel kernel);
+
+/**
+ * Next strip to dispatch, called by the submitter
+ * The class is picked by weight among those with queued strips, then the
+ * strip with the earliest deadline of the class. Tasks astraea_task_submit
+ * queued since the last call are taken in first
+ */
+bool astraea_ec_peek_subtask(astraea_ec *ec, uint32_t *subtask_id);
+
+/* Dispatch the strip returned by the last successful peek */
+void astraea_ec_pop_subtask(astraea_ec *ec);
+
+/* Strips waiting for tokens, called by the submitter */
+uint32_t astraea_ec_nb_queued_subtasks(astraea_ec *ec);
+
+/* Tokens the strips waiting for them cost, called by the submitter */
+uint64_t astraea_ec_nb_queued_tokens(astraea_ec *ec);
+
+/**
+ * Give the strip of a device ec its DOCA task, a parked one if any, called
+ * by the submitter under the ctx lock right before handing it to DOCA
+ * Producer threads then never call into the DOCA ctx. A strip that is
+ * already armed keeps its task
+ */
+doca_error_t astraea_ec_arm_subtask(astraea_ec *ec, uint32_t subtask_id);
+
+/**
+ * Run the strip of a software ec and queue its completion, called by the
+ * submitter
+ * Return DOCA_ERROR_AGAIN while the completions of earlier strips have not
+ * been drained
+ */
+doca_error_t astraea_ec_sw_submit(astraea_ec *ec, uint32_t subtask_id);
+
+/**
+ * Complete the strips run on the CPU, by a software ec or by spillover
+ * workers, called by astraea_pe_progress
+ * Completions take the same path as those of DOCA, the task finishes once
+ * all of its strips are back wherever they ran
+ * Return the number of strips completed
+ */
+uint32_t astraea_ec_sw_progress(astraea_ec *ec);
+
+/* Strips run on the CPU wait for astraea_ec_sw_progress, a snapshot */
+bool astraea_ec_has_cpu_completions(astraea_ec *ec);
+
+/* Fill completion from a completed task and give the task back */
+void astraea_ec_reap_task(_astraea_ec_task *task,
+                          astraea_completion *completion);
+
+/**
+ * Hybrid mode: while the token bucket is empty, hand queued strips to
+ * nb_workers CPU threads as long as they would finish before the next
+ * refresh, instead of leaving them queued
+ * Spilled strips cost no tokens. 0 turns it off, the default. Must be
+ * called before the first matrix is created, spilled strips need the
+ * coefficients the CPU encodes with, and before astraea_ctx_start
+ */
+doca_error_t astraea_ec_set_spillover(astraea_ec *ec, uint32_t nb_workers);
+
+/* Start the workers, called by astraea_ctx_start */
+doca_error_t astraea_ec_start_spillover(astraea_ec *ec);
+
+/**
+ * Let the workers finish what they were handed and complete it, called by
+ * astraea_ctx_stop
+ */
+void astraea_ec_stop_spillover(astraea_ec *ec);
+
+/**
+ * Spill queued strips from the head of the queue while they finish within
+ * budget_ns, at most max_nb_strips, called by the submitter
+ * Return the number of strips spilled
+ */
+uint32_t astraea_ec_spill(astraea_ec *ec, uint64_t budget_ns,
+                          uint32_t max_nb_strips);
+
+void astraea_ec_get_spillover_stats(astraea_ec *ec,
+                                    astraea_spillover_stats *stats);
+
+/**
+ * Give back a task that was never submitted, with its strips, bufs and
+ * scratch region, called by astraea_task_free
+ * Submitted tasks are given back when their last strip completes
+ */
+void astraea_ec_task_free(_astraea_ec_task *task);
+
 astraea_ctx *astraea_ec_as_ctx(astraea_ec *ec);
 
+/**
+ * Bound the parity bytes that sliced tasks may hold at the same time
+ * Must be called before astraea_ctx_start
+ */
+doca_error_t astraea_ec_set_scratch_size(astraea_ec *ec, size_t size);
+
+/* Allocate and register the scratch region, called by astraea_ctx_start */
+doca_error_t astraea_ec_prepare_scratch(astraea_ec *ec);
+
+/**
+ * Free the DOCA tasks kept for reuse and those of strips that were armed
+ * but never submitted, called by astraea_ctx_stop
+ */
+void astraea_ec_free_idle_tasks(astraea_ec *ec);
+
+/**
+ * Pass nullptr for both callbacks to reap completed tasks in batches with
+ * astraea_pe_progress instead, outside of the DOCA callbacks and the ctx
+ * locks. The same goes for recover and update tasks
+ */
 doca_error_t astraea_ec_task_create_set_conf(
     astraea_ec *ec,
     astraea_ec_task_create_completion_cb_t successful_task_completion_cb,
     astraea_ec_task_create_completion_cb_t error_task_completion_cb,
     uint32_t num_tasks);
 
+/**
+ * dst_mmap is the mmap that holds rdnc_blocks
+ * Sliced strips then write parity straight into rdnc_blocks through a chain
+ * of strided bufs, pass nullptr to stage parity in the scratch region and
+ * copy it back on completion instead
+ * Tasks of every kind may be allocated, submitted and freed from several
+ * threads at once, while another thread drives the pe
+ */
 doca_error_t astraea_ec_task_create_allocate_init(
     astraea_ec *ec, astraea_ec_matrix *coding_matrix, doca_mmap *src_mmap,
-    doca_buf *original_data_blocks, doca_buf *rdnc_blocks, doca_data user_data,
-    astraea_ec_task_create **task);
+    doca_buf *original_data_blocks, doca_mmap *dst_mmap, doca_buf *rdnc_blocks,
+    doca_data user_data, astraea_ec_task_create **task);
 
+/**
+ * The handle is part of the task, it allocates nothing and is valid until
+ * the task completes or is freed
+ */
 astraea_task *astraea_ec_task_create_as_task(astraea_ec_task_create *task);
 
+doca_error_t astraea_ec_task_recover_set_conf(
+    astraea_ec *ec,
+    astraea_ec_task_recover_completion_cb_t successful_task_completion_cb,
+    astraea_ec_task_recover_completion_cb_t error_task_completion_cb,
+    uint32_t num_tasks);
+
+/**
+ * recover_matrix comes from astraea_ec_matrix_create_recover
+ * available_blocks holds the k surviving blocks in index order,
+ * recovered_data_blocks receives the missing ones in index order. The task
+ * costs tokens and is sliced like a create task of k data and nb_missing
+ * parity blocks, dst_mmap works the same way.
+ */
+doca_error_t astraea_ec_task_recover_allocate_init(
+    astraea_ec *ec, astraea_ec_matrix *recover_matrix, doca_mmap *src_mmap,
+    doca_buf *available_blocks, doca_mmap *dst_mmap,
+    doca_buf *recovered_data_blocks, doca_data user_data,
+    astraea_ec_task_recover **task);
+
+astraea_task *astraea_ec_task_recover_as_task(astraea_ec_task_recover *task);
+
+doca_error_t astraea_ec_task_update_set_conf(
+    astraea_ec *ec,
+    astraea_ec_task_update_completion_cb_t successful_task_completion_cb,
+    astraea_ec_task_update_completion_cb_t error_task_completion_cb,
+    uint32_t num_tasks);
+
+/**
+ * update_matrix comes from astraea_ec_matrix_create_update
+ * original_updated_and_rdnc_blocks holds the old then new copy of each
+ * changed block in index order, followed by the m current parity blocks.
+ * updated_rdnc_blocks receives the m new parity blocks. The task is priced
+ * by the changed blocks only, not by the k blocks of the stripe, and
+ * sliced like a create task over the 2n + m blocks it reads.
+ */
+doca_error_t astraea_ec_task_update_allocate_init(
+    astraea_ec *ec, astraea_ec_matrix *update_matrix, doca_mmap *src_mmap,
+    doca_buf *original_updated_and_rdnc_blocks, doca_mmap *dst_mmap,
+    doca_buf *updated_rdnc_blocks, doca_data user_data,
+    astraea_ec_task_update **task);
+
+astraea_task *astraea_ec_task_update_as_task(astraea_ec_task_update *task);
+
+/**
+ * Return the ec's matrix of (type, k, m), creating it on first use
+ * Every handle must be given back with astraea_ec_matrix_destroy, the
+ * matrix itself stays cached until astraea_ec_trim_matrix_cache or
+ * astraea_ec_destroy
+ */
 doca_error_t astraea_ec_matrix_create(astraea_ec *ec,
                                       astraea_ec_matrix_type type,
                                       size_t data_block_count,
                                       size_t rdnc_block_count,
                                       astraea_ec_matrix **matrix);
 
+/**
+ * Return the matrix recovering the blocks at missing_indices, counted over
+ * the k data then m parity blocks of coding_matrix in ascending order
+ * Matrices are cached per erasure pattern like coding matrices, release
+ * them with astraea_ec_matrix_destroy
+ */
+doca_error_t astraea_ec_matrix_create_recover(astraea_ec *ec,
+                                              astraea_ec_matrix *coding_matrix,
+                                              const uint32_t *missing_indices,
+                                              size_t nb_missing,
+                                              astraea_ec_matrix **matrix);
+
+/**
+ * Return the matrix folding changes of the data blocks at updated_indices,
+ * counted over the k data blocks of coding_matrix in ascending order, into
+ * its parity
+ * Cached per pattern of changed blocks, release with
+ * astraea_ec_matrix_destroy
+ */
+doca_error_t astraea_ec_matrix_create_update(astraea_ec *ec,
+                                             astraea_ec_matrix *coding_matrix,
+                                             const uint32_t *updated_indices,
+                                             size_t nb_updated,
+                                             astraea_ec_matrix **matrix);
+
 doca_error_t astraea_ec_matrix_destroy(astraea_ec_matrix *matrix);
 
+/**
+ * Geometries whose matrices astraea_ctx_start creates, so the first tasks
+ * do not wait for them
+ * Must be called before astraea_ctx_start
+ */
+doca_error_t
+astraea_ec_set_matrix_prewarm(astraea_ec *ec,
+                              const astraea_ec_matrix_geometry *geometries,
+                              uint32_t nb_geometries);
+
+/* Create the matrices set by astraea_ec_set_matrix_prewarm */
+doca_error_t astraea_ec_prewarm_matrices(astraea_ec *ec);
+
+/* Free the cached matrices no handle refers to */
+void astraea_ec_trim_matrix_cache(astraea_ec *ec);
+
+void astraea_ec_get_matrix_cache_stats(astraea_ec *ec,
+                                       astraea_matrix_cache_stats *stats);
+
+/**
+ * Price tasks with the calibration table at path, see astraea_cost_model_get
+ * New ecs load the table named by ASTRAEA_COST_MODEL, or fall back to the
+ * builtin fit
+ */
+doca_error_t astraea_ec_load_cost_model(astraea_ec *ec, const char *path);
+
+/**
+ * Replace the strategy that slices new tasks, the default is
+ * astraea_granularity_adaptive
+ * Tasks already created keep their strips
+ */
+void astraea_ec_set_granularity_ops(astraea_ec *ec,
+                                    const astraea_granularity_ops *ops);
+
+void astraea_ec_get_granularity_stats(astraea_ec *ec,
+                                      astraea_granularity_stats *stats);
+
+/**
+ * Number of strips waiting for tokens, a snapshot for monitoring
+ * Tasks the submitter has not taken in yet count as one strip
+ */
+uint32_t astraea_ec_get_queue_occupancy(astraea_ec *ec);
+
+void astraea_ec_get_resource_stats(astraea_ec *ec,
+                                   astraea_ec_resource_stats *stats);
+
+doca_error_t astraea_ec_get_class_stats(astraea_ec *ec,
+                                        astraea_task_class task_class,
+                                        astraea_ec_class_stats *stats);
+
+/**
+ * Sliced tasks reuse the source chains built for a previous task on the same
+ * (mmap, address, k, block size, granularity)
+ * Invalidate before destroying src_mmap or freeing memory registered in it,
+ * a nullptr mmap drops every cached chain
+ */
+void astraea_ec_invalidate_sgl_cache(astraea_ec *ec, doca_mmap *mmap);
+
+void astraea_ec_invalidate_sgl_range(astraea_ec *ec, doca_mmap *mmap,
+                                     const void *addr, size_t len);
+
+void astraea_ec_get_sgl_cache_stats(astraea_ec *ec,
+                                    astraea_sgl_cache_stats *stats);
+
 #endif
\ No newline at end of file
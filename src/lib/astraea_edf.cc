@@ -0,0 +1,162 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "astraea_ec.h"
+#include "astraea_edf.h"
+
+static inline uint64_t deadline_slot(const _astraea_ec_task *task) {
+    const uint64_t deadline_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            task->expected_time.time_since_epoch())
+            .count();
+    return deadline_ns >> EDF_SLOT_SHIFT;
+}
+
+astraea_edf_queue::astraea_edf_queue() : slots(EDF_NB_SLOTS) {}
+
+void astraea_edf_queue::link(_astraea_ec_task *task, uint64_t abs_slot,
+                             bool is_front) {
+    const uint32_t index = abs_slot & (EDF_NB_SLOTS - 1);
+    slot &s = slots[index];
+    if (s.head == nullptr) {
+        task->edf_next = nullptr;
+        s.head = s.tail = task;
+        occupied[index / 64] |= uint64_t{1} << (index % 64);
+    } else if (is_front) {
+        task->edf_next = s.head;
+        s.head = task;
+    } else {
+        task->edf_next = nullptr;
+        s.tail->edf_next = task;
+        s.tail = task;
+    }
+    if (abs_slot > max_slot) {
+        max_slot = abs_slot;
+    }
+    nb_tasks++;
+}
+
+void astraea_edf_queue::push_overflow(_astraea_ec_task *task,
+                                      uint64_t abs_slot) {
+    task->edf_next = nullptr;
+    if (overflow_head == nullptr) {
+        overflow_head = overflow_tail = task;
+        overflow_min_slot = abs_slot;
+        return;
+    }
+    overflow_tail->edf_next = task;
+    overflow_tail = task;
+    if (abs_slot < overflow_min_slot) {
+        overflow_min_slot = abs_slot;
+    }
+}
+
+void astraea_edf_queue::push(_astraea_ec_task *task) {
+    task->next_queued_subtask = task->first_subtask;
+    task->nb_queued_subtasks = task->nb_subtasks;
+    nb_strips.fetch_add(task->nb_subtasks, std::memory_order_relaxed);
+    nb_strip_tokens.fetch_add(
+        uint64_t{task->nb_subtasks} * task->strip_token_cost,
+        std::memory_order_relaxed);
+
+    uint64_t abs_slot = deadline_slot(task);
+    task->edf_slot = abs_slot;
+
+    /* Overflowed tasks all come after the wheel, keep it that way */
+    if (overflow_head && abs_slot >= overflow_min_slot) {
+        push_overflow(task, abs_slot);
+        return;
+    }
+
+    bool is_front = false;
+    if (nb_tasks == 0) {
+        cursor = max_slot = abs_slot;
+    } else if (abs_slot < cursor) {
+        /* Move the wheel back unless its latest task would fall off */
+        if (max_slot - abs_slot < EDF_NB_SLOTS) {
+            cursor = abs_slot;
+        } else {
+            abs_slot = cursor;
+            is_front = true;
+        }
+    }
+
+    if (abs_slot - cursor >= EDF_NB_SLOTS) {
+        push_overflow(task, abs_slot);
+        return;
+    }
+    link(task, abs_slot, is_front);
+}
+
+void astraea_edf_queue::rebase() {
+    _astraea_ec_task *task = overflow_head;
+    overflow_head = overflow_tail = nullptr;
+    cursor = max_slot = overflow_min_slot;
+
+    while (task) {
+        _astraea_ec_task *next = task->edf_next;
+        if (task->edf_slot - cursor < EDF_NB_SLOTS) {
+            link(task, task->edf_slot, false);
+        } else {
+            push_overflow(task, task->edf_slot);
+        }
+        task = next;
+    }
+}
+
+void astraea_edf_queue::advance() {
+    const uint32_t begin = cursor & (EDF_NB_SLOTS - 1);
+    uint32_t word = begin / 64;
+    uint64_t bits = occupied[word] & (~uint64_t{0} << (begin % 64));
+
+    /* One more word than the bitmap holds wraps back to the bits before */
+    for (uint32_t i = 0; i <= EDF_NB_BITMAP_WORDS; i++) {
+        if (bits) {
+            const uint32_t index = word * 64 + __builtin_ctzll(bits);
+            cursor += (index - begin) & (EDF_NB_SLOTS - 1);
+            return;
+        }
+        word = (word + 1) % EDF_NB_BITMAP_WORDS;
+        bits = occupied[word];
+    }
+}
+
+bool astraea_edf_queue::peek(uint32_t &subtask_id) {
+    if (nb_tasks == 0) {
+        if (overflow_head == nullptr) {
+            return false;
+        }
+        rebase();
+    }
+
+    const slot &s = slots[cursor & (EDF_NB_SLOTS - 1)];
+    if (s.head == nullptr) {
+        advance();
+    }
+    const _astraea_ec_task *task = slots[cursor & (EDF_NB_SLOTS - 1)].head;
+    subtask_id = task->next_queued_subtask;
+    peeked_next = task->ec->subtask_pool[subtask_id].next;
+    peeked_token_cost = task->strip_token_cost;
+    return true;
+}
+
+void astraea_edf_queue::pop() {
+    const uint32_t index = cursor & (EDF_NB_SLOTS - 1);
+    slot &s = slots[index];
+    _astraea_ec_task *task = s.head;
+
+    nb_strips.fetch_sub(1, std::memory_order_relaxed);
+    nb_strip_tokens.fetch_sub(peeked_token_cost, std::memory_order_relaxed);
+    task->next_queued_subtask = peeked_next;
+    if (--task->nb_queued_subtasks > 0) {
+        return;
+    }
+
+    s.head = task->edf_next;
+    if (s.head == nullptr) {
+        s.tail = nullptr;
+        occupied[index / 64] &= ~(uint64_t{1} << (index % 64));
+    }
+    nb_tasks--;
+}
@@ -0,0 +1,90 @@
+#ifndef ASTRAEA_EDF_H__
+#define ASTRAEA_EDF_H__
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Forward declarations
+ */
+struct _astraea_ec_task;
+
+/* Deadlines are bucketed into 16us slots, the wheel spans 67ms */
+constexpr uint32_t EDF_SLOT_SHIFT = 14;
+constexpr uint32_t EDF_NB_SLOTS = 4096;
+constexpr uint32_t EDF_NB_BITMAP_WORDS = EDF_NB_SLOTS / 64;
+
+/**
+ * Strips waiting for tokens, earliest deadline first
+ *
+ * A timing wheel of tasks keyed on their expected_time, each slot is a FIFO
+ * of tasks linked through _astraea_ec_task::edf_next and a bitmap finds the
+ * next occupied slot. Strips of a task go out in order, the front task
+ * changes as soon as a task with an earlier deadline is pushed, so strips of
+ * different tasks interleave.
+ * Deadlines past the wheel wait in an overflow list until the wheel drains,
+ * deadlines already behind the front go to the front. Tasks whose deadlines
+ * share a slot keep their push order.
+ * Only driven by the submitter, size may be read from anywhere.
+ */
+class astraea_edf_queue {
+  public:
+    astraea_edf_queue();
+
+    /* Queue every strip of task */
+    void push(_astraea_ec_task *task);
+
+    /* Next strip to dispatch, false if no strip is queued */
+    bool peek(uint32_t &subtask_id);
+
+    /**
+     * Dispatch the strip returned by the last successful peek
+     * Only touches what the submitter owns, the strip may have completed
+     * and its task been reused by then
+     */
+    void pop();
+
+    /* Only a snapshot off the submitter */
+    uint32_t size() const { return nb_strips.load(std::memory_order_relaxed); }
+
+    /* Tokens the queued strips cost, see _astraea_ec_task::strip_token_cost */
+    uint64_t nb_tokens() const {
+        return nb_strip_tokens.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct slot {
+        _astraea_ec_task *head = nullptr;
+        _astraea_ec_task *tail = nullptr;
+    };
+
+    void link(_astraea_ec_task *task, uint64_t abs_slot, bool is_front);
+
+    void push_overflow(_astraea_ec_task *task, uint64_t abs_slot);
+
+    /* Move the wheel to the earliest overflowed deadline */
+    void rebase();
+
+    /* Point cursor at the first occupied slot, the wheel is not empty */
+    void advance();
+
+    std::vector<slot> slots;
+    uint64_t occupied[EDF_NB_BITMAP_WORDS] = {};
+    /* Absolute slot of the front task and the latest one on the wheel */
+    uint64_t cursor = 0;
+    uint64_t max_slot = 0;
+    uint32_t nb_tasks = 0;
+    /* Strip after the peeked one and its cost, read before it is dispatched */
+    uint32_t peeked_next = 0;
+    uint32_t peeked_token_cost = 0;
+
+    _astraea_ec_task *overflow_head = nullptr;
+    _astraea_ec_task *overflow_tail = nullptr;
+    uint64_t overflow_min_slot = 0;
+
+    std::atomic<uint32_t> nb_strips{0};
+    std::atomic<uint64_t> nb_strip_tokens{0};
+};
+
+#endif
@@ -0,0 +1,440 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include <doca_error.h>
+
+#include "astraea_gf.h"
+
+/* Reduction polynomial x^8 + x^4 + x^3 + x^2 + 1, generator 2 */
+constexpr uint32_t GF_POLY = 0x11d;
+
+/* Vector kernels produce this many parity blocks per pass over the data */
+constexpr uint32_t GF_NB_ROWS_PER_PASS = 4;
+
+struct gf_log_tables {
+    /* exp is doubled so a product never reduces its log sum */
+    uint8_t exp[512];
+    uint8_t log[256];
+};
+
+static constexpr gf_log_tables make_log_tables() {
+    gf_log_tables tables = {};
+    uint32_t value = 1;
+    for (uint32_t i = 0; i < 255; i++) {
+        tables.exp[i] = value;
+        tables.exp[i + 255] = value;
+        tables.log[value] = i;
+        value <<= 1;
+        if (value & 0x100) {
+            value ^= GF_POLY;
+        }
+    }
+    return tables;
+}
+
+static constexpr gf_log_tables gf = make_log_tables();
+
+uint8_t astraea_gf_mul(uint8_t a, uint8_t b) {
+    if (a == 0 || b == 0) {
+        return 0;
+    }
+    return gf.exp[gf.log[a] + gf.log[b]];
+}
+
+uint8_t astraea_gf_inv(uint8_t a) {
+    if (a == 0) {
+        return 0;
+    }
+    return gf.exp[255 - gf.log[a]];
+}
+
+void astraea_gf_gen_cauchy(uint32_t nb_data_blocks, uint32_t nb_rdnc_blocks,
+                           uint8_t *coefs) {
+    /* Row i of the full matrix is 1 / (i ^ j), i counting the data rows */
+    for (uint32_t i = 0; i < nb_rdnc_blocks; i++) {
+        for (uint32_t j = 0; j < nb_data_blocks; j++) {
+            coefs[i * nb_data_blocks + j] =
+                astraea_gf_inv((i + nb_data_blocks) ^ j);
+        }
+    }
+}
+
+void astraea_gf_gen_vandermonde(uint32_t nb_data_blocks,
+                                uint32_t nb_rdnc_blocks, uint8_t *coefs) {
+    /* Row i holds the powers of 2^i, the first parity is plain xor */
+    uint8_t gen = 1;
+    for (uint32_t i = 0; i < nb_rdnc_blocks; i++) {
+        uint8_t power = 1;
+        for (uint32_t j = 0; j < nb_data_blocks; j++) {
+            coefs[i * nb_data_blocks + j] = power;
+            power = astraea_gf_mul(power, gen);
+        }
+        gen = astraea_gf_mul(gen, 2);
+    }
+}
+
+/* Gauss-Jordan elimination of the n x n matrix in place */
+static bool invert(uint8_t *matrix, uint32_t n, uint8_t *inverse) {
+    memset(inverse, 0, n * n);
+    for (uint32_t i = 0; i < n; i++) {
+        inverse[i * n + i] = 1;
+    }
+
+    for (uint32_t col = 0; col < n; col++) {
+        uint32_t pivot = col;
+        while (pivot < n && matrix[pivot * n + col] == 0) {
+            pivot++;
+        }
+        if (pivot == n) {
+            return false;
+        }
+        if (pivot != col) {
+            for (uint32_t j = 0; j < n; j++) {
+                std::swap(matrix[pivot * n + j], matrix[col * n + j]);
+                std::swap(inverse[pivot * n + j], inverse[col * n + j]);
+            }
+        }
+
+        const uint8_t scale = astraea_gf_inv(matrix[col * n + col]);
+        for (uint32_t j = 0; j < n; j++) {
+            matrix[col * n + j] = astraea_gf_mul(matrix[col * n + j], scale);
+            inverse[col * n + j] = astraea_gf_mul(inverse[col * n + j], scale);
+        }
+
+        for (uint32_t row = 0; row < n; row++) {
+            const uint8_t factor = matrix[row * n + col];
+            if (row == col || factor == 0) {
+                continue;
+            }
+            for (uint32_t j = 0; j < n; j++) {
+                matrix[row * n + j] ^=
+                    astraea_gf_mul(factor, matrix[col * n + j]);
+                inverse[row * n + j] ^=
+                    astraea_gf_mul(factor, inverse[col * n + j]);
+            }
+        }
+    }
+    return true;
+}
+
+doca_error_t astraea_gf_gen_recover(const uint8_t *coding_coefs,
+                                    uint32_t nb_data_blocks,
+                                    uint32_t nb_rdnc_blocks,
+                                    const uint32_t *missing_indices,
+                                    uint32_t nb_missing, uint8_t *coefs) {
+    const uint32_t k = nb_data_blocks;
+    const uint32_t nb_blocks = nb_data_blocks + nb_rdnc_blocks;
+
+    /* Rows of the full matrix that produced the first k survivors */
+    std::vector<uint8_t> survivors(k * k, 0);
+    uint32_t nb_survivors = 0;
+    uint32_t next_missing = 0;
+    for (uint32_t index = 0; index < nb_blocks && nb_survivors < k; index++) {
+        if (next_missing < nb_missing &&
+            missing_indices[next_missing] == index) {
+            next_missing++;
+            continue;
+        }
+        uint8_t *row = &survivors[nb_survivors * k];
+        if (index < k) {
+            row[index] = 1;
+        } else {
+            memcpy(row, coding_coefs + (index - k) * k, k);
+        }
+        nb_survivors++;
+    }
+    if (nb_survivors < k) {
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+
+    std::vector<uint8_t> inverse(k * k);
+    if (!invert(survivors.data(), k, inverse.data())) {
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+
+    /* Lost data is a row of the inverse, lost parity re-encodes it */
+    for (uint32_t i = 0; i < nb_missing; i++) {
+        const uint32_t index = missing_indices[i];
+        uint8_t *row = coefs + i * k;
+        if (index < k) {
+            memcpy(row, &inverse[index * k], k);
+            continue;
+        }
+        const uint8_t *coding_row = coding_coefs + (index - k) * k;
+        for (uint32_t j = 0; j < k; j++) {
+            uint8_t coef = 0;
+            for (uint32_t t = 0; t < k; t++) {
+                coef ^= astraea_gf_mul(coding_row[t], inverse[t * k + j]);
+            }
+            row[j] = coef;
+        }
+    }
+    return DOCA_SUCCESS;
+}
+
+void astraea_gf_gen_update(const uint8_t *coding_coefs,
+                           uint32_t nb_data_blocks, uint32_t nb_rdnc_blocks,
+                           const uint32_t *updated_indices,
+                           uint32_t nb_updated, uint8_t *coefs) {
+    /* Subtraction is xor, so the old and the new copy share a coefficient */
+    const uint32_t nb_cols = 2 * nb_updated + nb_rdnc_blocks;
+    for (uint32_t i = 0; i < nb_rdnc_blocks; i++) {
+        uint8_t *row = coefs + i * nb_cols;
+        const uint8_t *coding_row = coding_coefs + i * nb_data_blocks;
+        for (uint32_t t = 0; t < nb_updated; t++) {
+            row[2 * t] = coding_row[updated_indices[t]];
+            row[2 * t + 1] = coding_row[updated_indices[t]];
+        }
+        for (uint32_t r = 0; r < nb_rdnc_blocks; r++) {
+            row[2 * nb_updated + r] = r == i;
+        }
+    }
+}
+
+void astraea_gf_init_tables(const uint8_t *coefs, uint32_t nb_rows,
+                            uint32_t nb_cols, uint8_t *tables) {
+    for (size_t i = 0; i < size_t{nb_rows} * nb_cols; i++) {
+        uint8_t *table = tables + i * GF_TABLE_SIZE;
+        for (uint32_t x = 0; x < 16; x++) {
+            table[x] = astraea_gf_mul(coefs[i], x);
+            table[16 + x] = astraea_gf_mul(coefs[i], x << 4);
+        }
+    }
+}
+
+/**
+ * Kernels
+ * A product is two nibble lookups, c * b = lo[b & 15] ^ hi[b >> 4], which
+ * vector kernels turn into byte shuffles. Each pass reads every source once
+ * for up to GF_NB_ROWS_PER_PASS parity blocks.
+ */
+
+/* Bytes [begin, end) of every block */
+static void encode_scalar(size_t begin, size_t end, uint32_t nb_src,
+                          uint32_t nb_dst, const uint8_t *tables,
+                          const uint8_t *const *src, uint8_t *const *dst) {
+    for (uint32_t i = 0; i < nb_dst; i++) {
+        const uint8_t *row = tables + size_t{i} * nb_src * GF_TABLE_SIZE;
+        uint8_t *out = dst[i];
+        for (uint32_t j = 0; j < nb_src; j++) {
+            const uint8_t *table = row + j * GF_TABLE_SIZE;
+            const uint8_t *in = src[j];
+            if (j == 0) {
+                for (size_t pos = begin; pos < end; pos++) {
+                    out[pos] = table[in[pos] & 15] ^ table[16 + (in[pos] >> 4)];
+                }
+            } else {
+                for (size_t pos = begin; pos < end; pos++) {
+                    out[pos] ^=
+                        table[in[pos] & 15] ^ table[16 + (in[pos] >> 4)];
+                }
+            }
+        }
+    }
+}
+
+#if defined(__x86_64__)
+template <uint32_t NB_ROWS>
+__attribute__((target("avx2"))) static void
+encode_rows_avx2(size_t len, uint32_t nb_src, const uint8_t *tables,
+                 const uint8_t *const *src, uint8_t *const *dst) {
+    const size_t row_stride = size_t{nb_src} * GF_TABLE_SIZE;
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    for (size_t pos = 0; pos < len; pos += 32) {
+        __m256i acc[NB_ROWS];
+        for (uint32_t r = 0; r < NB_ROWS; r++) {
+            acc[r] = _mm256_setzero_si256();
+        }
+        for (uint32_t j = 0; j < nb_src; j++) {
+            const __m256i data =
+                _mm256_loadu_si256((const __m256i *)(src[j] + pos));
+            const __m256i lo_idx = _mm256_and_si256(data, mask);
+            const __m256i hi_idx =
+                _mm256_and_si256(_mm256_srli_epi64(data, 4), mask);
+            for (uint32_t r = 0; r < NB_ROWS; r++) {
+                const uint8_t *table =
+                    tables + r * row_stride + j * GF_TABLE_SIZE;
+                const __m256i lo = _mm256_broadcastsi128_si256(
+                    _mm_loadu_si128((const __m128i *)table));
+                const __m256i hi = _mm256_broadcastsi128_si256(
+                    _mm_loadu_si128((const __m128i *)(table + 16)));
+                acc[r] = _mm256_xor_si256(
+                    acc[r], _mm256_xor_si256(_mm256_shuffle_epi8(lo, lo_idx),
+                                             _mm256_shuffle_epi8(hi, hi_idx)));
+            }
+        }
+        for (uint32_t r = 0; r < NB_ROWS; r++) {
+            _mm256_storeu_si256((__m256i *)(dst[r] + pos), acc[r]);
+        }
+    }
+}
+
+template <uint32_t NB_ROWS>
+__attribute__((target("avx512f,avx512bw"))) static void
+encode_rows_avx512(size_t len, uint32_t nb_src, const uint8_t *tables,
+                   const uint8_t *const *src, uint8_t *const *dst) {
+    const size_t row_stride = size_t{nb_src} * GF_TABLE_SIZE;
+    const __m512i mask = _mm512_set1_epi8(0x0f);
+    for (size_t pos = 0; pos < len; pos += 64) {
+        __m512i acc[NB_ROWS];
+        for (uint32_t r = 0; r < NB_ROWS; r++) {
+            acc[r] = _mm512_setzero_si512();
+        }
+        for (uint32_t j = 0; j < nb_src; j++) {
+            const __m512i data = _mm512_loadu_si512(src[j] + pos);
+            const __m512i lo_idx = _mm512_and_si512(data, mask);
+            /* Zero masked forms, the plain ones trip gcc 12 warnings */
+            const __m512i hi_idx = _mm512_and_si512(
+                _mm512_maskz_srli_epi64(0xff, data, 4), mask);
+            for (uint32_t r = 0; r < NB_ROWS; r++) {
+                const uint8_t *table =
+                    tables + r * row_stride + j * GF_TABLE_SIZE;
+                const __m512i lo = _mm512_maskz_broadcast_i32x4(
+                    0xffff, _mm_loadu_si128((const __m128i *)table));
+                const __m512i hi = _mm512_maskz_broadcast_i32x4(
+                    0xffff, _mm_loadu_si128((const __m128i *)(table + 16)));
+                acc[r] = _mm512_xor_si512(
+                    acc[r], _mm512_xor_si512(_mm512_shuffle_epi8(lo, lo_idx),
+                                             _mm512_shuffle_epi8(hi, hi_idx)));
+            }
+        }
+        for (uint32_t r = 0; r < NB_ROWS; r++) {
+            _mm512_storeu_si512(dst[r] + pos, acc[r]);
+        }
+    }
+}
+#endif
+
+#if defined(__aarch64__)
+template <uint32_t NB_ROWS>
+static void encode_rows_neon(size_t len, uint32_t nb_src,
+                             const uint8_t *tables,
+                             const uint8_t *const *src, uint8_t *const *dst) {
+    const size_t row_stride = size_t{nb_src} * GF_TABLE_SIZE;
+    const uint8x16_t mask = vdupq_n_u8(0x0f);
+    for (size_t pos = 0; pos < len; pos += 16) {
+        uint8x16_t acc[NB_ROWS];
+        for (uint32_t r = 0; r < NB_ROWS; r++) {
+            acc[r] = vdupq_n_u8(0);
+        }
+        for (uint32_t j = 0; j < nb_src; j++) {
+            const uint8x16_t data = vld1q_u8(src[j] + pos);
+            const uint8x16_t lo_idx = vandq_u8(data, mask);
+            const uint8x16_t hi_idx = vshrq_n_u8(data, 4);
+            for (uint32_t r = 0; r < NB_ROWS; r++) {
+                const uint8_t *table =
+                    tables + r * row_stride + j * GF_TABLE_SIZE;
+                acc[r] = veorq_u8(
+                    acc[r], veorq_u8(vqtbl1q_u8(vld1q_u8(table), lo_idx),
+                                     vqtbl1q_u8(vld1q_u8(table + 16), hi_idx)));
+            }
+        }
+        for (uint32_t r = 0; r < NB_ROWS; r++) {
+            vst1q_u8(dst[r] + pos, acc[r]);
+        }
+    }
+}
+#endif
+
+typedef void (*encode_rows_fn)(size_t len, uint32_t nb_src,
+                               const uint8_t *tables,
+                               const uint8_t *const *src, uint8_t *const *dst);
+
+/* Rows of one pass, indexed by their number minus one */
+struct gf_vector_kernel {
+    size_t width;
+    encode_rows_fn rows[GF_NB_ROWS_PER_PASS];
+};
+
+static const gf_vector_kernel *vector_kernel(astraea_gf_kernel kernel) {
+#if defined(__x86_64__)
+    static const gf_vector_kernel avx2 = {
+        32,
+        {encode_rows_avx2<1>, encode_rows_avx2<2>, encode_rows_avx2<3>,
+         encode_rows_avx2<4>}};
+    static const gf_vector_kernel avx512 = {
+        64,
+        {encode_rows_avx512<1>, encode_rows_avx512<2>, encode_rows_avx512<3>,
+         encode_rows_avx512<4>}};
+    if (kernel == ASTRAEA_GF_KERNEL_AVX2) {
+        return &avx2;
+    }
+    if (kernel == ASTRAEA_GF_KERNEL_AVX512) {
+        return &avx512;
+    }
+#elif defined(__aarch64__)
+    static const gf_vector_kernel neon = {
+        16,
+        {encode_rows_neon<1>, encode_rows_neon<2>, encode_rows_neon<3>,
+         encode_rows_neon<4>}};
+    if (kernel == ASTRAEA_GF_KERNEL_NEON) {
+        return &neon;
+    }
+#endif
+    (void)kernel;
+    return nullptr;
+}
+
+bool astraea_gf_kernel_is_supported(astraea_gf_kernel kernel) {
+    switch (kernel) {
+    case ASTRAEA_GF_KERNEL_SCALAR:
+        return true;
+#if defined(__x86_64__)
+    case ASTRAEA_GF_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case ASTRAEA_GF_KERNEL_AVX512:
+        return __builtin_cpu_supports("avx512f") &&
+               __builtin_cpu_supports("avx512bw");
+#elif defined(__aarch64__)
+    case ASTRAEA_GF_KERNEL_NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+astraea_gf_kernel astraea_gf_best_kernel() {
+    for (int kernel = ASTRAEA_GF_NB_KERNELS - 1; kernel > 0; kernel--) {
+        if (astraea_gf_kernel_is_supported(
+                static_cast<astraea_gf_kernel>(kernel))) {
+            return static_cast<astraea_gf_kernel>(kernel);
+        }
+    }
+    return ASTRAEA_GF_KERNEL_SCALAR;
+}
+
+void astraea_gf_encode(astraea_gf_kernel kernel, size_t len, uint32_t nb_src,
+                       uint32_t nb_dst, const uint8_t *tables,
+                       const uint8_t *const *src, uint8_t *const *dst) {
+    const gf_vector_kernel *vector = vector_kernel(kernel);
+    if (vector == nullptr) {
+        encode_scalar(0, len, nb_src, nb_dst, tables, src, dst);
+        return;
+    }
+
+    /* Whole vectors first, the tail goes through the scalar kernel */
+    const size_t vector_len = len - len % vector->width;
+    if (vector_len > 0) {
+        const size_t row_stride = size_t{nb_src} * GF_TABLE_SIZE;
+        for (uint32_t i = 0; i < nb_dst; i += GF_NB_ROWS_PER_PASS) {
+            const uint32_t nb_rows = nb_dst - i < GF_NB_ROWS_PER_PASS
+                                         ? nb_dst - i
+                                         : GF_NB_ROWS_PER_PASS;
+            vector->rows[nb_rows - 1](vector_len, nb_src,
+                                      tables + i * row_stride, src, dst + i);
+        }
+    }
+    if (vector_len < len) {
+        encode_scalar(vector_len, len, nb_src, nb_dst, tables, src, dst);
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef ASTRAEA_GF_H__
+#define ASTRAEA_GF_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include <doca_error.h>
+
+/**
+ * GF(2^8) erasure coding on the CPU
+ *
+ * Arithmetic is over the polynomial 0x11d. Coding matrices follow ISA-L's
+ * gf_gen_cauchy1_matrix and gf_gen_rs_matrix, the layout DOCA's cauchy and
+ * vandermonde matrices produce parity in, so the software backend and the
+ * device write the same bytes.
+ * Matrices below only hold the rows that produce output, the identity rows
+ * of the data blocks are implied.
+ */
+
+enum astraea_gf_kernel {
+    ASTRAEA_GF_KERNEL_SCALAR,
+    ASTRAEA_GF_KERNEL_AVX2,
+    ASTRAEA_GF_KERNEL_AVX512,
+    ASTRAEA_GF_KERNEL_NEON,
+    ASTRAEA_GF_NB_KERNELS,
+};
+
+constexpr const char *GF_KERNEL_NAMES[ASTRAEA_GF_NB_KERNELS] = {
+    "scalar", "avx2", "avx512", "neon"};
+
+/* Low and high nibble products of one coefficient */
+constexpr size_t GF_TABLE_SIZE = 32;
+
+uint8_t astraea_gf_mul(uint8_t a, uint8_t b);
+
+uint8_t astraea_gf_inv(uint8_t a);
+
+/* The m parity rows of k data blocks, m x k */
+void astraea_gf_gen_cauchy(uint32_t nb_data_blocks, uint32_t nb_rdnc_blocks,
+                           uint8_t *coefs);
+
+void astraea_gf_gen_vandermonde(uint32_t nb_data_blocks,
+                                uint32_t nb_rdnc_blocks, uint8_t *coefs);
+
+/**
+ * Rows rebuilding the blocks at missing_indices, counted over the k data
+ * then m parity blocks, from the first k surviving blocks in index order
+ * coding_coefs is m x k, coefs receives nb_missing x k
+ * Fail if the surviving blocks do not determine the data
+ */
+doca_error_t astraea_gf_gen_recover(const uint8_t *coding_coefs,
+                                    uint32_t nb_data_blocks,
+                                    uint32_t nb_rdnc_blocks,
+                                    const uint32_t *missing_indices,
+                                    uint32_t nb_missing, uint8_t *coefs);
+
+/**
+ * Rows folding the old and new copy of each of the n changed data blocks,
+ * interleaved, and the m old parity blocks into the new parity
+ * coefs receives m x (2n + m)
+ */
+void astraea_gf_gen_update(const uint8_t *coding_coefs,
+                           uint32_t nb_data_blocks, uint32_t nb_rdnc_blocks,
+                           const uint32_t *updated_indices,
+                           uint32_t nb_updated, uint8_t *coefs);
+
+/* Expand nb_rows x nb_cols coefficients into GF_TABLE_SIZE bytes each */
+void astraea_gf_init_tables(const uint8_t *coefs, uint32_t nb_rows,
+                            uint32_t nb_cols, uint8_t *tables);
+
+bool astraea_gf_kernel_is_supported(astraea_gf_kernel kernel);
+
+/* The widest kernel this CPU runs */
+astraea_gf_kernel astraea_gf_best_kernel();
+
+/**
+ * dst[i] = sum over j of coef[i][j] * src[j], len bytes per block
+ * tables comes from astraea_gf_init_tables over nb_dst x nb_src
+ * coefficients, blocks need no alignment
+ */
+void astraea_gf_encode(astraea_gf_kernel kernel, size_t len, uint32_t nb_src,
+                       uint32_t nb_dst, const uint8_t *tables,
+                       const uint8_t *const *src, uint8_t *const *dst);
+
+#endif
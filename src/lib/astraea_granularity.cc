@@ -0,0 +1,284 @@
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#include "astraea_granularity.h"
+
+/* Miss rate band of the adaptive strategy, inside it the bias holds */
+constexpr double MISS_RATE_HIGH = 0.10;
+constexpr double MISS_RATE_LOW = 0.02;
+/* Weight of the newest task in the miss rate and in the overhead fit */
+constexpr double FEEDBACK_WEIGHT = 1.0 / 16;
+/* Tasks a bias is kept before it may move again */
+constexpr uint32_t HOLD_TASKS = 16;
+/* The hold doubles every time a move had to be taken back */
+constexpr uint32_t MAX_HOLD_TASKS = HOLD_TASKS * 8;
+/* A move is taken back when it made the mean latency this much worse */
+constexpr double REVERT_MARGIN = 0.10;
+/* Coarser strips are only tried while overhead is this share of a strip */
+constexpr double OVERHEAD_SHARE_TARGET = 0.05;
+constexpr int32_t MAX_BIAS =
+    static_cast<int32_t>(MAX_GRANULARITY_SHIFT - MIN_GRANULARITY_SHIFT);
+
+/**
+ * Shift of the strip size the original ladder picks
+ * 512 B with less than 2 tokens, one level more every time they double
+ */
+static inline uint32_t ladder_shift(uint32_t nb_avail_tokens) {
+    uint32_t level = std::bit_width(nb_avail_tokens);
+    level = level == 0 ? 0 : level - 1;
+    if (level > MAX_GRANULARITY_SHIFT - MIN_GRANULARITY_SHIFT - 1) {
+        level = MAX_GRANULARITY_SHIFT - MIN_GRANULARITY_SHIFT - 1;
+    }
+    return MIN_GRANULARITY_SHIFT + level;
+}
+
+static void *ladder_create() { return nullptr; }
+
+static void ladder_destroy(void *state) { (void)state; }
+
+static size_t ladder_choose(void *state,
+                            const astraea_granularity_input *input) {
+    (void)state;
+    if (input->token_cost < input->nb_avail_tokens) {
+        return input->block_size;
+    }
+    return size_t{1} << ladder_shift(input->nb_avail_tokens);
+}
+
+const astraea_granularity_ops astraea_granularity_ladder = {
+    .name = "ladder",
+    .create = ladder_create,
+    .destroy = ladder_destroy,
+    .choose = ladder_choose,
+    .feedback = nullptr,
+    .get_stats = nullptr,
+};
+
+/* Workloads the adaptive strategy keeps a history for at once */
+constexpr uint32_t NB_GEOMETRIES = 8;
+
+/* What the adaptive strategy learnt on one (block size, k) workload */
+struct adaptive_history {
+    size_t block_size;
+    uint32_t nb_data_blocks;
+    /* Tick of the last task, the oldest history is reused first */
+    uint64_t last_used;
+
+    int32_t bias;
+    double miss_rate;
+    /* Tasks seen since the last move, and their summed latency */
+    uint32_t nb_held;
+    uint32_t hold_tasks;
+    double window_latency_ns;
+    /* Last move and the mean latency of the window before it */
+    int32_t last_move;
+    double prev_mean_latency_ns;
+
+    /**
+     * Weighted least squares of ns per strip on bytes per strip
+     * The intercept is the fixed cost of a strip
+     */
+    double sw, sx, sy, sxx, sxy;
+};
+
+struct adaptive_state {
+    adaptive_history histories[NB_GEOMETRIES];
+    uint32_t nb_histories;
+    uint64_t tick;
+    /* Where the last task was chosen, reported by get_stats */
+    const adaptive_history *current;
+
+    uint64_t nb_steps_up;
+    uint64_t nb_steps_down;
+};
+
+/**
+ * History of the workload, a new one replaces the least recently used
+ * Return nullptr for an unknown workload unless can_create
+ */
+static adaptive_history *find_history(adaptive_state *s, size_t block_size,
+                                      uint32_t nb_data_blocks,
+                                      bool can_create) {
+    adaptive_history *oldest = &s->histories[0];
+    for (uint32_t i = 0; i < s->nb_histories; i++) {
+        adaptive_history *h = &s->histories[i];
+        if (h->block_size == block_size &&
+            h->nb_data_blocks == nb_data_blocks) {
+            return h;
+        }
+        if (h->last_used < oldest->last_used) {
+            oldest = h;
+        }
+    }
+    if (!can_create) {
+        return nullptr;
+    }
+
+    adaptive_history *h = s->nb_histories < NB_GEOMETRIES
+                              ? &s->histories[s->nb_histories++]
+                              : oldest;
+    *h = {};
+    h->block_size = block_size;
+    h->nb_data_blocks = nb_data_blocks;
+    h->hold_tasks = HOLD_TASKS;
+    return h;
+}
+
+static void move_bias(adaptive_state *s, adaptive_history *h, int32_t move) {
+    h->bias += move;
+    if (move > 0) {
+        s->nb_steps_up++;
+    } else {
+        s->nb_steps_down++;
+    }
+}
+
+/* Return false while the strips seen so far are all the same size */
+static bool fit_overhead(const adaptive_history *h, double *overhead_ns,
+                         double *ns_per_byte) {
+    const double denom = h->sw * h->sxx - h->sx * h->sx;
+    if (h->sw <= 0 || denom <= 1e-9 * h->sw * h->sxx) {
+        return false;
+    }
+    *ns_per_byte = (h->sw * h->sxy - h->sx * h->sy) / denom;
+    *overhead_ns = (h->sy - *ns_per_byte * h->sx) / h->sw;
+    if (*overhead_ns < 0) {
+        *overhead_ns = 0;
+    }
+    return true;
+}
+
+static void *adaptive_create() { return new adaptive_state{}; }
+
+static void adaptive_destroy(void *state) {
+    delete static_cast<adaptive_state *>(state);
+}
+
+static size_t adaptive_choose(void *state,
+                              const astraea_granularity_input *input) {
+    adaptive_state *s = static_cast<adaptive_state *>(state);
+    adaptive_history *h =
+        find_history(s, input->block_size, input->nb_data_blocks, true);
+    h->last_used = ++s->tick;
+    s->current = h;
+
+    /* Slicing a task the bucket already covers only adds overhead */
+    if (input->token_cost < input->nb_avail_tokens &&
+        h->miss_rate < MISS_RATE_HIGH) {
+        return input->block_size;
+    }
+
+    int32_t shift = static_cast<int32_t>(ladder_shift(input->nb_avail_tokens));
+    shift += h->bias;
+    if (shift < static_cast<int32_t>(MIN_GRANULARITY_SHIFT)) {
+        shift = MIN_GRANULARITY_SHIFT;
+    } else if (shift > static_cast<int32_t>(MAX_GRANULARITY_SHIFT)) {
+        shift = MAX_GRANULARITY_SHIFT;
+    }
+    return size_t{1} << shift;
+}
+
+static void adaptive_feedback(void *state,
+                              const astraea_granularity_feedback *feedback) {
+    adaptive_state *s = static_cast<adaptive_state *>(state);
+    if (feedback->has_failed) {
+        return;
+    }
+    /* The history may have been reused by other workloads since */
+    adaptive_history *h = find_history(s, feedback->block_size,
+                                       feedback->nb_data_blocks, false);
+    if (h == nullptr) {
+        return;
+    }
+
+    const double is_miss = feedback->slack_ns < 0 ? 1 : 0;
+    h->miss_rate += FEEDBACK_WEIGHT * (is_miss - h->miss_rate);
+
+    if (feedback->nb_strips > 1) {
+        const double x = static_cast<double>(feedback->granularity) *
+                         feedback->nb_data_blocks;
+        const double y = static_cast<double>(feedback->latency_ns) /
+                         feedback->nb_strips;
+        const double decay = 1 - FEEDBACK_WEIGHT;
+        h->sw = h->sw * decay + 1;
+        h->sx = h->sx * decay + x;
+        h->sy = h->sy * decay + y;
+        h->sxx = h->sxx * decay + x * x;
+        h->sxy = h->sxy * decay + x * y;
+    }
+
+    h->window_latency_ns += feedback->latency_ns;
+    if (++h->nb_held < h->hold_tasks) {
+        return;
+    }
+    const double mean_latency_ns = h->window_latency_ns / h->nb_held;
+    h->nb_held = 0;
+    h->window_latency_ns = 0;
+
+    /* Take back a move that did not pay off and wait longer to retry */
+    if (h->last_move != 0 &&
+        mean_latency_ns > h->prev_mean_latency_ns * (1 + REVERT_MARGIN)) {
+        move_bias(s, h, -h->last_move);
+        h->last_move = 0;
+        h->hold_tasks = h->hold_tasks * 2 < MAX_HOLD_TASKS ? h->hold_tasks * 2
+                                                           : MAX_HOLD_TASKS;
+        return;
+    }
+    if (h->last_move != 0) {
+        h->hold_tasks = HOLD_TASKS;
+    }
+    h->last_move = 0;
+    h->prev_mean_latency_ns = mean_latency_ns;
+
+    if (h->miss_rate > MISS_RATE_HIGH) {
+        if (h->bias > -MAX_BIAS) {
+            move_bias(s, h, -1);
+            h->last_move = -1;
+        }
+        return;
+    }
+
+    if (h->miss_rate < MISS_RATE_LOW && h->bias < MAX_BIAS &&
+        feedback->nb_strips > 1) {
+        /* Without two strip sizes to compare, try the coarser one */
+        double overhead_ns, ns_per_byte;
+        bool is_worth = true;
+        if (fit_overhead(h, &overhead_ns, &ns_per_byte) && ns_per_byte > 0) {
+            const double x = static_cast<double>(feedback->granularity) *
+                             feedback->nb_data_blocks;
+            is_worth = overhead_ns / (overhead_ns + ns_per_byte * x) >
+                       OVERHEAD_SHARE_TARGET;
+        }
+        if (is_worth) {
+            move_bias(s, h, 1);
+            h->last_move = 1;
+        }
+    }
+}
+
+static void adaptive_get_stats(void *state, astraea_granularity_stats *stats) {
+    const adaptive_state *s = static_cast<adaptive_state *>(state);
+    stats->nb_steps_up = s->nb_steps_up;
+    stats->nb_steps_down = s->nb_steps_down;
+    stats->bias = 0;
+    stats->strip_overhead_ns = 0;
+    if (s->current == nullptr) {
+        return;
+    }
+    stats->bias = s->current->bias;
+
+    double overhead_ns, ns_per_byte;
+    if (fit_overhead(s->current, &overhead_ns, &ns_per_byte)) {
+        stats->strip_overhead_ns = overhead_ns;
+    }
+}
+
+const astraea_granularity_ops astraea_granularity_adaptive = {
+    .name = "adaptive",
+    .create = adaptive_create,
+    .destroy = adaptive_destroy,
+    .choose = adaptive_choose,
+    .feedback = adaptive_feedback,
+    .get_stats = adaptive_get_stats,
+};
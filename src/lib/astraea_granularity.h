@@ -0,0 +1,85 @@
+#ifndef ASTRAEA_GRANULARITY_H__
+#define ASTRAEA_GRANULARITY_H__
+
+#include <cstddef>
+#include <cstdint>
+
+/* Sliced strips are 512 B to 1 MB */
+constexpr uint32_t MIN_GRANULARITY_SHIFT = 9;
+constexpr uint32_t MAX_GRANULARITY_SHIFT = 20;
+
+/* What a strategy knows when a task is created */
+struct astraea_granularity_input {
+    uint32_t nb_data_blocks;
+    uint32_t nb_rdnc_blocks;
+    size_t block_size;
+    /* Tokens the whole task is predicted to cost */
+    uint32_t token_cost;
+    /* Tokens left in the app's bucket at that time */
+    uint32_t nb_avail_tokens;
+};
+
+/* Reported once per task, when its last strip comes back */
+struct astraea_granularity_feedback {
+    size_t block_size;
+    size_t granularity;
+    uint32_t nb_data_blocks;
+    uint32_t nb_strips;
+    /* From astraea_task_submit to completion */
+    uint64_t latency_ns;
+    /* expected_time minus completion time, negative when the sla is missed */
+    int64_t slack_ns;
+    bool has_failed;
+};
+
+struct astraea_granularity_stats {
+    uint64_t nb_tasks;
+    uint64_t nb_sliced_tasks;
+    uint64_t nb_sla_misses;
+    /* Kept by the strategy, zero if it does not adapt */
+    uint64_t nb_steps_up;
+    uint64_t nb_steps_down;
+    /**
+     * Levels added to the token ladder for the workload of the last task,
+     * see astraea_granularity_adaptive
+     */
+    int32_t bias;
+    /* Estimated fixed cost of one strip of that workload */
+    uint64_t strip_overhead_ns;
+};
+
+/**
+ * A granularity strategy
+ * choose returns the strip size of a new task, returning block_size or more
+ * keeps the task whole. A size that does not divide block_size also keeps
+ * it whole.
+ * The ec serializes every call, a strategy needs no locking.
+ * feedback and get_stats may be nullptr.
+ */
+struct astraea_granularity_ops {
+    const char *name;
+    void *(*create)();
+    void (*destroy)(void *state);
+    size_t (*choose)(void *state, const astraea_granularity_input *input);
+    void (*feedback)(void *state,
+                     const astraea_granularity_feedback *feedback);
+    void (*get_stats)(void *state, astraea_granularity_stats *stats);
+};
+
+/* The fixed power-of-two ladder on available tokens, no feedback */
+extern const astraea_granularity_ops astraea_granularity_ladder;
+
+/**
+ * The ladder shifted by a bias that follows the observed sla attainment
+ *
+ * Misses push strips finer so tasks start on fewer tokens, met deadlines
+ * let them grow back while the fitted per-strip overhead is still a
+ * significant share of a strip. Moves need the miss rate to leave a band
+ * and are held for a number of tasks, so the choice does not oscillate. A
+ * move that makes the mean latency worse is taken back and the hold grows.
+ * Each block size and k keeps its own history, for the last few seen.
+ * This is the default strategy.
+ */
+extern const astraea_granularity_ops astraea_granularity_adaptive;
+
+#endif
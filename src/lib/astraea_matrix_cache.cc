@@ -0,0 +1,450 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <doca_erasure_coding.h>
+#include <doca_error.h>
+#include <doca_log.h>
+
+#include "astraea_gf.h"
+#include "astraea_matrix_cache.h"
+
+DOCA_LOG_REGISTER(ASTRAEA : MATRIX_CACHE);
+
+/* Cauchy and vandermonde */
+constexpr uint32_t MATRIX_CACHE_NB_CODING_TYPES = 2;
+constexpr size_t MATRIX_CACHE_NB_SLOTS = MATRIX_CACHE_NB_CODING_TYPES *
+                                         MATRIX_CACHE_MAX_NB_DATA_BLOCKS *
+                                         MATRIX_CACHE_MAX_NB_RDNC_BLOCKS;
+
+size_t astraea_pattern_key_hash::operator()(
+    const astraea_pattern_key &key) const {
+    size_t hash = std::hash<uint32_t>()(key.derived_type);
+    auto combine = [&hash](size_t value) {
+        hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    };
+    combine(key.coding_type);
+    combine(key.nb_data_blocks);
+    combine(key.nb_rdnc_blocks);
+    for (uint64_t word : key.blocks) {
+        combine(std::hash<uint64_t>()(word));
+    }
+    return hash;
+}
+
+static inline astraea_cost_matrix_type
+cost_type_of(astraea_ec_matrix_type type) {
+    return type == ASTRAEA_EC_MATRIX_TYPE_CAUCHY
+               ? ASTRAEA_COST_MATRIX_CAUCHY
+               : ASTRAEA_COST_MATRIX_VANDERMONDE;
+}
+
+static inline bool is_coding(const astraea_ec_matrix *matrix) {
+    return matrix->cost_type == ASTRAEA_COST_MATRIX_CAUCHY ||
+           matrix->cost_type == ASTRAEA_COST_MATRIX_VANDERMONDE;
+}
+
+static inline bool is_cacheable(uint32_t nb_data_blocks,
+                                uint32_t nb_rdnc_blocks) {
+    return nb_data_blocks >= 1 &&
+           nb_data_blocks <= MATRIX_CACHE_MAX_NB_DATA_BLOCKS &&
+           nb_rdnc_blocks >= 1 &&
+           nb_rdnc_blocks <= MATRIX_CACHE_MAX_NB_RDNC_BLOCKS;
+}
+
+static inline size_t slot_index(astraea_cost_matrix_type cost_type,
+                                uint32_t nb_data_blocks,
+                                uint32_t nb_rdnc_blocks) {
+    return (static_cast<size_t>(cost_type) * MATRIX_CACHE_MAX_NB_DATA_BLOCKS +
+            (nb_data_blocks - 1)) *
+               MATRIX_CACHE_MAX_NB_RDNC_BLOCKS +
+           (nb_rdnc_blocks - 1);
+}
+
+/* Expand the coefficients for the software kernels */
+static void set_coefs(astraea_ec_matrix *matrix) {
+    matrix->gf_tables.resize(matrix->coefs.size() * GF_TABLE_SIZE);
+    astraea_gf_init_tables(matrix->coefs.data(), matrix->nb_rdnc_blocks,
+                           matrix->nb_data_blocks, matrix->gf_tables.data());
+}
+
+static doca_error_t destroy_matrix(astraea_ec_matrix *matrix) {
+    doca_error_t status = DOCA_SUCCESS;
+    if (matrix->matrix) {
+        status = doca_ec_matrix_destroy(matrix->matrix);
+    }
+    delete matrix;
+    return status;
+}
+
+void astraea_matrix_cache::init(doca_ec *ec, astraea_ec *owner) {
+    this->ec = ec;
+    this->owner = owner;
+    slots.assign(MATRIX_CACHE_NB_SLOTS, nullptr);
+    used_slots.reserve(MATRIX_CACHE_NB_SLOTS);
+}
+
+doca_error_t astraea_matrix_cache::enable_cpu_coefs() {
+    if (!used_slots.empty() || !pattern_matrices.empty()) {
+        DOCA_LOG_ERR("CPU coefficients must be enabled before the first "
+                     "matrix is created");
+        return DOCA_ERROR_BAD_STATE;
+    }
+    has_cpu_coefs = true;
+    return DOCA_SUCCESS;
+}
+
+doca_error_t astraea_matrix_cache::create(astraea_ec_matrix_type type,
+                                          uint32_t nb_data_blocks,
+                                          uint32_t nb_rdnc_blocks,
+                                          astraea_ec_matrix **matrix) {
+    astraea_ec_matrix *new_matrix = new astraea_ec_matrix;
+    new_matrix->owner = owner;
+    new_matrix->nb_data_blocks = nb_data_blocks;
+    new_matrix->nb_rdnc_blocks = nb_rdnc_blocks;
+    new_matrix->cost_type = cost_type_of(type);
+    new_matrix->cost_nb_data_blocks = nb_data_blocks;
+    new_matrix->nb_refs = 0;
+    new_matrix->is_cached = is_cacheable(nb_data_blocks, nb_rdnc_blocks);
+    new_matrix->last_use = 0;
+
+    new_matrix->matrix = nullptr;
+
+    if (ec) {
+        doca_ec_matrix_type demt = type == ASTRAEA_EC_MATRIX_TYPE_CAUCHY
+                                       ? DOCA_EC_MATRIX_TYPE_CAUCHY
+                                       : DOCA_EC_MATRIX_TYPE_VANDERMONDE;
+        doca_error_t status = doca_ec_matrix_create(
+            ec, demt, nb_data_blocks, nb_rdnc_blocks, &new_matrix->matrix);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to create ec matrix: %s",
+                         doca_error_get_descr(status));
+            delete new_matrix;
+            return status;
+        }
+    }
+    if (ec == nullptr || has_cpu_coefs) {
+        new_matrix->coefs.resize(nb_data_blocks * nb_rdnc_blocks);
+        if (type == ASTRAEA_EC_MATRIX_TYPE_CAUCHY) {
+            astraea_gf_gen_cauchy(nb_data_blocks, nb_rdnc_blocks,
+                                  new_matrix->coefs.data());
+        } else {
+            astraea_gf_gen_vandermonde(nb_data_blocks, nb_rdnc_blocks,
+                                       new_matrix->coefs.data());
+        }
+        set_coefs(new_matrix);
+    }
+
+    if (new_matrix->is_cached) {
+        const size_t slot = slot_index(new_matrix->cost_type, nb_data_blocks,
+                                       nb_rdnc_blocks);
+        slots[slot] = new_matrix;
+        used_slots.push_back(slot);
+    }
+    *matrix = new_matrix;
+    return DOCA_SUCCESS;
+}
+
+doca_error_t astraea_matrix_cache::acquire(astraea_ec_matrix_type type,
+                                           uint32_t nb_data_blocks,
+                                           uint32_t nb_rdnc_blocks,
+                                           astraea_ec_matrix **matrix) {
+    *matrix = nullptr;
+    if (is_cacheable(nb_data_blocks, nb_rdnc_blocks)) {
+        astraea_ec_matrix *cached = slots[slot_index(
+            cost_type_of(type), nb_data_blocks, nb_rdnc_blocks)];
+        if (cached) {
+            nb_hits++;
+            cached->nb_refs++;
+            *matrix = cached;
+            return DOCA_SUCCESS;
+        }
+    }
+
+    nb_misses++;
+    astraea_ec_matrix *new_matrix;
+    doca_error_t status =
+        create(type, nb_data_blocks, nb_rdnc_blocks, &new_matrix);
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
+    new_matrix->nb_refs = 1;
+    *matrix = new_matrix;
+    return DOCA_SUCCESS;
+}
+
+bool astraea_matrix_cache::evict_pattern() {
+    auto victim = pattern_matrices.end();
+    for (auto it = pattern_matrices.begin(); it != pattern_matrices.end();
+         ++it) {
+        if (it->second->nb_refs == 0 &&
+            (victim == pattern_matrices.end() ||
+             it->second->last_use < victim->second->last_use)) {
+            victim = it;
+        }
+    }
+    if (victim == pattern_matrices.end()) {
+        return false;
+    }
+
+    destroy_matrix(victim->second);
+    pattern_matrices.erase(victim);
+    nb_pattern_evictions++;
+    return true;
+}
+
+doca_error_t astraea_matrix_cache::acquire_pattern(
+    astraea_ec_matrix *coding_matrix, astraea_cost_matrix_type derived_type,
+    const uint32_t *indices, uint32_t nb_indices, uint32_t nb_blocks,
+    astraea_ec_matrix **matrix) {
+    /* Patterns of uncached geometries do not fit the key */
+    const bool is_pattern_cached = coding_matrix->is_cached;
+    astraea_pattern_key key = {
+        .derived_type = derived_type,
+        .coding_type = coding_matrix->cost_type,
+        .nb_data_blocks = coding_matrix->nb_data_blocks,
+        .nb_rdnc_blocks = coding_matrix->nb_rdnc_blocks,
+        .blocks = {}};
+    /* Ascending indices make the set of blocks name the matrix */
+    for (uint32_t i = 0; i < nb_indices; i++) {
+        const uint32_t index = indices[i];
+        if (index >= nb_blocks || (i > 0 && index <= indices[i - 1])) {
+            DOCA_LOG_ERR("Block indices must be ascending and below %u",
+                         nb_blocks);
+            return DOCA_ERROR_INVALID_VALUE;
+        }
+        if (is_pattern_cached) {
+            key.blocks[index / 64] |= uint64_t{1} << (index % 64);
+        }
+    }
+
+    if (is_pattern_cached) {
+        auto it = pattern_matrices.find(key);
+        if (it != pattern_matrices.end()) {
+            nb_hits++;
+            it->second->nb_refs++;
+            it->second->last_use = ++nb_pattern_uses;
+            *matrix = it->second;
+            return DOCA_SUCCESS;
+        }
+    }
+    nb_misses++;
+
+    astraea_ec_matrix *new_matrix = new astraea_ec_matrix;
+    new_matrix->owner = owner;
+    new_matrix->cost_type = derived_type;
+    new_matrix->nb_refs = 1;
+    new_matrix->is_cached =
+        is_pattern_cached &&
+        (pattern_matrices.size() < MATRIX_CACHE_MAX_NB_PATTERN_MATRICES ||
+         evict_pattern());
+    new_matrix->last_use = ++nb_pattern_uses;
+    new_matrix->matrix = nullptr;
+
+    const uint32_t coding_k = coding_matrix->nb_data_blocks;
+    const uint32_t coding_m = coding_matrix->nb_rdnc_blocks;
+    if (derived_type == ASTRAEA_COST_MATRIX_RECOVER) {
+        new_matrix->nb_data_blocks = coding_k;
+        new_matrix->nb_rdnc_blocks = nb_indices;
+        new_matrix->cost_nb_data_blocks = coding_k;
+    } else {
+        /* Old and new copy of every changed block, then the old parity */
+        new_matrix->nb_data_blocks = 2 * nb_indices + coding_m;
+        new_matrix->nb_rdnc_blocks = coding_m;
+        new_matrix->cost_nb_data_blocks = nb_indices;
+    }
+
+    /* DOCA only reads the indices */
+    doca_error_t status = DOCA_SUCCESS;
+    if (ec && derived_type == ASTRAEA_COST_MATRIX_RECOVER) {
+        status = doca_ec_matrix_create_recover(
+            ec, coding_matrix->matrix, const_cast<uint32_t *>(indices),
+            nb_indices, &new_matrix->matrix);
+    } else if (ec) {
+        status = doca_ec_matrix_create_update(
+            ec, coding_matrix->matrix, const_cast<uint32_t *>(indices),
+            nb_indices, &new_matrix->matrix);
+    }
+    /* Coding matrices carry coefficients when their ec needs them */
+    if (status == DOCA_SUCCESS && !coding_matrix->coefs.empty()) {
+        new_matrix->coefs.resize(new_matrix->nb_data_blocks *
+                                 new_matrix->nb_rdnc_blocks);
+        if (derived_type == ASTRAEA_COST_MATRIX_RECOVER) {
+            status = astraea_gf_gen_recover(
+                coding_matrix->coefs.data(), coding_k, coding_m, indices,
+                nb_indices, new_matrix->coefs.data());
+        } else {
+            astraea_gf_gen_update(coding_matrix->coefs.data(), coding_k,
+                                  coding_m, indices, nb_indices,
+                                  new_matrix->coefs.data());
+        }
+        if (status == DOCA_SUCCESS) {
+            set_coefs(new_matrix);
+        }
+    }
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create %s matrix: %s",
+                     COST_MATRIX_TYPE_NAMES[derived_type],
+                     doca_error_get_descr(status));
+        destroy_matrix(new_matrix);
+        return status;
+    }
+
+    if (new_matrix->is_cached) {
+        pattern_matrices.emplace(key, new_matrix);
+    }
+    *matrix = new_matrix;
+    return DOCA_SUCCESS;
+}
+
+doca_error_t astraea_matrix_cache::acquire_recover(
+    astraea_ec_matrix *coding_matrix, const uint32_t *missing_indices,
+    uint32_t nb_missing, astraea_ec_matrix **matrix) {
+    *matrix = nullptr;
+    if (!is_coding(coding_matrix)) {
+        DOCA_LOG_ERR("Recover matrices derive from a coding matrix");
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    if (nb_missing == 0 || nb_missing > coding_matrix->nb_rdnc_blocks) {
+        DOCA_LOG_ERR("Cannot recover %u blocks with %u parity blocks",
+                     nb_missing, coding_matrix->nb_rdnc_blocks);
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    return acquire_pattern(
+        coding_matrix, ASTRAEA_COST_MATRIX_RECOVER, missing_indices,
+        nb_missing,
+        coding_matrix->nb_data_blocks + coding_matrix->nb_rdnc_blocks, matrix);
+}
+
+doca_error_t astraea_matrix_cache::acquire_update(
+    astraea_ec_matrix *coding_matrix, const uint32_t *updated_indices,
+    uint32_t nb_updated, astraea_ec_matrix **matrix) {
+    *matrix = nullptr;
+    if (!is_coding(coding_matrix)) {
+        DOCA_LOG_ERR("Update matrices derive from a coding matrix");
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    if (nb_updated == 0 || nb_updated > coding_matrix->nb_data_blocks) {
+        DOCA_LOG_ERR("Cannot update %u of %u data blocks", nb_updated,
+                     coding_matrix->nb_data_blocks);
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    return acquire_pattern(coding_matrix, ASTRAEA_COST_MATRIX_UPDATE,
+                           updated_indices, nb_updated,
+                           coding_matrix->nb_data_blocks, matrix);
+}
+
+doca_error_t astraea_matrix_cache::release(astraea_ec_matrix *matrix) {
+    if (matrix->nb_refs == 0) {
+        DOCA_LOG_ERR("Matrix (%u, %u) released more times than created",
+                     matrix->nb_data_blocks, matrix->nb_rdnc_blocks);
+        return DOCA_ERROR_BAD_STATE;
+    }
+    if (--matrix->nb_refs > 0 || matrix->is_cached) {
+        return DOCA_SUCCESS;
+    }
+
+    return destroy_matrix(matrix);
+}
+
+doca_error_t
+astraea_matrix_cache::prewarm(const astraea_ec_matrix_geometry *geometries,
+                              uint32_t nb_geometries) {
+    for (uint32_t i = 0; i < nb_geometries; i++) {
+        const astraea_ec_matrix_geometry &geometry = geometries[i];
+        if (!is_cacheable(geometry.nb_data_blocks, geometry.nb_rdnc_blocks)) {
+            DOCA_LOG_WARN("Matrix (%u, %u) is too large to be cached, skip "
+                          "prewarming it",
+                          geometry.nb_data_blocks, geometry.nb_rdnc_blocks);
+            continue;
+        }
+        if (slots[slot_index(cost_type_of(geometry.type),
+                             geometry.nb_data_blocks,
+                             geometry.nb_rdnc_blocks)]) {
+            continue;
+        }
+
+        astraea_ec_matrix *matrix;
+        doca_error_t status =
+            create(geometry.type, geometry.nb_data_blocks,
+                   geometry.nb_rdnc_blocks, &matrix);
+        if (status != DOCA_SUCCESS) {
+            return status;
+        }
+    }
+    return DOCA_SUCCESS;
+}
+
+void astraea_matrix_cache::evict(size_t slot) {
+    astraea_ec_matrix *matrix = slots[slot];
+    slots[slot] = nullptr;
+    doca_error_t status = destroy_matrix(matrix);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_WARN("Failed to destroy ec matrix: %s",
+                      doca_error_get_descr(status));
+    }
+}
+
+void astraea_matrix_cache::trim() {
+    size_t nb_kept = 0;
+    for (uint32_t slot : used_slots) {
+        if (slots[slot]->nb_refs == 0) {
+            evict(slot);
+        } else {
+            used_slots[nb_kept++] = slot;
+        }
+    }
+    used_slots.resize(nb_kept);
+
+    for (auto it = pattern_matrices.begin(); it != pattern_matrices.end();) {
+        if (it->second->nb_refs > 0) {
+            ++it;
+            continue;
+        }
+        destroy_matrix(it->second);
+        it = pattern_matrices.erase(it);
+    }
+}
+
+void astraea_matrix_cache::clear() {
+    for (uint32_t slot : used_slots) {
+        if (slots[slot]->nb_refs > 0) {
+            DOCA_LOG_WARN("Matrix (%u, %u) still has %u references",
+                          slots[slot]->nb_data_blocks,
+                          slots[slot]->nb_rdnc_blocks, slots[slot]->nb_refs);
+        }
+        evict(slot);
+    }
+    used_slots.clear();
+
+    for (auto &[key, matrix] : pattern_matrices) {
+        if (matrix->nb_refs > 0) {
+            DOCA_LOG_WARN("%s matrix (%u, %u) still has %u references",
+                          COST_MATRIX_TYPE_NAMES[matrix->cost_type],
+                          matrix->nb_data_blocks, matrix->nb_rdnc_blocks,
+                          matrix->nb_refs);
+        }
+        destroy_matrix(matrix);
+    }
+    pattern_matrices.clear();
+}
+
+void astraea_matrix_cache::get_stats(astraea_matrix_cache_stats *stats) const {
+    stats->nb_hits = nb_hits;
+    stats->nb_misses = nb_misses;
+    stats->nb_pattern_evictions = nb_pattern_evictions;
+    stats->nb_pattern_matrices = pattern_matrices.size();
+    stats->nb_matrices = used_slots.size() + pattern_matrices.size();
+    stats->nb_idle_matrices = 0;
+    for (uint32_t slot : used_slots) {
+        if (slots[slot]->nb_refs == 0) {
+            stats->nb_idle_matrices++;
+        }
+    }
+    for (const auto &[key, matrix] : pattern_matrices) {
+        if (matrix->nb_refs == 0) {
+            stats->nb_idle_matrices++;
+        }
+    }
+}
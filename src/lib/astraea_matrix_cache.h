@@ -0,0 +1,197 @@
+#ifndef ASTRAEA_MATRIX_CACHE_H__
+#define ASTRAEA_MATRIX_CACHE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <doca_erasure_coding.h>
+#include <doca_error.h>
+
+#include "astraea_cost_model.h"
+
+/**
+ * Forward declarations
+ */
+struct astraea_ec;
+
+/* Geometries past these are still served, but not cached */
+constexpr uint32_t MATRIX_CACHE_MAX_NB_DATA_BLOCKS = 128;
+constexpr uint32_t MATRIX_CACHE_MAX_NB_RDNC_BLOCKS = 32;
+/**
+ * Recover and update matrices kept, idle ones are evicted least recently
+ * used first
+ */
+constexpr uint32_t MATRIX_CACHE_MAX_NB_PATTERN_MATRICES = 1024;
+constexpr uint32_t MATRIX_CACHE_NB_PATTERN_WORDS =
+    (MATRIX_CACHE_MAX_NB_DATA_BLOCKS + MATRIX_CACHE_MAX_NB_RDNC_BLOCKS + 63) /
+    64;
+
+enum astraea_ec_matrix_type {
+    ASTRAEA_EC_MATRIX_TYPE_CAUCHY = DOCA_EC_MATRIX_TYPE_CAUCHY,
+    ASTRAEA_EC_MATRIX_TYPE_VANDERMONDE = DOCA_EC_MATRIX_TYPE_VANDERMONDE,
+};
+
+/**
+ * A coding matrix, a recover matrix reading nb_data_blocks surviving
+ * blocks into nb_rdnc_blocks lost ones, or an update matrix reading the old
+ * and new copy of each changed block and the parity into the new parity
+ */
+struct astraea_ec_matrix {
+    /* nullptr on software ecs */
+    doca_ec_matrix *matrix;
+    /* Blocks a task reads, and writes */
+    uint32_t nb_data_blocks;
+    uint32_t nb_rdnc_blocks;
+    astraea_cost_matrix_type cost_type;
+    /* k the cost model is looked up with, the changed blocks of an update */
+    uint32_t cost_nb_data_blocks;
+    /* The ec whose cache made it, its alloc_lock guards nb_refs */
+    astraea_ec *owner;
+    /* Handles given out and not destroyed yet */
+    uint32_t nb_refs;
+    /* Uncached matrices are freed with their last reference */
+    bool is_cached;
+    /* Recover and update matrices only, orders evictions */
+    uint64_t last_use;
+    /**
+     * Software ecs and ecs that spill strips to the CPU only,
+     * nb_rdnc_blocks x nb_data_blocks coefficients and their
+     * astraea_gf_init_tables expansion
+     */
+    std::vector<uint8_t> coefs;
+    std::vector<uint8_t> gf_tables;
+};
+
+struct astraea_ec_matrix_geometry {
+    astraea_ec_matrix_type type;
+    uint32_t nb_data_blocks;
+    uint32_t nb_rdnc_blocks;
+};
+
+/**
+ * Coding geometry and the blocks among its k + m a matrix derives from,
+ * those lost for recover, those changed for update
+ */
+struct astraea_pattern_key {
+    astraea_cost_matrix_type derived_type;
+    astraea_cost_matrix_type coding_type;
+    uint32_t nb_data_blocks;
+    uint32_t nb_rdnc_blocks;
+    uint64_t blocks[MATRIX_CACHE_NB_PATTERN_WORDS];
+
+    bool operator==(const astraea_pattern_key &other) const = default;
+};
+
+struct astraea_pattern_key_hash {
+    size_t operator()(const astraea_pattern_key &key) const;
+};
+
+struct astraea_matrix_cache_stats {
+    uint64_t nb_hits;
+    uint64_t nb_misses;
+    uint64_t nb_pattern_evictions;
+    /* Matrices currently cached, and those no handle refers to */
+    uint32_t nb_matrices;
+    uint32_t nb_idle_matrices;
+    /* Recover and update matrices among them */
+    uint32_t nb_pattern_matrices;
+};
+
+/**
+ * Coding matrices of an ec, one per (type, k, m), and recover and update
+ * matrices, one per pattern of lost or changed blocks of a coding geometry
+ *
+ * Creating a matrix that exists returns it again with one more reference,
+ * a lookup is an index into a dense table, or a hash lookup for pattern
+ * matrices, and never allocates. Matrices stay cached when their last
+ * reference goes, so geometries that come and go do not pay
+ * doca_ec_matrix_create again. They are freed by trim or clear, pattern
+ * matrices also when their count is bounded.
+ * A cache without a doca_ec computes the coefficients of every matrix on
+ * the CPU instead, for software ecs, one with CPU coefficients enabled
+ * computes both.
+ * Not thread-safe, the ec calls it under its alloc_lock, so matrices may
+ * be created and destroyed from any thread that creates tasks.
+ */
+class astraea_matrix_cache {
+  public:
+    /* ec is nullptr for software ecs, owner is recorded in every matrix */
+    void init(doca_ec *ec, astraea_ec *owner);
+
+    /**
+     * Also compute the CPU coefficients of DOCA matrices
+     * Fail once a matrix exists, pattern matrices derive from the
+     * coefficients of their coding matrix
+     */
+    doca_error_t enable_cpu_coefs();
+
+    doca_error_t acquire(astraea_ec_matrix_type type, uint32_t nb_data_blocks,
+                         uint32_t nb_rdnc_blocks, astraea_ec_matrix **matrix);
+
+    /**
+     * missing_indices count over the k data then m parity blocks, in
+     * ascending order
+     */
+    doca_error_t acquire_recover(astraea_ec_matrix *coding_matrix,
+                                 const uint32_t *missing_indices,
+                                 uint32_t nb_missing,
+                                 astraea_ec_matrix **matrix);
+
+    /* updated_indices count over the k data blocks, in ascending order */
+    doca_error_t acquire_update(astraea_ec_matrix *coding_matrix,
+                                const uint32_t *updated_indices,
+                                uint32_t nb_updated,
+                                astraea_ec_matrix **matrix);
+
+    static doca_error_t release(astraea_ec_matrix *matrix);
+
+    /* Create the matrices of geometries not cached yet, no reference taken */
+    doca_error_t prewarm(const astraea_ec_matrix_geometry *geometries,
+                         uint32_t nb_geometries);
+
+    /* Free the matrices no handle refers to */
+    void trim();
+
+    /* Free every matrix, called before the ec is destroyed */
+    void clear();
+
+    void get_stats(astraea_matrix_cache_stats *stats) const;
+
+  private:
+    doca_error_t create(astraea_ec_matrix_type type, uint32_t nb_data_blocks,
+                        uint32_t nb_rdnc_blocks, astraea_ec_matrix **matrix);
+
+    void evict(size_t slot);
+
+    /**
+     * Look the pattern of indices up, or create the matrix of derived_type
+     * Indices are checked against nb_blocks, and must be ascending
+     */
+    doca_error_t acquire_pattern(astraea_ec_matrix *coding_matrix,
+                                 astraea_cost_matrix_type derived_type,
+                                 const uint32_t *indices, uint32_t nb_indices,
+                                 uint32_t nb_blocks,
+                                 astraea_ec_matrix **matrix);
+
+    /* Make room for one more pattern matrix, false if every one is held */
+    bool evict_pattern();
+
+    doca_ec *ec = nullptr;
+    astraea_ec *owner = nullptr;
+    bool has_cpu_coefs = false;
+    /* Indexed by slot_index, nullptr when the geometry is not cached */
+    std::vector<astraea_ec_matrix *> slots;
+    /* Slots in use, so trim and clear do not walk the whole table */
+    std::vector<uint32_t> used_slots;
+    std::unordered_map<astraea_pattern_key, astraea_ec_matrix *,
+                       astraea_pattern_key_hash>
+        pattern_matrices;
+    uint64_t nb_pattern_uses = 0;
+    uint64_t nb_hits = 0;
+    uint64_t nb_misses = 0;
+    uint64_t nb_pattern_evictions = 0;
+};
+
+#endif
@@ -1,7 +1,13 @@
+#include <atomic>
+#include <cerrno>
 #include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <mutex>
 #include <semaphore.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 #include <doca_error.h>
 #include <doca_pe.h>
@@ -19,15 +25,6 @@
 
 DOCA_LOG_REGISTER(ASTRAEA : PE);
 
-extern sem_t *metadata_sem;
-extern shared_resources *shm_data;
-extern uint32_t app_id;
-extern std::chrono::microseconds latency_sla;
-
-auto last_expect_time = std::chrono::high_resolution_clock::now();
-
-bool has_finished_task = false;
-
 doca_error_t astraea_pe_create(astraea_pe **pe) {
     *pe = new astraea_pe;
 
@@ -46,6 +43,11 @@ doca_error_t astraea_pe_destroy(astraea_pe *pe) {
         delete ctx;
     }
 
+    if (pe->epoll_fd >= 0) {
+        close(pe->epoll_fd);
+        close(pe->event_fd);
+    }
+
     doca_error_t status = doca_pe_destroy(pe->pe);
 
     delete pe;
@@ -54,58 +56,287 @@ doca_error_t astraea_pe_destroy(astraea_pe *pe) {
 }
 
 uint8_t astraea_pe_progress(astraea_pe *pe) {
-    /* Lock all ctx */
+    /* Submit for inline ctxs, lock the ones that own a submitter thread */
     for (astraea_ctx *ctx : pe->ctxs) {
-        ctx->ctx_lock.lock();
+        if (ctx->is_inline) {
+            (void)astraea_ctx_submit_inline(ctx);
+        } else {
+            ctx->ctx_lock.lock();
+        }
     }
 
-    doca_pe_progress(pe->pe);
+    uint8_t has_progressed = doca_pe_progress(pe->pe);
 
     /* Unlock all ctx */
     for (astraea_ctx *ctx : pe->ctxs) {
-        ctx->ctx_lock.unlock();
+        if (!ctx->is_inline) {
+            ctx->ctx_lock.unlock();
+        }
+    }
+
+    /**
+     * Strips run on the CPU since the last call complete here
+     * A spilled strip may park a DOCA task, the submitter arms them under
+     * the ctx lock
+     */
+    for (astraea_ctx *ctx : pe->ctxs) {
+        if (ctx->type != EC ||
+            !(ctx->ec->is_software || ctx->ec->spillover)) {
+            continue;
+        }
+        const bool needs_lock = !ctx->is_inline && !ctx->ec->is_software;
+        if (needs_lock) {
+            ctx->ctx_lock.lock();
+        }
+        if (astraea_ec_sw_progress(ctx->ec) > 0) {
+            has_progressed = 1;
+        }
+        if (needs_lock) {
+            ctx->ctx_lock.unlock();
+        }
+    }
+
+    if (pe->has_finished_task.exchange(false, std::memory_order_relaxed)) {
+        has_progressed = 1;
+    }
+    return has_progressed;
+}
+
+static uint32_t reap_tasks(astraea_pe *pe, astraea_completion *completions,
+                           uint32_t nb_completions) {
+    uint32_t nb_reaped = 0;
+    while (nb_reaped < nb_completions && pe->completed_head) {
+        _astraea_ec_task *task = pe->completed_head;
+        pe->completed_head = task->completed_next;
+        if (pe->completed_head == nullptr) {
+            pe->completed_tail = nullptr;
+        }
+        astraea_ec_reap_task(task, &completions[nb_reaped++]);
     }
+    return nb_reaped;
+}
 
-    if (has_finished_task) {
-        has_finished_task = false;
-        return 1;
+uint32_t astraea_pe_progress(astraea_pe *pe, astraea_completion *completions,
+                             uint32_t nb_completions) {
+    uint32_t nb_reaped = reap_tasks(pe, completions, nb_completions);
+    while (nb_reaped < nb_completions && astraea_pe_progress(pe)) {
+        nb_reaped += reap_tasks(pe, completions + nb_reaped,
+                                nb_completions - nb_reaped);
     }
-    return 0;
+    return nb_reaped;
+}
+
+static bool add_to_epoll(int epoll_fd, int fd) {
+    epoll_event event = {.events = EPOLLIN, .data = {.fd = fd}};
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+doca_error_t astraea_pe_get_event_fd(astraea_pe *pe, int *fd) {
+    for (astraea_ctx *ctx : pe->ctxs) {
+        if (ctx->is_inline) {
+            DOCA_LOG_ERR("Inline ctxs need astraea_pe_progress to submit");
+            return DOCA_ERROR_NOT_SUPPORTED;
+        }
+    }
+    if (pe->epoll_fd >= 0) {
+        *fd = pe->epoll_fd;
+        return DOCA_SUCCESS;
+    }
+
+    doca_error_t status =
+        doca_pe_get_notification_handle(pe->pe, &pe->notification_handle);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to get pe notification handle: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    int event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0) {
+        DOCA_LOG_ERR("Failed to create eventfd: %s", strerror(errno));
+        return DOCA_ERROR_OPERATING_SYSTEM;
+    }
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        DOCA_LOG_ERR("Failed to create epoll fd: %s", strerror(errno));
+        close(event_fd);
+        return DOCA_ERROR_OPERATING_SYSTEM;
+    }
+
+    if (!add_to_epoll(epoll_fd, event_fd) ||
+        !add_to_epoll(epoll_fd, static_cast<int>(pe->notification_handle))) {
+        DOCA_LOG_ERR("Failed to add fd to epoll: %s", strerror(errno));
+        close(epoll_fd);
+        close(event_fd);
+        return DOCA_ERROR_OPERATING_SYSTEM;
+    }
+
+    pe->event_fd = event_fd;
+    pe->epoll_fd = epoll_fd;
+    *fd = epoll_fd;
+    return DOCA_SUCCESS;
+}
+
+doca_error_t astraea_pe_request_notification(astraea_pe *pe) {
+    if (pe->epoll_fd < 0) {
+        DOCA_LOG_ERR("Pe has no event fd, see astraea_pe_get_event_fd");
+        return DOCA_ERROR_BAD_STATE;
+    }
+    doca_error_t status = doca_pe_request_notification(pe->pe);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to request pe notification: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    /* Pairs with the fence in astraea_pe_notify, either side sees the other */
+    pe->is_notification_requested.store(true, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (pe->completed_head) {
+        astraea_pe_notify(pe);
+        return DOCA_SUCCESS;
+    }
+    for (astraea_ctx *ctx : pe->ctxs) {
+        if (ctx->type == EC && astraea_ec_has_cpu_completions(ctx->ec)) {
+            astraea_pe_notify(pe);
+            break;
+        }
+    }
+    return DOCA_SUCCESS;
+}
+
+doca_error_t astraea_pe_clear_notification(astraea_pe *pe) {
+    if (pe->epoll_fd < 0) {
+        DOCA_LOG_ERR("Pe has no event fd, see astraea_pe_get_event_fd");
+        return DOCA_ERROR_BAD_STATE;
+    }
+    pe->is_notification_requested.store(false, std::memory_order_relaxed);
+    uint64_t nb_events;
+    /* Nothing to read if only the DOCA handle was signaled */
+    (void)!read(pe->event_fd, &nb_events, sizeof(nb_events));
+
+    doca_error_t status =
+        doca_pe_clear_notification(pe->pe, pe->notification_handle);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to clear pe notification: %s",
+                     doca_error_get_descr(status));
+    }
+    return status;
+}
+
+/* A write per wait at most, completions that find it taken skip the syscall */
+void astraea_pe_notify(astraea_pe *pe) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!pe->is_notification_requested.load(std::memory_order_relaxed) ||
+        !pe->is_notification_requested.exchange(false,
+                                                std::memory_order_acq_rel)) {
+        return;
+    }
+    const uint64_t nb_events = 1;
+    (void)!write(pe->event_fd, &nb_events, sizeof(nb_events));
+}
+
+/* Every kind of ec task shares the strip queue and the tokens */
+static _astraea_ec_task *as_ec_task(astraea_task *task) {
+    switch (task->type) {
+    case EC_CREATE:
+        return task->ec_task_create;
+    case EC_RECOVER:
+        return task->ec_task_recover;
+    case EC_UPDATE:
+        return task->ec_task_update;
+    }
+    return nullptr;
 }
 
 doca_error_t astraea_task_submit(astraea_task *task) {
-    if (task->type == EC_CREATE) {
+    _astraea_ec_task *ec_task = as_ec_task(task);
+    if (ec_task) {
+        astraea_ec *ec = ec_task->ec;
+        if (ec_task->state != EC_TASK_STATE_ALLOCATED) {
+            DOCA_LOG_ERR("Task %u is free or already submitted", ec_task->id);
+            return DOCA_ERROR_BAD_STATE;
+        }
 
         auto cur_time = std::chrono::high_resolution_clock::now();
 
-        last_expect_time =
-            latency_sla +
-            (last_expect_time > cur_time ? last_expect_time : cur_time);
-        task->ec_task_create->expected_time = last_expect_time;
-
-        uint32_t nb_sub_tasks = task->ec_task_create->cur_subtask_pos;
-        astraea_ec *ec = task->ec_task_create->ec;
-        for (uint32_t i = 0; i < nb_sub_tasks; i++) {
-            ec->subtask_queue[ec->prod_pos] =
-                task->ec_task_create->subtask_pool[i]->task;
-            /* Unlock subtask for consumer */
-            ec->subtask_locks[ec->prod_pos].unlock();
-            ec->prod_pos++;
+        /**
+         * Each task is due its own run time past the sla, strips are
+         * dispatched by deadline so a long task no longer holds back the
+         * deadlines of those queued after it
+         */
+        const astraea_ec_matrix *matrix = ec_task->matrix;
+        const double run_time_us = astraea_cost_model_time_us(
+            ec->cost_model.load(std::memory_order_acquire),
+            matrix->cost_type, matrix->cost_nb_data_blocks,
+            matrix->nb_rdnc_blocks, ec_task->origin_block_size);
+        const std::chrono::microseconds latency_sla =
+            ec_task->latency_sla.count() > 0 ? ec_task->latency_sla
+                                             : ec->session->latency_sla;
+        const auto expect_time =
+            cur_time + latency_sla +
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::duration<double, std::micro>(run_time_us));
+
+        /* Stamp before publishing, completion may race with this thread */
+        ec_task->submit_time = cur_time;
+        ec_task->expected_time = expect_time;
+        ec_task->state = EC_TASK_STATE_SUBMITTED;
+
+        /**
+         * Publish the first strip only, the others are reached through it
+         * Strips of a task published before can complete and be reused
+         * meanwhile, so nothing past the task itself is read here. The
+         * caller retries on AGAIN
+         */
+        if (!ec->subtask_queue.try_push(ec_task->first_subtask)) {
+            ec_task->state = EC_TASK_STATE_ALLOCATED;
+            return DOCA_ERROR_AGAIN;
         }
+        ec->doorbell.ring();
     }
     return DOCA_SUCCESS;
 }
 
-void astraea_task_free(astraea_task *task) { delete task; }
+void astraea_task_free(astraea_task *task) {
+    astraea_ec_task_free(as_ec_task(task));
+}
+
+doca_error_t astraea_task_set_class(astraea_task *task,
+                                    astraea_task_class task_class) {
+    if (task_class >= ASTRAEA_NB_TASK_CLASSES) {
+        DOCA_LOG_ERR("Unknown task class %d", task_class);
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    as_ec_task(task)->task_class = task_class;
+    return DOCA_SUCCESS;
+}
+
+doca_error_t astraea_task_set_latency_sla(astraea_task *task,
+                                          std::chrono::microseconds sla) {
+    if (sla.count() < 0) {
+        DOCA_LOG_ERR("Latency sla can't be negative");
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    as_ec_task(task)->latency_sla = sla;
+    return DOCA_SUCCESS;
+}
 
 doca_error_t astraea_pe_connect_ctx(astraea_pe *pe, astraea_ctx *ctx) {
     /**
      * We don't need to lock ctx here
      * As this always happen before task submitting
      */
-    doca_error_t status = doca_pe_connect_ctx(pe->pe, ctx->ctx);
+    /* Software ecs are polled by astraea_pe_progress itself */
+    doca_error_t status = DOCA_SUCCESS;
+    if (ctx->ctx) {
+        status = doca_pe_connect_ctx(pe->pe, ctx->ctx);
+    }
     if (status == DOCA_SUCCESS) {
         pe->ctxs.push_back(ctx);
+        if (ctx->type == EC) {
+            ctx->ec->pe = pe;
+        }
     }
     return status;
 }
\ No newline at end of file
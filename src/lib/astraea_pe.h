@@ -1,42 +1,164 @@
 #ifndef ASTRAEA_PE_H__
 #define ASTRAEA_PE_H__
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <vector>
 
 #include <doca_error.h>
 #include <doca_pe.h>
+#include <doca_types.h>
 
 /**
  * Forward declarations
  */
 struct astraea_ec_task_create;
+struct astraea_ec_task_recover;
+struct astraea_ec_task_update;
 struct astraea_ctx;
+struct _astraea_ec_task;
 
+/**
+ * A pe and its ctxs are driven by one thread at a time
+ * Several pes may run in the same process, one per thread
+ */
 struct astraea_pe {
     doca_pe *pe;
     std::vector<astraea_ctx *> ctxs;
+    /* Set by completions of this pe, cleared by astraea_pe_progress */
+    std::atomic<bool> has_finished_task{false};
+
+    /**
+     * Created by astraea_pe_get_event_fd, -1 until then
+     * epoll_fd watches the notification handle of the DOCA pe for strips
+     * run on the device, and event_fd for strips run on the CPU
+     */
+    int epoll_fd = -1;
+    int event_fd = -1;
+    doca_notification_handle_t notification_handle;
+    /* Set while the app waits, the first CPU completion writes event_fd */
+    std::atomic<bool> is_notification_requested{false};
+
+    /**
+     * Tasks configured without callbacks, in completion order, until
+     * astraea_pe_progress reaps them. Only touched by the thread driving
+     * the pe
+     */
+    _astraea_ec_task *completed_head = nullptr;
+    _astraea_ec_task *completed_tail = nullptr;
 };
 
-enum task_type { EC_CREATE };
+enum task_type { EC_CREATE, EC_RECOVER, EC_UPDATE };
+
+/**
+ * Tasks of a ctx are dispatched by class, then by deadline
+ * While several classes wait for tokens they share the strips the bucket
+ * admits by weight, so background tasks keep moving under a foreground
+ * load without holding it back
+ */
+enum astraea_task_class {
+    ASTRAEA_TASK_CLASS_CRITICAL,
+    ASTRAEA_TASK_CLASS_NORMAL,
+    ASTRAEA_TASK_CLASS_BACKGROUND,
+};
+constexpr uint32_t ASTRAEA_NB_TASK_CLASSES = 3;
 
 struct astraea_task {
     task_type type;
     union {
         astraea_ec_task_create *ec_task_create;
+        astraea_ec_task_recover *ec_task_recover;
+        astraea_ec_task_update *ec_task_update;
     };
 };
 
+/* A task reaped by astraea_pe_progress, the task itself is already back */
+struct astraea_completion {
+    task_type type;
+    doca_data user_data;
+    /* DOCA_ERROR_IO_FAILED if any strip of the task failed */
+    doca_error_t status;
+    astraea_task_class task_class;
+    /* From astraea_task_submit to the completion of the last strip */
+    uint64_t latency_ns;
+    bool is_sla_miss;
+};
+
 doca_error_t astraea_pe_create(astraea_pe **pe);
 
 doca_error_t astraea_pe_destroy(astraea_pe *pe);
 
+/**
+ * Submit for inline ctxs and complete what finished since the last call
+ * Return 1 if a strip or a task completed, 0 once there is nothing left
+ */
 uint8_t astraea_pe_progress(astraea_pe *pe);
 
+/**
+ * Progress the pe and reap up to nb_completions tasks configured without
+ * callbacks, io_uring style: the completions are handled after the call,
+ * out of the DOCA callbacks and the ctx locks, and may submit the next tasks
+ * Stops once the array is full or the pe is idle, so a return below
+ * nb_completions means there is nothing left to reap for now
+ * Return the number of completions filled
+ */
+uint32_t astraea_pe_progress(astraea_pe *pe, astraea_completion *completions,
+                             uint32_t nb_completions);
+
+/**
+ * Event-driven completions, instead of polling astraea_pe_progress
+ * The fd becomes readable when a strip of the pe completes, add it to an
+ * epoll set or an io_uring poll and wait as follows:
+ *   astraea_pe_request_notification(pe);
+ *   wait until fd is readable;
+ *   astraea_pe_clear_notification(pe);
+ *   while (astraea_pe_progress(pe)) {}
+ * The fd belongs to the pe and is closed by astraea_pe_destroy. Inline
+ * ctxs submit from astraea_pe_progress, a pe driving one can't wait on
+ * the fd alone and gets DOCA_ERROR_NOT_SUPPORTED
+ */
+doca_error_t astraea_pe_get_event_fd(astraea_pe *pe, int *fd);
+
+/* Arm the fd, strips that completed before the call make it readable */
+doca_error_t astraea_pe_request_notification(astraea_pe *pe);
+
+/**
+ * Consume the readiness of the fd and disarm it, the caller progresses the
+ * pe afterwards
+ */
+doca_error_t astraea_pe_clear_notification(astraea_pe *pe);
+
+/* Wake the waiter of the fd, if any, after a CPU completion is queued */
+void astraea_pe_notify(astraea_pe *pe);
+
+/**
+ * May be called from any thread, including other threads than the one
+ * driving the pe. A task takes one entry of the queue of the ctx, however
+ * many strips it has
+ * Return DOCA_ERROR_AGAIN while the queue of the ctx is full
+ */
 doca_error_t astraea_task_submit(astraea_task *task);
 
+/**
+ * Give back a task that was never submitted, or whose submission failed
+ * A submitted task is given back on its own once its last strip completes,
+ * freeing it then does nothing. The handle is invalid once the task is back
+ */
 void astraea_task_free(astraea_task *task);
 
+/* Set before astraea_task_submit, the default is ASTRAEA_TASK_CLASS_NORMAL */
+doca_error_t astraea_task_set_class(astraea_task *task,
+                                    astraea_task_class task_class);
+
+/**
+ * The task is due latency_sla after it is submitted, on top of its
+ * predicted run time. Set before astraea_task_submit, 0 (the default) takes
+ * the sla of the session
+ */
+doca_error_t astraea_task_set_latency_sla(astraea_task *task,
+                                          std::chrono::microseconds sla);
+
 doca_error_t astraea_pe_connect_ctx(astraea_pe *pe, astraea_ctx *ctx);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,185 @@
+#ifndef ASTRAEA_RING_H__
+#define ASTRAEA_RING_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+constexpr size_t ASTRAEA_CACHE_LINE_SIZE = 64;
+
+/**
+ * Bounded single-producer single-consumer ring
+ *
+ * Positions are free running 32-bit counters, slots are addressed modulo
+ * CAPACITY which must be a power of two.
+ * Producer and consumer indices live on their own cache lines, each side
+ * also caches the other side's index to avoid bouncing it on every call.
+ */
+template <typename T, uint32_t CAPACITY> class astraea_spsc_ring {
+    static_assert(CAPACITY && (CAPACITY & (CAPACITY - 1)) == 0,
+                  "CAPACITY must be a power of two");
+
+  public:
+    /**
+     * Push n items produced by fill(i) or nothing at all
+     * Strips of a task are pushed in one shot so they stay contiguous
+     */
+    template <typename F> bool try_push_bulk(uint32_t n, F &&fill) {
+        const uint32_t tail = prod.tail.load(std::memory_order_relaxed);
+        if (tail - prod.cached_head + n > CAPACITY) {
+            prod.cached_head = cons.head.load(std::memory_order_acquire);
+            if (tail - prod.cached_head + n > CAPACITY) {
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            slots[(tail + i) & (CAPACITY - 1)] = fill(i);
+        }
+        prod.tail.store(tail + n, std::memory_order_release);
+        return true;
+    }
+
+    bool try_push(const T &item) {
+        return try_push_bulk(1, [&](uint32_t) { return item; });
+    }
+
+    /* Look at the oldest item without consuming it */
+    bool peek(T &item) {
+        const uint32_t head = cons.head.load(std::memory_order_relaxed);
+        if (head == cons.cached_tail) {
+            cons.cached_tail = prod.tail.load(std::memory_order_acquire);
+            if (head == cons.cached_tail) {
+                return false;
+            }
+        }
+        item = slots[head & (CAPACITY - 1)];
+        return true;
+    }
+
+    /* Consume the item returned by the last successful peek */
+    void pop() {
+        cons.head.store(cons.head.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_release);
+    }
+
+    bool try_pop(T &item) {
+        if (!peek(item)) {
+            return false;
+        }
+        pop();
+        return true;
+    }
+
+    /* Only a snapshot when called concurrently with push or pop */
+    uint32_t size() const {
+        return prod.tail.load(std::memory_order_acquire) -
+               cons.head.load(std::memory_order_acquire);
+    }
+
+    static constexpr uint32_t capacity() { return CAPACITY; }
+
+  private:
+    struct alignas(ASTRAEA_CACHE_LINE_SIZE) {
+        std::atomic<uint32_t> tail{0};
+        uint32_t cached_head = 0;
+    } prod;
+    struct alignas(ASTRAEA_CACHE_LINE_SIZE) {
+        std::atomic<uint32_t> head{0};
+        uint32_t cached_tail = 0;
+    } cons;
+    alignas(ASTRAEA_CACHE_LINE_SIZE) T slots[CAPACITY];
+};
+
+/**
+ * Bounded multi-producer single-consumer ring
+ *
+ * Producers claim a contiguous range of positions with a CAS on tail, then
+ * publish each slot through its sequence number, so the items of one bulk
+ * push are never interleaved with another producer's.
+ * The consumer interface is the same as astraea_spsc_ring.
+ */
+template <typename T, uint32_t CAPACITY> class astraea_mpsc_ring {
+    static_assert(CAPACITY && (CAPACITY & (CAPACITY - 1)) == 0,
+                  "CAPACITY must be a power of two");
+
+  public:
+    astraea_mpsc_ring() {
+        for (uint32_t i = 0; i < CAPACITY; i++) {
+            slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename F> bool try_push_bulk(uint32_t n, F &&fill) {
+        uint32_t tail = prod.tail.load(std::memory_order_relaxed);
+        do {
+            const uint32_t head = cons.head.load(std::memory_order_acquire);
+            if (tail - head + n > CAPACITY) {
+                return false;
+            }
+        } while (!prod.tail.compare_exchange_weak(tail, tail + n,
+                                                  std::memory_order_relaxed));
+
+        for (uint32_t i = 0; i < n; i++) {
+            slot &s = slots[(tail + i) & (CAPACITY - 1)];
+            /* The consumer may still be releasing this slot */
+            while (s.seq.load(std::memory_order_acquire) != tail + i) {
+            }
+            s.item = fill(i);
+            s.seq.store(tail + i + 1, std::memory_order_release);
+        }
+        return true;
+    }
+
+    bool try_push(const T &item) {
+        return try_push_bulk(1, [&](uint32_t) { return item; });
+    }
+
+    bool peek(T &item) {
+        const uint32_t head = cons.head.load(std::memory_order_relaxed);
+        const slot &s = slots[head & (CAPACITY - 1)];
+        if (s.seq.load(std::memory_order_acquire) != head + 1) {
+            return false;
+        }
+        item = s.item;
+        return true;
+    }
+
+    void pop() {
+        const uint32_t head = cons.head.load(std::memory_order_relaxed);
+        slots[head & (CAPACITY - 1)].seq.store(head + CAPACITY,
+                                               std::memory_order_release);
+        cons.head.store(head + 1, std::memory_order_release);
+    }
+
+    bool try_pop(T &item) {
+        if (!peek(item)) {
+            return false;
+        }
+        pop();
+        return true;
+    }
+
+    /* Counts claimed slots, some of them may not be published yet */
+    uint32_t size() const {
+        return prod.tail.load(std::memory_order_acquire) -
+               cons.head.load(std::memory_order_acquire);
+    }
+
+    static constexpr uint32_t capacity() { return CAPACITY; }
+
+  private:
+    struct slot {
+        std::atomic<uint32_t> seq;
+        T item;
+    };
+
+    struct alignas(ASTRAEA_CACHE_LINE_SIZE) {
+        std::atomic<uint32_t> tail{0};
+    } prod;
+    struct alignas(ASTRAEA_CACHE_LINE_SIZE) {
+        std::atomic<uint32_t> head{0};
+    } cons;
+    alignas(ASTRAEA_CACHE_LINE_SIZE) slot slots[CAPACITY];
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include <cstddef>
+#include <cstdint>
+
+#include "astraea_scratch.h"
+#include "astraea_slab.h"
+
+void astraea_scratch_allocator::init(size_t size) {
+    nb_units = size >> SCRATCH_MIN_ORDER;
+    used_bytes = 0;
+    state.assign(nb_units, NOT_HEAD);
+    prev.assign(nb_units, ASTRAEA_INVALID_ID);
+    next.assign(nb_units, ASTRAEA_INVALID_ID);
+    for (uint32_t &head : free_heads) {
+        head = ASTRAEA_INVALID_ID;
+    }
+
+    /**
+     * Carve the region greedily from the largest order down
+     * Every block is then aligned to its own size
+     */
+    uint32_t unit = 0;
+    for (uint32_t order = SCRATCH_NB_ORDERS; order-- > 0;) {
+        while (nb_units - unit >= (1u << order)) {
+            push_free(unit, order);
+            unit += 1u << order;
+        }
+    }
+}
+
+void astraea_scratch_allocator::push_free(uint32_t unit, uint32_t order) {
+    state[unit] = order;
+    prev[unit] = ASTRAEA_INVALID_ID;
+    next[unit] = free_heads[order];
+    if (free_heads[order] != ASTRAEA_INVALID_ID) {
+        prev[free_heads[order]] = unit;
+    }
+    free_heads[order] = unit;
+}
+
+void astraea_scratch_allocator::remove_free(uint32_t unit, uint32_t order) {
+    if (prev[unit] != ASTRAEA_INVALID_ID) {
+        next[prev[unit]] = next[unit];
+    } else {
+        free_heads[order] = next[unit];
+    }
+    if (next[unit] != ASTRAEA_INVALID_ID) {
+        prev[next[unit]] = prev[unit];
+    }
+    state[unit] = NOT_HEAD;
+}
+
+bool astraea_scratch_allocator::alloc(size_t size, size_t *offset) {
+    uint32_t order = 0;
+    while ((size_t{1} << (order + SCRATCH_MIN_ORDER)) < size) {
+        order++;
+    }
+
+    uint32_t found = order;
+    while (found < SCRATCH_NB_ORDERS &&
+           free_heads[found] == ASTRAEA_INVALID_ID) {
+        found++;
+    }
+    if (found == SCRATCH_NB_ORDERS) {
+        return false;
+    }
+
+    const uint32_t unit = free_heads[found];
+    remove_free(unit, found);
+
+    /* Split down to the requested order, upper halves go back */
+    while (found > order) {
+        found--;
+        push_free(unit + (1u << found), found);
+    }
+
+    state[unit] = order | ALLOCATED;
+    used_bytes += size_t{1} << (order + SCRATCH_MIN_ORDER);
+    *offset = static_cast<size_t>(unit) << SCRATCH_MIN_ORDER;
+    return true;
+}
+
+void astraea_scratch_allocator::free(size_t offset) {
+    uint32_t unit = offset >> SCRATCH_MIN_ORDER;
+    uint32_t order = state[unit] & ~ALLOCATED;
+    used_bytes -= size_t{1} << (order + SCRATCH_MIN_ORDER);
+
+    /* Merge with free buddies as long as they stay inside the region */
+    while (order < SCRATCH_NB_ORDERS - 1) {
+        const uint32_t buddy = unit ^ (1u << order);
+        if (buddy + (1u << order) > nb_units || state[buddy] != order) {
+            break;
+        }
+        remove_free(buddy, order);
+        unit = unit < buddy ? unit : buddy;
+        order++;
+    }
+    push_free(unit, order);
+}
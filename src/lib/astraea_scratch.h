@@ -0,0 +1,53 @@
+#ifndef ASTRAEA_SCRATCH_H__
+#define ASTRAEA_SCRATCH_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Smallest region handed out is 4KB */
+constexpr uint32_t SCRATCH_MIN_ORDER = 12;
+constexpr uint32_t SCRATCH_MAX_ORDER = 40;
+constexpr uint32_t SCRATCH_NB_ORDERS =
+    SCRATCH_MAX_ORDER - SCRATCH_MIN_ORDER + 1;
+
+/**
+ * Buddy allocator over a pre-registered scratch region
+ *
+ * It only manages offsets, the memory itself is owned by the caller.
+ * All bookkeeping is sized at init, so alloc and free never touch the
+ * global allocator.
+ * A region whose size is not a power of two is covered by several top
+ * level blocks, buddies outside the region are never merged.
+ */
+class astraea_scratch_allocator {
+  public:
+    void init(size_t size);
+
+    /* Return false if no free block is large enough */
+    bool alloc(size_t size, size_t *offset);
+
+    void free(size_t offset);
+
+    size_t capacity() const { return nb_units << SCRATCH_MIN_ORDER; }
+
+    size_t nb_used_bytes() const { return used_bytes; }
+
+  private:
+    static constexpr uint8_t NOT_HEAD = 0xFF;
+    static constexpr uint8_t ALLOCATED = 0x80;
+
+    /* Sizes and indexes below are counted in units of the min block */
+    uint32_t nb_units = 0;
+    size_t used_bytes = 0;
+    /* Order of the block starting at each unit, or NOT_HEAD */
+    std::vector<uint8_t> state;
+    /* Intrusive doubly linked free lists, one per order */
+    std::vector<uint32_t> prev, next;
+    uint32_t free_heads[SCRATCH_NB_ORDERS];
+
+    void push_free(uint32_t unit, uint32_t order);
+    void remove_free(uint32_t unit, uint32_t order);
+};
+
+#endif
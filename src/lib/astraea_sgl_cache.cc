@@ -0,0 +1,211 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <doca_buf.h>
+#include <doca_buf_inventory.h>
+#include <doca_error.h>
+#include <doca_log.h>
+#include <doca_mmap.h>
+
+#include "astraea_sgl_cache.h"
+
+DOCA_LOG_REGISTER(ASTRAEA : SGL_CACHE);
+
+size_t astraea_sgl_key_hash::operator()(const astraea_sgl_key &key) const {
+    size_t hash = std::hash<const void *>()(key.mmap);
+    auto combine = [&hash](size_t value) {
+        hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    };
+    combine(std::hash<const void *>()(key.base_addr));
+    combine(key.nb_data_blocks);
+    combine(key.block_size);
+    combine(key.granularity);
+    return hash;
+}
+
+void astraea_sgl_cache::init(doca_buf_inventory *buf_inventory,
+                             uint32_t max_nb_bufs) {
+    this->buf_inventory = buf_inventory;
+    this->max_nb_bufs = max_nb_bufs;
+}
+
+doca_error_t astraea_sgl_cache::build(astraea_sgl_plan *plan) {
+    const astraea_sgl_key &key = plan->key;
+    const uint32_t nb_strips = key.block_size / key.granularity;
+    doca_error_t status = DOCA_SUCCESS;
+
+    plan->strips.reserve(nb_strips);
+    for (uint32_t i = 0; i < nb_strips; i++) {
+        doca_buf *head = nullptr;
+        for (uint32_t j = 0; j < key.nb_data_blocks; j++) {
+            uint8_t *addr = const_cast<uint8_t *>(key.base_addr) +
+                            j * key.block_size + i * key.granularity;
+
+            doca_buf *buf;
+            status = doca_buf_inventory_buf_get_by_addr(
+                buf_inventory, key.mmap, addr, key.granularity, &buf);
+            if (status != DOCA_SUCCESS) {
+                DOCA_LOG_ERR("Failed to alloc buf for data blocks: %s",
+                             doca_error_get_descr(status));
+                break;
+            }
+
+            status = doca_buf_set_data(buf, addr, key.granularity);
+            if (status != DOCA_SUCCESS) {
+                DOCA_LOG_ERR("Failed to set buf data for data bufs: %s",
+                             doca_error_get_descr(status));
+                doca_buf_dec_refcount(buf, nullptr);
+                break;
+            }
+
+            if (j == 0) {
+                head = buf;
+                continue;
+            }
+
+            status = doca_buf_chain_list(head, buf);
+            if (status != DOCA_SUCCESS) {
+                DOCA_LOG_ERR("Failed to chain list: %s",
+                             doca_error_get_descr(status));
+                doca_buf_dec_refcount(buf, nullptr);
+                break;
+            }
+        }
+
+        if (status != DOCA_SUCCESS) {
+            if (head) {
+                doca_buf_dec_refcount(head, nullptr);
+            }
+            for (doca_buf *strip : plan->strips) {
+                doca_buf_dec_refcount(strip, nullptr);
+            }
+            plan->strips.clear();
+            return status;
+        }
+        plan->strips.push_back(head);
+    }
+    return DOCA_SUCCESS;
+}
+
+void astraea_sgl_cache::destroy(astraea_sgl_plan *plan) {
+    /* Releasing the head of a chain releases the whole chain */
+    for (doca_buf *strip : plan->strips) {
+        doca_buf_dec_refcount(strip, nullptr);
+    }
+    delete plan;
+}
+
+void astraea_sgl_cache::detach(astraea_sgl_plan *plan) {
+    plans.erase(plan->key);
+    stats.nb_plans--;
+    stats.nb_bufs -= plan->nb_bufs;
+    plan->is_detached = true;
+    if (plan->nb_users == 0) {
+        destroy(plan);
+    }
+}
+
+bool astraea_sgl_cache::make_room(uint32_t nb_bufs) {
+    if (nb_bufs > max_nb_bufs) {
+        return false;
+    }
+
+    /* Only runs on misses, a linear scan is cheaper than keeping a LRU list */
+    while (stats.nb_bufs + nb_bufs > max_nb_bufs) {
+        astraea_sgl_plan *victim = nullptr;
+        for (const auto &[key, plan] : plans) {
+            if (plan->nb_users == 0 &&
+                (!victim || plan->last_use < victim->last_use)) {
+                victim = plan;
+            }
+        }
+        if (!victim) {
+            return false;
+        }
+        detach(victim);
+        stats.nb_evictions++;
+    }
+    return true;
+}
+
+doca_error_t astraea_sgl_cache::acquire(const astraea_sgl_key &key,
+                                        astraea_sgl_plan **plan) {
+    *plan = nullptr;
+
+    auto it = plans.find(key);
+    if (it != plans.end()) {
+        astraea_sgl_plan *hit = it->second;
+        hit->nb_users++;
+        hit->last_use = ++clock;
+        stats.nb_hits++;
+        *plan = hit;
+        return DOCA_SUCCESS;
+    }
+    stats.nb_misses++;
+
+    astraea_sgl_plan *new_plan = new astraea_sgl_plan;
+    new_plan->key = key;
+    new_plan->nb_bufs =
+        key.nb_data_blocks * static_cast<uint32_t>(key.block_size /
+                                                   key.granularity);
+    new_plan->nb_users = 1;
+    new_plan->last_use = ++clock;
+    new_plan->is_detached = !make_room(new_plan->nb_bufs);
+
+    doca_error_t status = build(new_plan);
+    if (status != DOCA_SUCCESS) {
+        delete new_plan;
+        return status;
+    }
+
+    if (!new_plan->is_detached) {
+        plans.emplace(key, new_plan);
+        stats.nb_plans++;
+        stats.nb_bufs += new_plan->nb_bufs;
+    }
+
+    *plan = new_plan;
+    return DOCA_SUCCESS;
+}
+
+void astraea_sgl_cache::release(astraea_sgl_plan *plan) {
+    if (--plan->nb_users == 0 && plan->is_detached) {
+        destroy(plan);
+    }
+}
+
+void astraea_sgl_cache::invalidate(doca_mmap *mmap) {
+    std::vector<astraea_sgl_plan *> victims;
+    for (const auto &[key, plan] : plans) {
+        if (!mmap || key.mmap == mmap) {
+            victims.push_back(plan);
+        }
+    }
+    for (astraea_sgl_plan *plan : victims) {
+        detach(plan);
+    }
+    stats.nb_invalidations += victims.size();
+}
+
+void astraea_sgl_cache::invalidate_range(doca_mmap *mmap, const void *addr,
+                                         size_t len) {
+    const uint8_t *begin = static_cast<const uint8_t *>(addr);
+    const uint8_t *end = begin + len;
+
+    std::vector<astraea_sgl_plan *> victims;
+    for (const auto &[key, plan] : plans) {
+        const uint8_t *plan_end =
+            key.base_addr + key.nb_data_blocks * key.block_size;
+        if (key.mmap == mmap && key.base_addr < end && begin < plan_end) {
+            victims.push_back(plan);
+        }
+    }
+    for (astraea_sgl_plan *plan : victims) {
+        detach(plan);
+    }
+    stats.nb_invalidations += victims.size();
+}
+
+void astraea_sgl_cache::clear() { invalidate(nullptr); }
@@ -0,0 +1,100 @@
+#ifndef ASTRAEA_SGL_CACHE_H__
+#define ASTRAEA_SGL_CACHE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <doca_buf.h>
+#include <doca_buf_inventory.h>
+#include <doca_error.h>
+#include <doca_mmap.h>
+
+/* A source buffer sliced with a given granularity */
+struct astraea_sgl_key {
+    doca_mmap *mmap;
+    const uint8_t *base_addr;
+    uint32_t nb_data_blocks;
+    size_t block_size;
+    size_t granularity;
+
+    bool operator==(const astraea_sgl_key &other) const = default;
+};
+
+struct astraea_sgl_key_hash {
+    size_t operator()(const astraea_sgl_key &key) const;
+};
+
+struct astraea_sgl_plan {
+    astraea_sgl_key key;
+    /* Head of the chain of nb_data_blocks bufs of each strip */
+    std::vector<doca_buf *> strips;
+    uint32_t nb_bufs;
+    /* Tasks holding the plan, source chains are only read by DOCA */
+    uint32_t nb_users;
+    /* Not reachable from the cache anymore, freed by its last user */
+    bool is_detached;
+    uint64_t last_use;
+};
+
+struct astraea_sgl_cache_stats {
+    uint64_t nb_hits;
+    uint64_t nb_misses;
+    uint64_t nb_evictions;
+    uint64_t nb_invalidations;
+    /* Plans and bufs currently held by the cache */
+    uint32_t nb_plans;
+    uint32_t nb_bufs;
+};
+
+/**
+ * Prebuilt scatter gather lists of sliced ec tasks
+ *
+ * Encoding the same source buffer again with the same granularity reuses
+ * the chains built the first time instead of taking nb_data_blocks bufs per
+ * strip from the inventory.
+ * Cached bufs are bounded by max_nb_bufs, idle plans are evicted least
+ * recently used first. A plan that does not fit is still built but not
+ * cached.
+ * Not thread-safe, it is driven from task creation and completion.
+ */
+class astraea_sgl_cache {
+  public:
+    void init(doca_buf_inventory *buf_inventory, uint32_t max_nb_bufs);
+
+    doca_error_t acquire(const astraea_sgl_key &key, astraea_sgl_plan **plan);
+
+    void release(astraea_sgl_plan *plan);
+
+    /**
+     * Drop the plans built on mmap, or every plan if mmap is nullptr
+     * Must be called before the memory behind them is unmapped or reused
+     * through another mmap, plans still in flight are freed on completion
+     */
+    void invalidate(doca_mmap *mmap);
+
+    /* Drop the plans of mmap that overlap [addr, addr + len) */
+    void invalidate_range(doca_mmap *mmap, const void *addr, size_t len);
+
+    /* Free every idle plan, called before the inventory is destroyed */
+    void clear();
+
+    const astraea_sgl_cache_stats &get_stats() const { return stats; }
+
+  private:
+    doca_buf_inventory *buf_inventory = nullptr;
+    uint32_t max_nb_bufs = 0;
+    uint64_t clock = 0;
+    astraea_sgl_cache_stats stats = {};
+    std::unordered_map<astraea_sgl_key, astraea_sgl_plan *,
+                       astraea_sgl_key_hash>
+        plans;
+
+    doca_error_t build(astraea_sgl_plan *plan);
+    void destroy(astraea_sgl_plan *plan);
+    void detach(astraea_sgl_plan *plan);
+    bool make_room(uint32_t nb_bufs);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef ASTRAEA_SLAB_H__
+#define ASTRAEA_SLAB_H__
+
+#include <cstdint>
+#include <vector>
+
+constexpr uint32_t ASTRAEA_INVALID_ID = UINT32_MAX;
+
+/**
+ * A lazily grown slab of fixed-size objects referenced by 32-bit ids
+ *
+ * Objects live in chunks of (1 << CHUNK_SHIFT) elements, a chunk is only
+ * allocated when the free list runs dry, so resident memory follows the
+ * peak number of objects in use instead of the configured maximum.
+ * Chunks never move, so pointers to objects stay valid until destruction.
+ *
+ * The slab is not thread-safe, callers serialize alloc and free.
+ */
+template <typename T, uint32_t CHUNK_SHIFT, uint32_t MAX_NB_CHUNKS>
+class astraea_slab {
+  public:
+    static constexpr uint32_t CHUNK_SIZE = 1u << CHUNK_SHIFT;
+    static constexpr uint32_t CAPACITY = CHUNK_SIZE * MAX_NB_CHUNKS;
+
+    astraea_slab() = default;
+    astraea_slab(const astraea_slab &) = delete;
+    astraea_slab &operator=(const astraea_slab &) = delete;
+
+    ~astraea_slab() {
+        for (uint32_t i = 0; i < nb_chunks; i++) {
+            delete[] chunks[i];
+        }
+    }
+
+    /* Return ASTRAEA_INVALID_ID if the slab reaches its capacity */
+    uint32_t alloc() {
+        if (free_ids.empty() && !grow()) {
+            return ASTRAEA_INVALID_ID;
+        }
+        uint32_t id = free_ids.back();
+        free_ids.pop_back();
+        return id;
+    }
+
+    void free(uint32_t id) { free_ids.push_back(id); }
+
+    T &operator[](uint32_t id) {
+        return chunks[id >> CHUNK_SHIFT][id & (CHUNK_SIZE - 1)];
+    }
+
+    /* Number of ids backed by allocated chunks */
+    uint32_t nb_reserved() const { return nb_chunks * CHUNK_SIZE; }
+
+    uint32_t nb_in_use() const {
+        return nb_reserved() - static_cast<uint32_t>(free_ids.size());
+    }
+
+  private:
+    T *chunks[MAX_NB_CHUNKS] = {};
+    uint32_t nb_chunks = 0;
+    std::vector<uint32_t> free_ids;
+
+    bool grow() {
+        if (nb_chunks == MAX_NB_CHUNKS) {
+            return false;
+        }
+        chunks[nb_chunks] = new T[CHUNK_SIZE];
+        const uint32_t base = nb_chunks * CHUNK_SIZE;
+        nb_chunks++;
+
+        free_ids.reserve(nb_reserved());
+        /* Push in reverse order so that ids are handed out ascending */
+        for (uint32_t i = CHUNK_SIZE; i > 0; i--) {
+            free_ids.push_back(base + i - 1);
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,153 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stop_token>
+#include <thread>
+
+#include <doca_error.h>
+#include <doca_log.h>
+
+#include "astraea_doorbell.h"
+#include "astraea_spillover.h"
+
+DOCA_LOG_REGISTER(ASTRAEA : SPILLOVER);
+
+/* Park timeouts only guard against lost wake ups */
+constexpr uint64_t WORKER_PARK_TIMEOUT_NS = 10 * 1000 * 1000;
+/* Weight of the latest job in the time estimate, as a shift */
+constexpr uint32_t COST_EWMA_SHIFT = 3;
+
+doca_error_t astraea_spillover_pool::start(uint32_t nb_workers, run_fn run,
+                                           notify_fn notify, void *arg,
+                                           double ns_per_unit) {
+    if (nb_workers == 0 || nb_workers > MAX_NB_SPILLOVER_WORKERS) {
+        DOCA_LOG_ERR("Spillover workers must be in [1, %u]",
+                     MAX_NB_SPILLOVER_WORKERS);
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+    if (is_started()) {
+        return DOCA_SUCCESS;
+    }
+
+    this->run = run;
+    this->notify = notify;
+    this->arg = arg;
+    this->ns_per_unit.store(ns_per_unit, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < nb_workers; i++) {
+        workers.push_back(std::make_unique<worker>());
+    }
+    /* Rings are in place before any thread looks at them */
+    for (std::unique_ptr<worker> &w : workers) {
+        w->thread = std::jthread{work, this, w.get()};
+    }
+    return DOCA_SUCCESS;
+}
+
+void astraea_spillover_pool::stop() {
+    for (std::unique_ptr<worker> &w : workers) {
+        w->thread.request_stop();
+    }
+    workers.clear();
+}
+
+bool astraea_spillover_pool::try_dispatch(uint32_t job_id, uint64_t nb_units,
+                                          uint64_t budget_ns) {
+    if (nb_inflight.load(std::memory_order_acquire) == SPILLOVER_QUEUE_SIZE) {
+        nb_refused.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    worker *idlest = nullptr;
+    uint64_t idlest_pending_ns = UINT64_MAX;
+    for (std::unique_ptr<worker> &w : workers) {
+        const uint64_t pending_ns =
+            w->pending_ns.load(std::memory_order_relaxed);
+        if (pending_ns < idlest_pending_ns) {
+            idlest = w.get();
+            idlest_pending_ns = pending_ns;
+        }
+    }
+
+    const uint64_t cost_ns =
+        nb_units * ns_per_unit.load(std::memory_order_relaxed);
+    if (idlest == nullptr || idlest_pending_ns + cost_ns > budget_ns) {
+        nb_refused.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    /* nb_inflight bounds the ring, the push can't fail */
+    nb_inflight.fetch_add(1, std::memory_order_relaxed);
+    idlest->pending_ns.fetch_add(cost_ns, std::memory_order_relaxed);
+    idlest->jobs.try_push({.id = job_id, .nb_units = nb_units,
+                           .cost_ns = cost_ns});
+    idlest->doorbell.ring();
+    nb_dispatched.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool astraea_spillover_pool::try_pop_completion(
+    astraea_spill_completion &completion) {
+    if (!completions.try_pop(completion)) {
+        return false;
+    }
+    nb_inflight.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void astraea_spillover_pool::get_stats(astraea_spillover_stats *stats) const {
+    stats->nb_dispatched = nb_dispatched.load(std::memory_order_relaxed);
+    stats->nb_refused = nb_refused.load(std::memory_order_relaxed);
+    stats->nb_failed = nb_failed.load(std::memory_order_relaxed);
+    stats->busy_ns = busy_ns.load(std::memory_order_relaxed);
+    stats->ns_per_unit = ns_per_unit.load(std::memory_order_relaxed);
+}
+
+/* Jobs queued when the stop is requested still run */
+void astraea_spillover_pool::work(std::stop_token stoken,
+                                  astraea_spillover_pool *pool,
+                                  worker *self) {
+    std::stop_callback wake_on_stop(stoken,
+                                    [self] { self->doorbell.ring(); });
+
+    while (true) {
+        const uint32_t seen_seq =
+            self->doorbell.seq.load(std::memory_order_acquire);
+        job next_job;
+        if (!self->jobs.try_pop(next_job)) {
+            if (stoken.stop_requested()) {
+                break;
+            }
+            self->doorbell.park(seen_seq, WORKER_PARK_TIMEOUT_NS, [self] {
+                return self->jobs.size() > 0;
+            });
+            continue;
+        }
+
+        const uint64_t begin_ns = astraea_now_ns();
+        const bool is_success = pool->run(pool->arg, next_job.id);
+        const uint64_t elapsed_ns = astraea_now_ns() - begin_ns;
+
+        /* Workers race on the estimate, a lost update only delays it */
+        if (next_job.nb_units > 0) {
+            const double estimate =
+                pool->ns_per_unit.load(std::memory_order_relaxed);
+            const double measured =
+                static_cast<double>(elapsed_ns) / next_job.nb_units;
+            pool->ns_per_unit.store(
+                estimate + (measured - estimate) / (1 << COST_EWMA_SHIFT),
+                std::memory_order_relaxed);
+        }
+        pool->busy_ns.fetch_add(elapsed_ns, std::memory_order_relaxed);
+        if (!is_success) {
+            pool->nb_failed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        pool->completions.try_push(
+            {.job_id = next_job.id, .has_failed = !is_success});
+        if (pool->notify) {
+            pool->notify(pool->arg);
+        }
+        self->pending_ns.fetch_sub(next_job.cost_ns,
+                                   std::memory_order_relaxed);
+    }
+}
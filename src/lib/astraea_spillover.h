@@ -0,0 +1,106 @@
+#ifndef ASTRAEA_SPILLOVER_H__
+#define ASTRAEA_SPILLOVER_H__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include <doca_error.h>
+
+#include "astraea_doorbell.h"
+#include "astraea_ring.h"
+
+constexpr uint32_t MAX_NB_SPILLOVER_WORKERS = 16;
+/* Jobs queued or running across all workers, a power of two */
+constexpr uint32_t SPILLOVER_QUEUE_SIZE = 1024;
+
+/* A job a worker has run */
+struct astraea_spill_completion {
+    uint32_t job_id;
+    bool has_failed;
+};
+
+struct astraea_spillover_stats {
+    uint64_t nb_dispatched;
+    /* Dispatches refused because no worker would finish in time */
+    uint64_t nb_refused;
+    uint64_t nb_failed;
+    /* Time the workers spent running jobs */
+    uint64_t busy_ns;
+    /* Current estimate of the time of one unit of work */
+    double ns_per_unit;
+};
+
+/**
+ * Bounded pool of CPU worker threads
+ *
+ * One thread dispatches jobs, one thread pops their completions, they may
+ * be the same. A job is sized in units of work, its time is predicted from
+ * a moving average of the times the workers measured. Each worker owns a
+ * job ring and parks on its doorbell when the ring is empty, a job goes to
+ * the worker that frees up first, and only if it finishes within the
+ * budget the dispatcher gives.
+ */
+class astraea_spillover_pool {
+  public:
+    /* Run job_id on a worker thread, false if it failed */
+    typedef bool (*run_fn)(void *arg, uint32_t job_id);
+    /* Called by a worker once a completion is queued, may be nullptr */
+    typedef void (*notify_fn)(void *arg);
+
+    doca_error_t start(uint32_t nb_workers, run_fn run, notify_fn notify,
+                       void *arg, double ns_per_unit);
+
+    /* Completions may be waiting, a snapshot off the popping thread */
+    bool has_completions() const { return completions.size() > 0; }
+
+    /* Run the jobs already queued and join the workers */
+    void stop();
+
+    bool is_started() const { return !workers.empty(); }
+
+    /* Queue the job, false if it would not finish within budget_ns */
+    bool try_dispatch(uint32_t job_id, uint64_t nb_units, uint64_t budget_ns);
+
+    bool try_pop_completion(astraea_spill_completion &completion);
+
+    void get_stats(astraea_spillover_stats *stats) const;
+
+  private:
+    struct job {
+        uint32_t id;
+        uint64_t nb_units;
+        uint64_t cost_ns;
+    };
+
+    struct worker {
+        astraea_spsc_ring<job, SPILLOVER_QUEUE_SIZE> jobs;
+        astraea_doorbell doorbell;
+        /* Predicted time of the jobs queued on it or running */
+        std::atomic<uint64_t> pending_ns{0};
+        std::jthread thread;
+    };
+
+    static void work(std::stop_token stoken, astraea_spillover_pool *pool,
+                     worker *self);
+
+    run_fn run = nullptr;
+    notify_fn notify = nullptr;
+    void *arg = nullptr;
+    std::vector<std::unique_ptr<worker>> workers;
+    astraea_mpsc_ring<astraea_spill_completion, SPILLOVER_QUEUE_SIZE>
+        completions;
+    /* Dispatched and not popped, bounds every ring */
+    std::atomic<uint32_t> nb_inflight{0};
+    std::atomic<double> ns_per_unit{0};
+
+    std::atomic<uint64_t> nb_dispatched{0};
+    std::atomic<uint64_t> nb_refused{0};
+    std::atomic<uint64_t> nb_failed{0};
+    std::atomic<uint64_t> busy_ns{0};
+};
+
+#endif
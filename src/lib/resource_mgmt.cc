@@ -1,3 +1,4 @@
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <fcntl.h>
@@ -12,14 +13,11 @@
 
 DOCA_LOG_REGISTER(RESOURCE_MGMT);
 
-/* Per app global variables */
-sem_t *metadata_sem = nullptr;
-sem_t *ec_token_sem = nullptr;
-sem_t *ec_deficit_sem = nullptr;
-int shm_fd = -1;
-shared_resources *shm_data = nullptr;
-uint32_t app_id = -1;
-std::chrono::microseconds latency_sla;
+static std::atomic<astraea_session *> default_session{nullptr};
+
+astraea_session *astraea_default_session() {
+    return default_session.load(std::memory_order_acquire);
+}
 
 /**
  * This function not only register this app in shared memory
@@ -27,83 +25,102 @@ std::chrono::microseconds latency_sla;
  */
 astraea_authenticator::astraea_authenticator(uint32_t latency,
                                              doca_error_t *status) {
-    latency_sla = std::chrono::microseconds(latency);
+    session.latency_sla = std::chrono::microseconds(latency);
     *status = DOCA_SUCCESS;
 
     pid_t pid = getpid();
 
-    metadata_sem = sem_open(METADATA_SEM_NAME, 0);
-    if (metadata_sem == SEM_FAILED) {
+    session.metadata_sem = sem_open(METADATA_SEM_NAME, 0);
+    if (session.metadata_sem == SEM_FAILED) {
         DOCA_LOG_ERR("Failed to open metadata_sem");
+        session.metadata_sem = nullptr;
         *status = DOCA_ERROR_IO_FAILED;
         return;
     }
 
-    shm_fd = shm_open(SHM_NAME, O_RDWR, 0666);
-    if (shm_fd == -1) {
+    session.shm_fd = shm_open(SHM_NAME, O_RDWR, 0666);
+    if (session.shm_fd == -1) {
         DOCA_LOG_ERR("Failed to open shared memory");
         *status = DOCA_ERROR_IO_FAILED;
         return;
     }
 
-    shm_data = static_cast<shared_resources *>(
-        mmap(nullptr, SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0));
-    if (shm_data == MAP_FAILED) {
+    void *shm_addr = mmap(nullptr, SHM_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, session.shm_fd, 0);
+    if (shm_addr == MAP_FAILED) {
         DOCA_LOG_ERR("Failed to map shared memory");
         *status = DOCA_ERROR_IO_FAILED;
         return;
     }
+    session.shm_data = static_cast<shared_resources *>(shm_addr);
+    shared_resources *shm_data = session.shm_data;
 
-    if (sem_wait(metadata_sem) == -1) {
+    if (sem_wait(session.metadata_sem) == -1) {
         DOCA_LOG_ERR("Failed to access metadata_sem");
         *status = DOCA_ERROR_IO_FAILED;
         return;
     }
 
-    ec_token_sem = sem_open(EC_TOKEN_SEM_NAMES[shm_data->nb_apps], 0);
-    if (ec_token_sem == SEM_FAILED) {
+    session.ec_token_sem = sem_open(EC_TOKEN_SEM_NAMES[shm_data->nb_apps], 0);
+    if (session.ec_token_sem == SEM_FAILED) {
         DOCA_LOG_ERR("Failed to open corresbonding token sem");
-        sem_post(metadata_sem);
+        session.ec_token_sem = nullptr;
+        sem_post(session.metadata_sem);
         *status = DOCA_ERROR_IO_FAILED;
         return;
     }
 
-    ec_deficit_sem = sem_open(EC_DEFICIT_SEM_NAMES[shm_data->nb_apps], 0);
-    if (ec_deficit_sem == SEM_FAILED) {
+    session.ec_deficit_sem =
+        sem_open(EC_DEFICIT_SEM_NAMES[shm_data->nb_apps], 0);
+    if (session.ec_deficit_sem == SEM_FAILED) {
         DOCA_LOG_ERR("Failed to open corresbonding deficit sem");
-        sem_post(metadata_sem);
+        session.ec_deficit_sem = nullptr;
+        sem_post(session.metadata_sem);
         *status = DOCA_ERROR_IO_FAILED;
         return;
     }
 
-    app_id = shm_data->nb_apps;
+    session.app_id = shm_data->nb_apps;
     shm_data->pids[shm_data->nb_apps++] = pid;
 
-    if (sem_post(metadata_sem) == -1) {
+    if (sem_post(session.metadata_sem) == -1) {
         DOCA_LOG_ERR("Failed to release metadata_sem");
         *status = DOCA_ERROR_IO_FAILED;
         return;
     }
+
+    astraea_session *expected = nullptr;
+    default_session.compare_exchange_strong(expected, &session,
+                                            std::memory_order_acq_rel);
 }
 
 astraea_authenticator::~astraea_authenticator() {
-    if (shm_data) {
-        munmap(shm_data, SHM_SIZE);
-        shm_data = nullptr;
+    astraea_session *expected = &session;
+    default_session.compare_exchange_strong(expected, nullptr,
+                                            std::memory_order_acq_rel);
+
+    if (session.shm_data) {
+        munmap(session.shm_data, SHM_SIZE);
+        session.shm_data = nullptr;
     }
 
-    if (shm_fd != -1) {
-        close(shm_fd);
-        shm_fd = -1;
+    if (session.shm_fd != -1) {
+        close(session.shm_fd);
+        session.shm_fd = -1;
     }
 
-    if (ec_token_sem) {
-        sem_close(ec_token_sem);
-        ec_token_sem = nullptr;
+    if (session.ec_token_sem) {
+        sem_close(session.ec_token_sem);
+        session.ec_token_sem = nullptr;
     }
 
-    if (metadata_sem) {
-        sem_close(metadata_sem);
-        metadata_sem = nullptr;
+    if (session.ec_deficit_sem) {
+        sem_close(session.ec_deficit_sem);
+        session.ec_deficit_sem = nullptr;
     }
-}
\ No newline at end of file
+
+    if (session.metadata_sem) {
+        sem_close(session.metadata_sem);
+        session.metadata_sem = nullptr;
+    }
+}
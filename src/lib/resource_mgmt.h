@@ -1,8 +1,10 @@
 #ifndef RESOURCE_MGMT_H__
 #define RESOURCE_MGMT_H__
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <semaphore.h>
 #include <sys/types.h>
 
 #include <doca_error.h>
@@ -33,6 +35,9 @@ constexpr char EC_DEFICIT_SEM_NAMES[MAX_NB_APPS][MAX_SEM_NAME_LEN] = {
 
 constexpr char SHM_NAME[] = "/shm";
 
+/* The scheduler refreshes every bucket this often */
+constexpr uint64_t TOKEN_REFRESH_PERIOD_NS = 1000 * 1000;
+
 /* This locates on shared memory */
 struct shared_resources {
     uint32_t nb_apps;
@@ -41,18 +46,52 @@ struct shared_resources {
     /* Deficits for scheduling */
     uint32_t deficits[MAX_NB_APPS];
     pid_t pids[MAX_NB_APPS];
+    /**
+     * Bumped after every token refresh, a futex word that submitters out of
+     * tokens park on, see astraea_doorbell.h
+     */
+    uint32_t token_epoch;
+    /* CLOCK_MONOTONIC time of the last refresh */
+    uint64_t token_refresh_ns;
 };
 
 constexpr size_t SHM_SIZE = sizeof(shared_resources);
 
+/**
+ * What an app sees of the scheduler: its token bucket, its deficit and its
+ * latency sla
+ * All ctxs created from one session share the bucket, whatever pe or thread
+ * drives them
+ */
+struct astraea_session {
+    sem_t *metadata_sem = nullptr;
+    sem_t *ec_token_sem = nullptr;
+    sem_t *ec_deficit_sem = nullptr;
+    int shm_fd = -1;
+    shared_resources *shm_data = nullptr;
+    uint32_t app_id = UINT32_MAX;
+    std::chrono::microseconds latency_sla{0};
+};
+
 /**
  * A RAII class to register app
- * And pre-allocate global vars(shared memory and semaphore)
+ * And pre-allocate the session (shared memory and semaphore)
  */
 class astraea_authenticator {
   public:
     astraea_authenticator(uint32_t latency, doca_error_t *status);
     ~astraea_authenticator();
+
+    astraea_session *get_session() { return &session; }
+
+  private:
+    astraea_session session;
 };
 
+/**
+ * Session of the first authenticator still alive, nullptr if there is none
+ * Used by the calls that don't take a session
+ */
+astraea_session *astraea_default_session();
+
 #endif
\ No newline at end of file
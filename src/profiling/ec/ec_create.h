@@ -10,25 +10,50 @@
 #include <doca_error.h>
 #include <doca_mmap.h>
 #include <doca_pe.h>
+#include <string>
+#include <utility>
 #include <vector>
 
 constexpr uint32_t MAX_NB_EC_TASKS = 8192;
 
+/* The DOCA task a configuration times */
+enum ec_task_kind {
+    EC_TASK_CREATE,
+    /* Rebuild the first nb_rdnc_blocks of the k + m blocks from the k others */
+    EC_TASK_RECOVER,
+    /* Fold all k data blocks changed into the m parity blocks */
+    EC_TASK_UPDATE,
+};
+
 struct ec_create_config {
+    doca_ec_matrix_type matrix_type;
     uint32_t nb_data_blocks;
     uint32_t nb_rdnc_blocks;
     size_t block_size;
     uint32_t nb_tasks;
+    /* Timed rounds, after nb_warmups untimed ones */
+    uint32_t nb_repetitions;
+    uint32_t nb_warmups;
+    ec_task_kind task_kind;
 };
 
+/* Blocks a task reads, an update reads the old and new data and the parity */
+static inline uint32_t ec_create_nb_src_blocks(const ec_create_config &cfg) {
+    return cfg.task_kind == EC_TASK_UPDATE
+               ? 2 * cfg.nb_data_blocks + cfg.nb_rdnc_blocks
+               : cfg.nb_data_blocks;
+}
+
 /* Helper class to allocate and destroy resources */
 class ec_create_resources {
   public:
     doca_dev *dev = nullptr;
 
     doca_ec_matrix *matrix = nullptr;
+    /* Recover or update matrix derived from matrix */
+    doca_ec_matrix *derived_matrix = nullptr;
     doca_ec *ec = nullptr;
-    std::vector<doca_ec_task_create *> tasks;
+    std::vector<doca_task *> tasks;
     doca_ctx *ctx = nullptr;
 
     doca_pe *pe = nullptr;
@@ -44,10 +69,76 @@ class ec_create_resources {
 
     doca_error_t prepare_memory(const ec_create_config &cfg);
 
-    doca_error_t setup_ec_ctx(doca_ec_task_create_completion_cb_t success_cb,
-                              doca_ec_task_create_completion_cb_t error_cb);
+    doca_error_t
+    setup_ec_ctx(doca_ec_task_create_completion_cb_t success_cb,
+                 doca_ec_task_create_completion_cb_t error_cb,
+                 doca_ec_task_recover_completion_cb_t recover_success_cb,
+                 doca_ec_task_recover_completion_cb_t recover_error_cb,
+                 doca_ec_task_update_completion_cb_t update_success_cb,
+                 doca_ec_task_update_completion_cb_t update_error_cb);
 
     doca_error_t open_dev();
 };
 
-doca_error_t ec_create(const ec_create_config &cfg);
+/**
+ * Run rounds of cfg.nb_tasks tasks at once
+ * Report the mean time of a task in every timed round
+ */
+doca_error_t ec_create(const ec_create_config &cfg,
+                       std::vector<double> *per_task_times_us);
+
+/* Summary of the rounds of one configuration */
+struct ec_create_sample {
+    const char *matrix_type;
+    uint32_t nb_data_blocks;
+    uint32_t nb_rdnc_blocks;
+    size_t block_size;
+    uint32_t nb_repetitions;
+    double mean_us;
+    double stddev_us;
+    double min_us;
+    double max_us;
+};
+
+ec_create_sample ec_create_summarize(const ec_create_config &cfg,
+                                     const char *matrix_type,
+                                     const std::vector<double> &times_us);
+
+/**
+ * Fit of the multiplicative model the builtin cost model uses
+ *     time_us = (a[0] + a[1] * k) * (b[0] + b[1] * m) * (c[0] + c[1] * s)
+ * Errors are relative to the measured means.
+ */
+struct ec_cost_fit {
+    double a[2], b[2], c[2];
+    uint32_t nb_points;
+    uint32_t nb_iterations;
+    double rmse_us;
+    double mean_rel_err;
+    double max_rel_err;
+    double r2;
+};
+
+static inline double ec_cost_fit_time_us(const ec_cost_fit &fit,
+                                         uint32_t nb_data_blocks,
+                                         uint32_t nb_rdnc_blocks,
+                                         size_t block_size) {
+    return (fit.a[0] + fit.a[1] * nb_data_blocks) *
+           (fit.b[0] + fit.b[1] * nb_rdnc_blocks) *
+           (fit.c[0] + fit.c[1] * static_cast<double>(block_size));
+}
+
+/* Least squares on relative error, samples must be of one matrix type */
+doca_error_t ec_cost_fit_samples(const std::vector<ec_create_sample> &samples,
+                                 ec_cost_fit *fit);
+
+/**
+ * Write the results of a sweep into out_dir
+ *     ec_create.csv, ec_create.json    every configuration and its spread
+ *     ec_cost_model.txt                means, for ASTRAEA_COST_MODEL
+ *     ec_cost_model_fit.txt            the fits on the same points
+ *     ec_cost_fit.json                 coefficients and fit errors
+ */
+doca_error_t ec_create_write_results(
+    const std::string &out_dir, const std::vector<ec_create_sample> &samples,
+    const std::vector<std::pair<const char *, ec_cost_fit>> &fits);
@@ -5,6 +5,7 @@
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <vector>
 
 #include <doca_buf.h>
 #include <doca_buf_inventory.h>
@@ -22,7 +23,7 @@
 
 DOCA_LOG_REGISTER(EC_CREATE : CORE);
 
-/* Tasks will be free in the destructor */
+/* Tasks are freed after each round, or in the destructor on failure */
 void ec_create_success_cb(doca_ec_task_create *task, doca_data task_user_data,
                           doca_data ctx_user_data) {
     (void)task;
@@ -38,8 +39,128 @@ void ec_create_error_cb(doca_ec_task_create *task, doca_data task_user_data,
     (*nb_finished_tasks)++;
     DOCA_LOG_ERR("EC create task failed");
 }
+void ec_recover_success_cb(doca_ec_task_recover *task,
+                           doca_data task_user_data, doca_data ctx_user_data) {
+    (void)task;
+    (void)ctx_user_data;
+    uint32_t *nb_finished_tasks = static_cast<uint32_t *>(task_user_data.ptr);
+    (*nb_finished_tasks)++;
+}
+void ec_recover_error_cb(doca_ec_task_recover *task, doca_data task_user_data,
+                         doca_data ctx_user_data) {
+    (void)task;
+    (void)ctx_user_data;
+    uint32_t *nb_finished_tasks = static_cast<uint32_t *>(task_user_data.ptr);
+    (*nb_finished_tasks)++;
+    DOCA_LOG_ERR("EC recover task failed");
+}
+void ec_update_success_cb(doca_ec_task_update *task, doca_data task_user_data,
+                          doca_data ctx_user_data) {
+    (void)task;
+    (void)ctx_user_data;
+    uint32_t *nb_finished_tasks = static_cast<uint32_t *>(task_user_data.ptr);
+    (*nb_finished_tasks)++;
+}
+void ec_update_error_cb(doca_ec_task_update *task, doca_data task_user_data,
+                        doca_data ctx_user_data) {
+    (void)task;
+    (void)ctx_user_data;
+    uint32_t *nb_finished_tasks = static_cast<uint32_t *>(task_user_data.ptr);
+    (*nb_finished_tasks)++;
+    DOCA_LOG_ERR("EC update task failed");
+}
+
+static doca_error_t allocate_task(const ec_create_config &cfg,
+                                  ec_create_resources &rscs, doca_buf *dst_buf,
+                                  uint32_t *nb_finished_tasks,
+                                  doca_task **task) {
+    doca_error_t status;
+    switch (cfg.task_kind) {
+    case EC_TASK_RECOVER: {
+        doca_ec_task_recover *recover_task;
+        status = doca_ec_task_recover_allocate_init(
+            rscs.ec, rscs.derived_matrix, rscs.src_buf, dst_buf,
+            {.ptr = nb_finished_tasks}, &recover_task);
+        if (status == DOCA_SUCCESS) {
+            *task = doca_ec_task_recover_as_task(recover_task);
+        }
+        break;
+    }
+    case EC_TASK_UPDATE: {
+        doca_ec_task_update *update_task;
+        status = doca_ec_task_update_allocate_init(
+            rscs.ec, rscs.derived_matrix, rscs.src_buf, dst_buf,
+            {.ptr = nb_finished_tasks}, &update_task);
+        if (status == DOCA_SUCCESS) {
+            *task = doca_ec_task_update_as_task(update_task);
+        }
+        break;
+    }
+    default: {
+        doca_ec_task_create *create_task;
+        status = doca_ec_task_create_allocate_init(
+            rscs.ec, rscs.matrix, rscs.src_buf, dst_buf,
+            {.ptr = nb_finished_tasks}, &create_task);
+        if (status == DOCA_SUCCESS) {
+            *task = doca_ec_task_create_as_task(create_task);
+        }
+        break;
+    }
+    }
+    return status;
+}
 
-doca_error_t ec_create(const ec_create_config &cfg) {
+/* Submit nb_tasks tasks at once and time them until the last completes */
+static doca_error_t run_round(const ec_create_config &cfg,
+                              ec_create_resources &rscs,
+                              double *time_cost_in_us) {
+    doca_error_t status;
+
+    uint32_t nb_finished_tasks = 0;
+    for (uint32_t i = 0; i < cfg.nb_tasks; i++) {
+        doca_task *task;
+        status = allocate_task(cfg, rscs, rscs.dst_bufs[i], &nb_finished_tasks,
+                               &task);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to allocate and init ec task: %s",
+                         doca_error_get_descr(status));
+            return status;
+        }
+
+        rscs.tasks.push_back(task);
+
+        status = doca_task_submit_ex(task, DOCA_TASK_SUBMIT_FLAG_NONE);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to submit task: %s",
+                         doca_error_get_descr(status));
+            return status;
+        }
+    }
+
+    auto begin_time = std::chrono::high_resolution_clock::now();
+    doca_ctx_flush_tasks(rscs.ctx);
+
+    while (nb_finished_tasks < rscs.tasks.size())
+        (void)doca_pe_progress(rscs.pe);
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    *time_cost_in_us =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end_time -
+                                                             begin_time)
+            .count() /
+        (double)1000;
+
+    /* The next round reuses the same bufs */
+    for (doca_task *task : rscs.tasks)
+        doca_task_free(task);
+    rscs.tasks.clear();
+
+    return DOCA_SUCCESS;
+}
+
+doca_error_t ec_create(const ec_create_config &cfg,
+                       std::vector<double> *per_task_times_us) {
     doca_error_t status;
 
     ec_create_resources rscs;
@@ -59,7 +180,9 @@ doca_error_t ec_create(const ec_create_config &cfg) {
     }
 
     /* Create and config ec ctx */
-    status = rscs.setup_ec_ctx(ec_create_success_cb, ec_create_error_cb);
+    status = rscs.setup_ec_ctx(ec_create_success_cb, ec_create_error_cb,
+                               ec_recover_success_cb, ec_recover_error_cb,
+                               ec_update_success_cb, ec_update_error_cb);
     if (status != DOCA_SUCCESS) {
         DOCA_LOG_ERR("Failed to setup ec ctx");
         return status;
@@ -73,7 +196,7 @@ doca_error_t ec_create(const ec_create_config &cfg) {
     }
 
     /* Create and submit task */
-    status = doca_ec_matrix_create(rscs.ec, DOCA_EC_MATRIX_TYPE_CAUCHY,
+    status = doca_ec_matrix_create(rscs.ec, cfg.matrix_type,
                                    cfg.nb_data_blocks, cfg.nb_rdnc_blocks,
                                    &rscs.matrix);
     if (status != DOCA_SUCCESS) {
@@ -82,46 +205,41 @@ doca_error_t ec_create(const ec_create_config &cfg) {
         return status;
     }
 
-    uint32_t nb_finished_tasks = 0;
-    for (uint32_t i = 0; i < cfg.nb_tasks; i++) {
-        doca_ec_task_create *task;
-        status = doca_ec_task_create_allocate_init(
-            rscs.ec, rscs.matrix, rscs.src_buf, rscs.dst_bufs[i],
-            {.ptr = &nb_finished_tasks}, &task);
+    /* Recover tasks lose the first m blocks, updates change every data one */
+    if (cfg.task_kind != EC_TASK_CREATE) {
+        const uint32_t nb_indices = cfg.task_kind == EC_TASK_RECOVER
+                                        ? cfg.nb_rdnc_blocks
+                                        : cfg.nb_data_blocks;
+        std::vector<uint32_t> indices(nb_indices);
+        for (uint32_t i = 0; i < nb_indices; i++) {
+            indices[i] = i;
+        }
+        status = cfg.task_kind == EC_TASK_RECOVER
+                     ? doca_ec_matrix_create_recover(
+                           rscs.ec, rscs.matrix, indices.data(),
+                           indices.size(), &rscs.derived_matrix)
+                     : doca_ec_matrix_create_update(
+                           rscs.ec, rscs.matrix, indices.data(),
+                           indices.size(), &rscs.derived_matrix);
         if (status != DOCA_SUCCESS) {
-            DOCA_LOG_ERR("Failed to allocate and init ec task: %s",
+            DOCA_LOG_ERR("Failed to create derived matrix: %s",
                          doca_error_get_descr(status));
             return status;
         }
+    }
 
-        rscs.tasks.push_back(task);
-
-        status = doca_task_submit_ex(doca_ec_task_create_as_task(task),
-                                     DOCA_TASK_SUBMIT_FLAG_NONE);
+    per_task_times_us->clear();
+    const uint32_t nb_rounds = cfg.nb_warmups + cfg.nb_repetitions;
+    for (uint32_t round = 0; round < nb_rounds; round++) {
+        double time_cost_in_us;
+        status = run_round(cfg, rscs, &time_cost_in_us);
         if (status != DOCA_SUCCESS) {
-            DOCA_LOG_ERR("Failed to submit task: %s",
-                         doca_error_get_descr(status));
             return status;
         }
+        if (round >= cfg.nb_warmups) {
+            per_task_times_us->push_back(time_cost_in_us / cfg.nb_tasks);
+        }
     }
 
-    auto begin_time = std::chrono::high_resolution_clock::now();
-    doca_ctx_flush_tasks(rscs.ctx);
-
-    while (nb_finished_tasks < cfg.nb_tasks)
-        (void)doca_pe_progress(rscs.pe);
-
-    auto end_time = std::chrono::high_resolution_clock::now();
-
-    double time_cost_in_us =
-        std::chrono::duration_cast<std::chrono::nanoseconds>(end_time -
-                                                             begin_time)
-            .count() /
-        (double)1000;
-    DOCA_LOG_INFO("All tasks finished, nb_data_blocks = %u, nb_rdnc_blocks = "
-                  "%u, block_size = %lu, per_task_time = %fus",
-                  cfg.nb_data_blocks, cfg.nb_rdnc_blocks, cfg.block_size,
-                  time_cost_in_us / cfg.nb_tasks);
-
     return DOCA_SUCCESS;
 }
@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <doca_error.h>
+#include <doca_log.h>
+
+#include "ec_create.h"
+
+DOCA_LOG_REGISTER(EC_CREATE : FIT);
+
+constexpr uint32_t MAX_FIT_ITERATIONS = 500;
+/* Stop once a cycle improves the weighted error by less than this share */
+constexpr double FIT_TOLERANCE = 1e-10;
+
+ec_create_sample ec_create_summarize(const ec_create_config &cfg,
+                                     const char *matrix_type,
+                                     const std::vector<double> &times_us) {
+    ec_create_sample sample = {.matrix_type = matrix_type,
+                               .nb_data_blocks = cfg.nb_data_blocks,
+                               .nb_rdnc_blocks = cfg.nb_rdnc_blocks,
+                               .block_size = cfg.block_size,
+                               .nb_repetitions =
+                                   static_cast<uint32_t>(times_us.size()),
+                               .mean_us = 0,
+                               .stddev_us = 0,
+                               .min_us = 0,
+                               .max_us = 0};
+    if (times_us.empty()) {
+        return sample;
+    }
+
+    double sum = 0;
+    for (double t : times_us)
+        sum += t;
+    sample.mean_us = sum / times_us.size();
+
+    /* Sample standard deviation, zero with a single round */
+    double sq_sum = 0;
+    for (double t : times_us)
+        sq_sum += (t - sample.mean_us) * (t - sample.mean_us);
+    if (times_us.size() > 1) {
+        sample.stddev_us = std::sqrt(sq_sum / (times_us.size() - 1));
+    }
+
+    auto [min_it, max_it] = std::minmax_element(times_us.begin(),
+                                                times_us.end());
+    sample.min_us = *min_it;
+    sample.max_us = *max_it;
+    return sample;
+}
+
+/* Value a factor of the model is linear in */
+static inline double fit_axis(const ec_create_sample &sample, int axis) {
+    switch (axis) {
+    case 0:
+        return sample.nb_data_blocks;
+    case 1:
+        return sample.nb_rdnc_blocks;
+    default:
+        return static_cast<double>(sample.block_size);
+    }
+}
+
+static inline double factor(const double coef[2], double x) {
+    return coef[0] + coef[1] * x;
+}
+
+/**
+ * Solve one factor with the other two fixed
+ * The model is then linear in the factor, weights make the error relative.
+ * With a single distinct value on the axis the slope is left at zero.
+ */
+static void solve_factor(const std::vector<ec_create_sample> &samples,
+                         double *coefs[3], int axis) {
+    double s00 = 0, s01 = 0, s11 = 0, r0 = 0, r1 = 0;
+    for (const ec_create_sample &sample : samples) {
+        double g = 1;
+        for (int other = 0; other < 3; other++) {
+            if (other != axis) {
+                g *= factor(coefs[other], fit_axis(sample, other));
+            }
+        }
+        const double x = fit_axis(sample, axis);
+        const double w = 1 / (sample.mean_us * sample.mean_us);
+        s00 += w * g * g;
+        s01 += w * g * g * x;
+        s11 += w * g * g * x * x;
+        r0 += w * g * sample.mean_us;
+        r1 += w * g * sample.mean_us * x;
+    }
+
+    double *coef = coefs[axis];
+    const double det = s00 * s11 - s01 * s01;
+    if (std::fabs(det) > 1e-12 * s00 * s11) {
+        coef[0] = (r0 * s11 - r1 * s01) / det;
+        coef[1] = (s00 * r1 - s01 * r0) / det;
+    } else if (s00 > 0) {
+        coef[0] = r0 / s00;
+        coef[1] = 0;
+    }
+}
+
+/* Scale b and c to 1 at the largest point, a absorbs the scale */
+static void normalize(ec_cost_fit *fit, double max_m, double max_s) {
+    const double b = factor(fit->b, max_m);
+    const double c = factor(fit->c, max_s);
+    if (b == 0 || c == 0) {
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        fit->b[i] /= b;
+        fit->c[i] /= c;
+        fit->a[i] *= b * c;
+    }
+}
+
+static double relative_sse(const std::vector<ec_create_sample> &samples,
+                           const ec_cost_fit &fit) {
+    double sse = 0;
+    for (const ec_create_sample &sample : samples) {
+        const double err = (ec_cost_fit_time_us(fit, sample.nb_data_blocks,
+                                                sample.nb_rdnc_blocks,
+                                                sample.block_size) -
+                            sample.mean_us) /
+                           sample.mean_us;
+        sse += err * err;
+    }
+    return sse;
+}
+
+doca_error_t ec_cost_fit_samples(const std::vector<ec_create_sample> &samples,
+                                 ec_cost_fit *fit) {
+    std::vector<ec_create_sample> points;
+    for (const ec_create_sample &sample : samples) {
+        if (sample.mean_us > 0) {
+            points.push_back(sample);
+        }
+    }
+    if (points.empty()) {
+        DOCA_LOG_ERR("No measurement to fit");
+        return DOCA_ERROR_INVALID_VALUE;
+    }
+
+    /* Start from the fit shipped with the library */
+    *fit = {.a = {2.55153425e-03, 2.82268116e-04},
+            .b = {6.82958278e-02, 2.08178676e-03},
+            .c = {-7.53855770e+03, 1.64268580e+00},
+            .nb_points = static_cast<uint32_t>(points.size()),
+            .nb_iterations = 0,
+            .rmse_us = 0,
+            .mean_rel_err = 0,
+            .max_rel_err = 0,
+            .r2 = 0};
+
+    double max_m = 0, max_s = 0;
+    for (const ec_create_sample &sample : points) {
+        max_m = std::max(max_m, fit_axis(sample, 1));
+        max_s = std::max(max_s, fit_axis(sample, 2));
+    }
+    normalize(fit, max_m, max_s);
+
+    double *coefs[3] = {fit->a, fit->b, fit->c};
+    double sse = relative_sse(points, *fit);
+    while (fit->nb_iterations < MAX_FIT_ITERATIONS) {
+        fit->nb_iterations++;
+        /* c first, the legacy intercept may not suit the device */
+        for (int axis : {2, 0, 1})
+            solve_factor(points, coefs, axis);
+        normalize(fit, max_m, max_s);
+
+        const double new_sse = relative_sse(points, *fit);
+        const bool has_converged =
+            std::fabs(sse - new_sse) <= FIT_TOLERANCE * std::max(sse, 1e-300);
+        sse = new_sse;
+        if (has_converged) {
+            break;
+        }
+    }
+
+    double sum_sq = 0, sum_rel = 0, sum_t = 0;
+    for (const ec_create_sample &sample : points) {
+        const double predicted =
+            ec_cost_fit_time_us(*fit, sample.nb_data_blocks,
+                                sample.nb_rdnc_blocks, sample.block_size);
+        const double err = predicted - sample.mean_us;
+        const double rel_err = std::fabs(err) / sample.mean_us;
+        sum_sq += err * err;
+        sum_rel += rel_err;
+        fit->max_rel_err = std::max(fit->max_rel_err, rel_err);
+        sum_t += sample.mean_us;
+    }
+    const double mean_t = sum_t / points.size();
+    double sum_tot = 0;
+    for (const ec_create_sample &sample : points)
+        sum_tot += (sample.mean_us - mean_t) * (sample.mean_us - mean_t);
+
+    fit->rmse_us = std::sqrt(sum_sq / points.size());
+    fit->mean_rel_err = sum_rel / points.size();
+    fit->r2 = sum_tot > 0 ? 1 - sum_sq / sum_tot : 1;
+
+    DOCA_LOG_INFO("Fitted %u points in %u iterations, mean error %.2f%%, "
+                  "max error %.2f%%",
+                  fit->nb_points, fit->nb_iterations, fit->mean_rel_err * 100,
+                  fit->max_rel_err * 100);
+    return DOCA_SUCCESS;
+}
+
+static const ec_cost_fit *find_fit(
+    const std::vector<std::pair<const char *, ec_cost_fit>> &fits,
+    const char *matrix_type) {
+    for (const auto &[name, fit] : fits) {
+        if (std::string(name) == matrix_type) {
+            return &fit;
+        }
+    }
+    return nullptr;
+}
+
+static doca_error_t open_output(const std::filesystem::path &path,
+                                std::ofstream *file) {
+    file->open(path, std::ios::trunc);
+    if (!*file) {
+        DOCA_LOG_ERR("Failed to open %s", path.c_str());
+        return DOCA_ERROR_IO_FAILED;
+    }
+    *file << std::setprecision(9);
+    return DOCA_SUCCESS;
+}
+
+static void write_csv(std::ofstream &file,
+                      const std::vector<ec_create_sample> &samples) {
+    file << "matrix_type,nb_data_blocks,nb_rdnc_blocks,block_size,"
+            "nb_repetitions,mean_us,stddev_us,min_us,max_us,cv\n";
+    for (const ec_create_sample &sample : samples) {
+        const double cv =
+            sample.mean_us > 0 ? sample.stddev_us / sample.mean_us : 0;
+        file << sample.matrix_type << ',' << sample.nb_data_blocks << ','
+             << sample.nb_rdnc_blocks << ',' << sample.block_size << ','
+             << sample.nb_repetitions << ',' << sample.mean_us << ','
+             << sample.stddev_us << ',' << sample.min_us << ','
+             << sample.max_us << ',' << cv << '\n';
+    }
+}
+
+static void write_json(std::ofstream &file,
+                       const std::vector<ec_create_sample> &samples) {
+    file << "[\n";
+    for (size_t i = 0; i < samples.size(); i++) {
+        const ec_create_sample &sample = samples[i];
+        file << "  {\"matrix_type\": \"" << sample.matrix_type
+             << "\", \"nb_data_blocks\": " << sample.nb_data_blocks
+             << ", \"nb_rdnc_blocks\": " << sample.nb_rdnc_blocks
+             << ", \"block_size\": " << sample.block_size
+             << ", \"nb_repetitions\": " << sample.nb_repetitions
+             << ", \"mean_us\": " << sample.mean_us
+             << ", \"stddev_us\": " << sample.stddev_us
+             << ", \"min_us\": " << sample.min_us
+             << ", \"max_us\": " << sample.max_us << '}'
+             << (i + 1 < samples.size() ? ",\n" : "\n");
+    }
+    file << "]\n";
+}
+
+static void write_fit_json(
+    std::ofstream &file,
+    const std::vector<std::pair<const char *, ec_cost_fit>> &fits) {
+    file << "{\n  \"model\": \"(a0 + a1 * k) * (b0 + b1 * m) * "
+            "(c0 + c1 * block_size)\",\n";
+    for (size_t i = 0; i < fits.size(); i++) {
+        const auto &[name, fit] = fits[i];
+        file << "  \"" << name << "\": {\"a\": [" << fit.a[0] << ", "
+             << fit.a[1] << "], \"b\": [" << fit.b[0] << ", " << fit.b[1]
+             << "], \"c\": [" << fit.c[0] << ", " << fit.c[1]
+             << "], \"nb_points\": " << fit.nb_points
+             << ", \"nb_iterations\": " << fit.nb_iterations
+             << ", \"rmse_us\": " << fit.rmse_us
+             << ", \"mean_rel_err\": " << fit.mean_rel_err
+             << ", \"max_rel_err\": " << fit.max_rel_err
+             << ", \"r2\": " << fit.r2 << '}'
+             << (i + 1 < fits.size() ? ",\n" : "\n");
+    }
+    file << "}\n";
+}
+
+/**
+ * is_fit selects the fitted times instead of the measured means
+ * Points without a positive time are left out and reported, the loader then
+ * refuses the table instead of pricing tasks from a made up time
+ */
+static void write_table(
+    std::ofstream &file, const char *name,
+    const std::vector<ec_create_sample> &samples,
+    const std::vector<std::pair<const char *, ec_cost_fit>> &fits,
+    bool is_fit) {
+    file << "# matrix_type nb_data_blocks nb_rdnc_blocks block_size "
+            "time_us\n";
+    uint32_t nb_skipped = 0;
+    for (const ec_create_sample &sample : samples) {
+        double time_us = sample.mean_us;
+        if (is_fit) {
+            const ec_cost_fit *fit = find_fit(fits, sample.matrix_type);
+            if (fit == nullptr) {
+                continue;
+            }
+            time_us = ec_cost_fit_time_us(*fit, sample.nb_data_blocks,
+                                          sample.nb_rdnc_blocks,
+                                          sample.block_size);
+        }
+        if (time_us <= 0) {
+            DOCA_LOG_WARN("%s: skip %s, k = %u, m = %u, block size = %lu, "
+                          "its time is %fus",
+                          name, sample.matrix_type, sample.nb_data_blocks,
+                          sample.nb_rdnc_blocks, sample.block_size, time_us);
+            nb_skipped++;
+            continue;
+        }
+        file << sample.matrix_type << ' ' << sample.nb_data_blocks << ' '
+             << sample.nb_rdnc_blocks << ' ' << sample.block_size << ' '
+             << time_us << '\n';
+    }
+    if (nb_skipped > 0) {
+        DOCA_LOG_ERR("%s lacks %u points without a positive time, the cost "
+                     "model will not load it",
+                     name, nb_skipped);
+    }
+}
+
+doca_error_t ec_create_write_results(
+    const std::string &out_dir, const std::vector<ec_create_sample> &samples,
+    const std::vector<std::pair<const char *, ec_cost_fit>> &fits) {
+    namespace fs = std::filesystem;
+    doca_error_t status;
+
+    std::error_code err;
+    fs::create_directories(out_dir, err);
+    if (err) {
+        DOCA_LOG_ERR("Failed to create %s: %s", out_dir.c_str(),
+                     err.message().c_str());
+        return DOCA_ERROR_IO_FAILED;
+    }
+    const fs::path dir(out_dir);
+
+    std::ofstream csv, json, table, fit_table, fit_json;
+    status = open_output(dir / "ec_create.csv", &csv);
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
+    write_csv(csv, samples);
+
+    status = open_output(dir / "ec_create.json", &json);
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
+    write_json(json, samples);
+
+    status = open_output(dir / "ec_cost_model.txt", &table);
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
+    write_table(table, "ec_cost_model.txt", samples, fits, false);
+
+    status = open_output(dir / "ec_cost_model_fit.txt", &fit_table);
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
+    write_table(fit_table, "ec_cost_model_fit.txt", samples, fits, true);
+
+    status = open_output(dir / "ec_cost_fit.json", &fit_json);
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
+    write_fit_json(fit_json, fits);
+
+    for (std::ofstream *file : {&csv, &json, &table, &fit_table, &fit_json}) {
+        file->flush();
+        if (!*file) {
+            DOCA_LOG_ERR("Failed to write results into %s", out_dir.c_str());
+            return DOCA_ERROR_IO_FAILED;
+        }
+    }
+    return DOCA_SUCCESS;
+}
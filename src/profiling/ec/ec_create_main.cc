@@ -2,8 +2,11 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <utility>
 #include <vector>
 
+#include <doca_argp.h>
 #include <doca_error.h>
 #include <doca_log.h>
 
@@ -17,32 +20,260 @@ constexpr size_t block_size_arr[] = {1024,   2048,   4096,   8192,
                                      16384,  32768,  65536,  131072,
                                      262144, 524288, 1048576};
 
-static doca_error_t profile() {
+constexpr uint32_t MAX_OUT_DIR_LEN = 4096;
+
+struct profile_config {
+    char out_dir[MAX_OUT_DIR_LEN];
+    uint32_t nb_tasks;
+    uint32_t nb_repetitions;
+    uint32_t nb_warmups;
+    /* Sweep vandermonde matrices after the cauchy ones */
+    bool has_vandermonde;
+    /* Then recover and update tasks of cauchy matrices */
+    bool has_recover;
+    bool has_update;
+};
+
+static doca_error_t register_param(const char *short_name,
+                                   const char *long_name,
+                                   const char *description,
+                                   doca_argp_param_cb_t callback,
+                                   doca_argp_type type) {
+    doca_error_t result;
+    doca_argp_param *param;
+    result = doca_argp_param_create(&param);
+    if (result != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create argp param: %s",
+                     doca_error_get_descr(result));
+        return result;
+    }
+    doca_argp_param_set_short_name(param, short_name);
+    doca_argp_param_set_long_name(param, long_name);
+    doca_argp_param_set_description(param, description);
+    doca_argp_param_set_callback(param, callback);
+    doca_argp_param_set_type(param, type);
+    result = doca_argp_register_param(param);
+    if (result != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register argp param: %s",
+                     doca_error_get_descr(result));
+    }
+
+    return result;
+}
+
+static doca_error_t register_profile_params() {
     doca_error_t status;
-    for (uint32_t i = 0; i < sizeof(nb_data_blocks_arr) / sizeof(uint32_t);
-         i++) {
-        for (uint32_t j = 0; j < sizeof(nb_rdnc_blocks_arr) / sizeof(uint32_t);
-             j++) {
-            for (uint32_t k = 0; k < sizeof(block_size_arr) / sizeof(size_t);
-                 k++) {
-                uint32_t nb_data_blocks = nb_data_blocks_arr[i];
-                uint32_t nb_rdnc_blocks = nb_rdnc_blocks_arr[j];
-                size_t block_size = block_size_arr[k];
-                ec_create_config cfg = {.nb_data_blocks = nb_data_blocks,
-                                        .nb_rdnc_blocks = nb_rdnc_blocks,
-                                        .block_size = block_size,
-                                        .nb_tasks = 32};
-                status = ec_create(cfg);
+    status = register_param(
+        "o", "out_dir", "directory of the results and the calibration table",
+        [](void *param, void *config) -> doca_error_t {
+            profile_config *cfg = static_cast<profile_config *>(config);
+            const char *out_dir = static_cast<const char *>(param);
+            if (strnlen(out_dir, MAX_OUT_DIR_LEN) == MAX_OUT_DIR_LEN) {
+                DOCA_LOG_ERR("Output directory is too long");
+                return DOCA_ERROR_INVALID_VALUE;
+            }
+            strcpy(cfg->out_dir, out_dir);
+            return DOCA_SUCCESS;
+        },
+        DOCA_ARGP_TYPE_STRING);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register out_dir param: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = register_param(
+        "nt", "nb_tasks", "number of tasks submitted at once",
+        [](void *param, void *config) -> doca_error_t {
+            profile_config *cfg = static_cast<profile_config *>(config);
+            int nb_tasks = *static_cast<int *>(param);
+            if (nb_tasks <= 0 ||
+                static_cast<uint32_t>(nb_tasks) > MAX_NB_EC_TASKS) {
+                DOCA_LOG_ERR("nb_tasks must be in [1, %u]", MAX_NB_EC_TASKS);
+                return DOCA_ERROR_INVALID_VALUE;
+            }
+            cfg->nb_tasks = nb_tasks;
+            return DOCA_SUCCESS;
+        },
+        DOCA_ARGP_TYPE_INT);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register nt param: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = register_param(
+        "r", "nb_repetitions", "timed rounds of every configuration",
+        [](void *param, void *config) -> doca_error_t {
+            profile_config *cfg = static_cast<profile_config *>(config);
+            int nb_repetitions = *static_cast<int *>(param);
+            if (nb_repetitions <= 0) {
+                DOCA_LOG_ERR("nb_repetitions must be positive");
+                return DOCA_ERROR_INVALID_VALUE;
+            }
+            cfg->nb_repetitions = nb_repetitions;
+            return DOCA_SUCCESS;
+        },
+        DOCA_ARGP_TYPE_INT);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register r param: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = register_param(
+        "w", "nb_warmups", "untimed rounds before the timed ones",
+        [](void *param, void *config) -> doca_error_t {
+            profile_config *cfg = static_cast<profile_config *>(config);
+            int nb_warmups = *static_cast<int *>(param);
+            if (nb_warmups < 0) {
+                DOCA_LOG_ERR("nb_warmups must not be negative");
+                return DOCA_ERROR_INVALID_VALUE;
+            }
+            cfg->nb_warmups = nb_warmups;
+            return DOCA_SUCCESS;
+        },
+        DOCA_ARGP_TYPE_INT);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register w param: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = register_param(
+        "vm", "vandermonde", "also profile vandermonde matrices",
+        [](void *param, void *config) -> doca_error_t {
+            profile_config *cfg = static_cast<profile_config *>(config);
+            cfg->has_vandermonde = *static_cast<bool *>(param);
+            return DOCA_SUCCESS;
+        },
+        DOCA_ARGP_TYPE_BOOLEAN);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register vm param: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = register_param(
+        "rc", "recover", "also profile recover tasks",
+        [](void *param, void *config) -> doca_error_t {
+            profile_config *cfg = static_cast<profile_config *>(config);
+            cfg->has_recover = *static_cast<bool *>(param);
+            return DOCA_SUCCESS;
+        },
+        DOCA_ARGP_TYPE_BOOLEAN);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register rc param: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = register_param(
+        "up", "update", "also profile update tasks",
+        [](void *param, void *config) -> doca_error_t {
+            profile_config *cfg = static_cast<profile_config *>(config);
+            cfg->has_update = *static_cast<bool *>(param);
+            return DOCA_SUCCESS;
+        },
+        DOCA_ARGP_TYPE_BOOLEAN);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register up param: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    return DOCA_SUCCESS;
+}
+
+/* Sweep every configuration of one matrix type */
+static doca_error_t sweep(const profile_config &pcfg,
+                          doca_ec_matrix_type matrix_type,
+                          ec_task_kind task_kind,
+                          const char *matrix_name,
+                          std::vector<ec_create_sample> *samples) {
+    doca_error_t status;
+    std::vector<double> times_us;
+
+    for (uint32_t nb_data_blocks : nb_data_blocks_arr) {
+        for (uint32_t nb_rdnc_blocks : nb_rdnc_blocks_arr) {
+            for (size_t block_size : block_size_arr) {
+                ec_create_config cfg = {
+                    .matrix_type = matrix_type,
+                    .nb_data_blocks = nb_data_blocks,
+                    .nb_rdnc_blocks = nb_rdnc_blocks,
+                    .block_size = block_size,
+                    .nb_tasks = pcfg.nb_tasks,
+                    .nb_repetitions = pcfg.nb_repetitions,
+                    .nb_warmups = pcfg.nb_warmups,
+                    .task_kind = task_kind};
+                status = ec_create(cfg, &times_us);
                 if (status != DOCA_SUCCESS) {
-                    DOCA_LOG_ERR("EC create failed when ");
+                    DOCA_LOG_ERR("EC %s failed when k = %u, m = %u, "
+                                 "block size = %lu",
+                                 matrix_name, nb_data_blocks, nb_rdnc_blocks,
+                                 block_size);
                     return status;
                 }
+                samples->push_back(
+                    ec_create_summarize(cfg, matrix_name, times_us));
             }
         }
     }
     return DOCA_SUCCESS;
 }
 
+static doca_error_t profile(const profile_config &pcfg) {
+    doca_error_t status;
+    std::vector<ec_create_sample> samples;
+    std::vector<std::pair<const char *, ec_cost_fit>> fits;
+
+    struct profiled_type {
+        doca_ec_matrix_type matrix_type;
+        ec_task_kind task_kind;
+        /* As the calibration table names it */
+        const char *name;
+    };
+    std::vector<profiled_type> types = {
+        {DOCA_EC_MATRIX_TYPE_CAUCHY, EC_TASK_CREATE, "cauchy"}};
+    if (pcfg.has_vandermonde) {
+        types.push_back(
+            {DOCA_EC_MATRIX_TYPE_VANDERMONDE, EC_TASK_CREATE, "vandermonde"});
+    }
+    if (pcfg.has_recover) {
+        types.push_back(
+            {DOCA_EC_MATRIX_TYPE_CAUCHY, EC_TASK_RECOVER, "recover"});
+    }
+    /* k is the number of changed blocks in the update rows of the table */
+    if (pcfg.has_update) {
+        types.push_back({DOCA_EC_MATRIX_TYPE_CAUCHY, EC_TASK_UPDATE, "update"});
+    }
+
+    for (const auto &[matrix_type, task_kind, matrix_name] : types) {
+        std::vector<ec_create_sample> type_samples;
+        status =
+            sweep(pcfg, matrix_type, task_kind, matrix_name, &type_samples);
+        if (status != DOCA_SUCCESS) {
+            return status;
+        }
+
+        ec_cost_fit fit;
+        status = ec_cost_fit_samples(type_samples, &fit);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to fit %s", matrix_name);
+            return status;
+        }
+        DOCA_LOG_INFO("%s: time_us = (%g + %g * k) * (%g + %g * m) * "
+                      "(%g + %g * s), r2 = %f",
+                      matrix_name, fit.a[0], fit.a[1], fit.b[0], fit.b[1],
+                      fit.c[0], fit.c[1], fit.r2);
+        fits.push_back({matrix_name, fit});
+        samples.insert(samples.end(), type_samples.begin(),
+                       type_samples.end());
+    }
+
+    return ec_create_write_results(pcfg.out_dir, samples, fits);
+}
+
 int main(int argc, char **argv) {
     doca_error_t status;
 
@@ -69,11 +300,44 @@ int main(int argc, char **argv) {
         return EXIT_FAILURE;
     }
 
-    status = profile();
+    /* Setup argp */
+    profile_config cfg = {.out_dir = "./out",
+                          .nb_tasks = 32,
+                          .nb_repetitions = 5,
+                          .nb_warmups = 1,
+                          .has_vandermonde = false,
+                          .has_recover = false,
+                          .has_update = false};
+
+    status = doca_argp_init("ec_create_doca", &cfg);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to init argp: %s", doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = register_profile_params();
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register profile params");
+        doca_argp_destroy();
+        return EXIT_FAILURE;
+    }
+
+    status = doca_argp_start(argc, argv);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to parse parameters: %s",
+                     doca_error_get_descr(status));
+        doca_argp_destroy();
+        return EXIT_FAILURE;
+    }
+
+    /* Export <out_dir>/ec_cost_model.txt through ASTRAEA_COST_MODEL */
+    status = profile(cfg);
     if (status != DOCA_SUCCESS) {
         DOCA_LOG_ERR("Profiling failed");
+        doca_argp_destroy();
         return EXIT_FAILURE;
     }
 
+    doca_argp_destroy();
     return EXIT_SUCCESS;
 }
\ No newline at end of file
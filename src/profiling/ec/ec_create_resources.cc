@@ -26,8 +26,8 @@ ec_create_resources::ec_create_resources() {}
 
 ec_create_resources::~ec_create_resources() {
     /* Free tasks */
-    for (doca_ec_task_create *task : tasks)
-        doca_task_free(doca_ec_task_create_as_task(task));
+    for (doca_task *task : tasks)
+        doca_task_free(task);
 
     /* Destroy bufs, inventory and mmap */
     for (doca_buf *dst_buf : dst_bufs)
@@ -54,6 +54,8 @@ ec_create_resources::~ec_create_resources() {
             status = doca_ctx_stop(ctx);
         }
     }
+    if (derived_matrix)
+        doca_ec_matrix_destroy(derived_matrix);
     if (matrix)
         doca_ec_matrix_destroy(matrix);
     if (ec)
@@ -83,7 +85,7 @@ doca_error_t ec_create_resources::prepare_memory(const ec_create_config &cfg) {
         return status;
     }
 
-    size_t data_buf_size = cfg.nb_data_blocks * cfg.block_size;
+    size_t data_buf_size = ec_create_nb_src_blocks(cfg) * cfg.block_size;
     size_t rdnc_buf_size = cfg.nb_rdnc_blocks * cfg.block_size;
     size_t mmap_size = data_buf_size + rdnc_buf_size * cfg.nb_tasks;
 
@@ -162,7 +164,11 @@ doca_error_t ec_create_resources::prepare_memory(const ec_create_config &cfg) {
 
 doca_error_t ec_create_resources::setup_ec_ctx(
     doca_ec_task_create_completion_cb_t success_cb,
-    doca_ec_task_create_completion_cb_t error_cb) {
+    doca_ec_task_create_completion_cb_t error_cb,
+    doca_ec_task_recover_completion_cb_t recover_success_cb,
+    doca_ec_task_recover_completion_cb_t recover_error_cb,
+    doca_ec_task_update_completion_cb_t update_success_cb,
+    doca_ec_task_update_completion_cb_t update_error_cb) {
     doca_error_t status;
     status = doca_ec_create(dev, &ec);
     if (status != DOCA_SUCCESS) {
@@ -178,6 +184,22 @@ doca_error_t ec_create_resources::setup_ec_ctx(
         return status;
     }
 
+    status = doca_ec_task_recover_set_conf(ec, recover_success_cb,
+                                           recover_error_cb, MAX_NB_EC_TASKS);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set ec recover task conf: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_ec_task_update_set_conf(ec, update_success_cb,
+                                          update_error_cb, MAX_NB_EC_TASKS);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set ec update task conf: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
     ctx = doca_ec_as_ctx(ec);
     if (!ctx) {
         DOCA_LOG_ERR("Failed to convert ec to ctx");
@@ -0,0 +1,255 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <doca_error.h>
+#include <doca_log.h>
+
+#include "astraea_gf.h"
+
+DOCA_LOG_REGISTER(GF : MAIN);
+
+/**
+ * Throughput of the software erasure coding kernels, in GB/s of data
+ * blocks encoded
+ * Given the ec_create.csv the ec_create_doca profiler writes, every cauchy
+ * and vandermonde point of it is measured and printed next to the device's
+ * number, otherwise a default grid of cauchy points is measured.
+ * Every kernel must write the same parity as the scalar one.
+ */
+
+constexpr uint32_t nb_data_blocks_arr[] = {4, 8, 16, 32, 64, 128};
+constexpr uint32_t nb_rdnc_blocks_arr[] = {1, 2, 4, 8, 16, 32};
+constexpr size_t block_size_arr[] = {4096, 65536, 1048576};
+/* Repeat a point until it ran this long, at least MIN_NB_REPEATS times */
+constexpr uint64_t MIN_MEASURE_NS = 20 * 1000 * 1000;
+constexpr uint32_t MIN_NB_REPEATS = 3;
+/* Points whose blocks do not fit are skipped */
+constexpr size_t MAX_BUFFER_SIZE = 256 * 1024 * 1024;
+
+struct gf_point {
+    std::string matrix_type;
+    uint32_t nb_data_blocks;
+    uint32_t nb_rdnc_blocks;
+    size_t block_size;
+    /* Mean task time of the device, 0 when there is no profile */
+    double doca_mean_us;
+};
+
+/* Keep the cauchy and vandermonde rows of an ec_create.csv */
+static doca_error_t load_profile(const char *path,
+                                 std::vector<gf_point> *points) {
+    std::ifstream file(path);
+    if (!file) {
+        DOCA_LOG_ERR("Failed to open %s", path);
+        return DOCA_ERROR_IO_FAILED;
+    }
+
+    std::string line;
+    std::getline(file, line);
+    while (std::getline(file, line)) {
+        std::vector<std::string> fields;
+        std::stringstream stream(line);
+        std::string field;
+        while (std::getline(stream, field, ',')) {
+            fields.push_back(field);
+        }
+        if (fields.size() < 6) {
+            DOCA_LOG_ERR("Malformed line in %s: %s", path, line.c_str());
+            return DOCA_ERROR_INVALID_VALUE;
+        }
+        if (fields[0] != "cauchy" && fields[0] != "vandermonde") {
+            continue;
+        }
+        points->push_back(
+            {.matrix_type = fields[0],
+             .nb_data_blocks = static_cast<uint32_t>(std::stoul(fields[1])),
+             .nb_rdnc_blocks = static_cast<uint32_t>(std::stoul(fields[2])),
+             .block_size = std::stoul(fields[3]),
+             .doca_mean_us = std::stod(fields[5])});
+    }
+    return DOCA_SUCCESS;
+}
+
+static void default_points(std::vector<gf_point> *points) {
+    for (uint32_t nb_data_blocks : nb_data_blocks_arr) {
+        for (uint32_t nb_rdnc_blocks : nb_rdnc_blocks_arr) {
+            for (size_t block_size : block_size_arr) {
+                points->push_back({.matrix_type = "cauchy",
+                                   .nb_data_blocks = nb_data_blocks,
+                                   .nb_rdnc_blocks = nb_rdnc_blocks,
+                                   .block_size = block_size,
+                                   .doca_mean_us = 0});
+            }
+        }
+    }
+}
+
+/* GB/s of data blocks, the first run is compared with the reference */
+static double measure(astraea_gf_kernel kernel, const gf_point &point,
+                      const uint8_t *tables, const uint8_t *const *src,
+                      uint8_t *const *dst, const uint8_t *reference,
+                      bool *is_identical) {
+    astraea_gf_encode(kernel, point.block_size, point.nb_data_blocks,
+                      point.nb_rdnc_blocks, tables, src, dst);
+    *is_identical = true;
+    for (uint32_t i = 0; reference && i < point.nb_rdnc_blocks; i++) {
+        if (memcmp(dst[i], reference + i * point.block_size,
+                   point.block_size)) {
+            *is_identical = false;
+        }
+    }
+
+    uint32_t nb_repeats = 0;
+    uint64_t elapsed_ns = 0;
+    auto begin_time = std::chrono::high_resolution_clock::now();
+    while (nb_repeats < MIN_NB_REPEATS || elapsed_ns < MIN_MEASURE_NS) {
+        astraea_gf_encode(kernel, point.block_size, point.nb_data_blocks,
+                          point.nb_rdnc_blocks, tables, src, dst);
+        nb_repeats++;
+        elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::high_resolution_clock::now() -
+                         begin_time)
+                         .count();
+    }
+    return static_cast<double>(point.nb_data_blocks) * point.block_size *
+           nb_repeats / elapsed_ns;
+}
+
+static doca_error_t profile(const std::vector<gf_point> &points) {
+    std::vector<astraea_gf_kernel> kernels;
+    for (int kernel = 0; kernel < ASTRAEA_GF_NB_KERNELS; kernel++) {
+        if (astraea_gf_kernel_is_supported(
+                static_cast<astraea_gf_kernel>(kernel))) {
+            kernels.push_back(static_cast<astraea_gf_kernel>(kernel));
+        }
+    }
+
+    for (const gf_point &point : points) {
+        const uint32_t k = point.nb_data_blocks;
+        const uint32_t m = point.nb_rdnc_blocks;
+        const size_t buffer_size = (k + 2 * m) * point.block_size;
+        if (k == 0 || m == 0 || point.block_size == 0 ||
+            buffer_size > MAX_BUFFER_SIZE) {
+            DOCA_LOG_WARN("Skip (%u, %u, %lu)", k, m, point.block_size);
+            continue;
+        }
+
+        std::vector<uint8_t> coefs(k * m);
+        if (point.matrix_type == "cauchy") {
+            astraea_gf_gen_cauchy(k, m, coefs.data());
+        } else {
+            astraea_gf_gen_vandermonde(k, m, coefs.data());
+        }
+        std::vector<uint8_t> tables(coefs.size() * GF_TABLE_SIZE);
+        astraea_gf_init_tables(coefs.data(), m, k, tables.data());
+
+        /* Data, then the parity under test, then the scalar parity */
+        uint8_t *buffer;
+        if (posix_memalign((void **)&buffer, 64, buffer_size)) {
+            DOCA_LOG_ERR("Failed to alloc memory");
+            return DOCA_ERROR_NO_MEMORY;
+        }
+        for (size_t i = 0; i < k * point.block_size; i++) {
+            buffer[i] = rand();
+        }
+        std::vector<const uint8_t *> src(k);
+        std::vector<uint8_t *> dst(m);
+        std::vector<uint8_t *> reference_dst(m);
+        for (uint32_t j = 0; j < k; j++) {
+            src[j] = buffer + j * point.block_size;
+        }
+        uint8_t *reference = buffer + (k + m) * point.block_size;
+        for (uint32_t i = 0; i < m; i++) {
+            dst[i] = buffer + (k + i) * point.block_size;
+            reference_dst[i] = reference + i * point.block_size;
+        }
+        astraea_gf_encode(ASTRAEA_GF_KERNEL_SCALAR, point.block_size, k, m,
+                          tables.data(), src.data(), reference_dst.data());
+
+        std::string result;
+        char field[64];
+        if (point.doca_mean_us > 0) {
+            snprintf(field, sizeof(field), "doca = %.3fGB/s",
+                     k * point.block_size / point.doca_mean_us / 1000);
+            result += field;
+        }
+        bool is_identical = true;
+        for (astraea_gf_kernel kernel : kernels) {
+            bool is_kernel_identical;
+            const double throughput =
+                measure(kernel, point, tables.data(), src.data(), dst.data(),
+                        reference, &is_kernel_identical);
+            is_identical = is_identical && is_kernel_identical;
+            snprintf(field, sizeof(field), "%s%s = %.3fGB/s",
+                     result.empty() ? "" : ", ", GF_KERNEL_NAMES[kernel],
+                     throughput);
+            result += field;
+        }
+        free(buffer);
+
+        if (!is_identical) {
+            DOCA_LOG_ERR("%s (%u, %u, %lu): kernels disagree on parity",
+                         point.matrix_type.c_str(), k, m, point.block_size);
+            return DOCA_ERROR_UNEXPECTED;
+        }
+        DOCA_LOG_INFO("%s, nb_data_blocks = %u, nb_rdnc_blocks = %u, "
+                      "block_size = %lu, %s",
+                      point.matrix_type.c_str(), k, m, point.block_size,
+                      result.c_str());
+    }
+    return DOCA_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    doca_error_t status;
+
+    /* Setup SDK logger */
+    doca_log_backend *sdk_log;
+    status = doca_log_backend_create_standard();
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to create log standard backend: %s\n",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = doca_log_backend_create_with_file_sdk(stderr, &sdk_log);
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to create log backend with file sdk: %s\n",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = doca_log_backend_set_sdk_level(sdk_log, DOCA_LOG_LEVEL_WARNING);
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to set log backend level: %s",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    /* Compare with the device when given the profiler's ec_create.csv */
+    std::vector<gf_point> points;
+    if (argc > 1) {
+        status = load_profile(argv[1], &points);
+        if (status != DOCA_SUCCESS) {
+            return EXIT_FAILURE;
+        }
+    } else {
+        default_points(&points);
+    }
+
+    status = profile(points);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Profiling failed");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
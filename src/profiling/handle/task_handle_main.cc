@@ -0,0 +1,404 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <vector>
+
+#include <doca_buf.h>
+#include <doca_buf_inventory.h>
+#include <doca_error.h>
+#include <doca_log.h>
+#include <doca_mmap.h>
+
+#include "astraea_ctx.h"
+#include "astraea_ec.h"
+#include "astraea_pe.h"
+#include "resource_mgmt.h"
+
+DOCA_LOG_REGISTER(TASK_HANDLE : MAIN);
+
+/**
+ * Long run cost of handing tasks to astraea_task_submit
+ * NB_INFLIGHT small tasks are kept in flight on a software ec for the given
+ * seconds, 60 by default. Every second it prints the resident set, the
+ * mean and p99 time of taking a handle and submitting it, and what the ec
+ * still has outstanding
+ * 1. heap: every task is wrapped in a handle of its own and never freed,
+ *    what astraea_ec_task_create_as_task used to do
+ * 2. embedded: the handle inside the task is submitted
+ * Run it after astraea_scheduler
+ */
+
+constexpr uint32_t NB_DATA_BLOCKS = 4;
+constexpr uint32_t NB_RDNC_BLOCKS = 2;
+constexpr size_t BLOCK_SIZE = 4096;
+constexpr uint32_t NB_INFLIGHT = 64;
+constexpr uint32_t LATENCY_SLA_US = 1000;
+constexpr uint64_t DEFAULT_DURATION_S = 60;
+/* Submissions timed per report, more are counted but not timed */
+constexpr size_t MAX_NB_SAMPLES = 1024 * 1024;
+
+struct handle_bench;
+
+struct handle_slot {
+    handle_bench *bench;
+    uint32_t id;
+};
+
+struct handle_bench {
+    astraea_pe *pe = nullptr;
+    astraea_ec *ec = nullptr;
+    astraea_ctx *ctx = nullptr;
+    astraea_ec_matrix *matrix = nullptr;
+    doca_mmap *mmap = nullptr;
+    uint8_t *buffer = nullptr;
+    doca_buf_inventory *buf_inventory = nullptr;
+    doca_buf *src_buf = nullptr;
+    std::vector<doca_buf *> dst_bufs;
+
+    handle_slot slots[NB_INFLIGHT];
+    /* Slots whose task completed, filled by the completion callbacks */
+    std::vector<uint32_t> idle_slots;
+    uint64_t nb_failed = 0;
+
+    ~handle_bench() {
+        if (ctx) {
+            doca_error_t status = astraea_ctx_stop(ctx);
+            while (status == DOCA_ERROR_IN_PROGRESS) {
+                (void)astraea_pe_progress(pe);
+                status = astraea_ctx_stop(ctx);
+            }
+        }
+        if (matrix)
+            astraea_ec_matrix_destroy(matrix);
+        if (ec)
+            astraea_ec_destroy(ec);
+        for (doca_buf *buf : dst_bufs)
+            doca_buf_dec_refcount(buf, nullptr);
+        if (src_buf)
+            doca_buf_dec_refcount(src_buf, nullptr);
+        if (buf_inventory)
+            doca_buf_inventory_destroy(buf_inventory);
+        if (mmap)
+            doca_mmap_destroy(mmap);
+        free(buffer);
+        if (pe)
+            astraea_pe_destroy(pe);
+    }
+};
+
+static void task_success_cb(astraea_ec_task_create *task,
+                            doca_data task_user_data,
+                            doca_data ctx_user_data) {
+    (void)task;
+    (void)ctx_user_data;
+    handle_slot *slot = static_cast<handle_slot *>(task_user_data.ptr);
+    slot->bench->idle_slots.push_back(slot->id);
+}
+
+static void task_error_cb(astraea_ec_task_create *task,
+                          doca_data task_user_data, doca_data ctx_user_data) {
+    (void)task;
+    (void)ctx_user_data;
+    handle_slot *slot = static_cast<handle_slot *>(task_user_data.ptr);
+    slot->bench->nb_failed++;
+    slot->bench->idle_slots.push_back(slot->id);
+}
+
+static doca_error_t prepare_memory(handle_bench *bench) {
+    const size_t data_size = NB_DATA_BLOCKS * BLOCK_SIZE;
+    const size_t rdnc_size = NB_RDNC_BLOCKS * BLOCK_SIZE;
+    const size_t buffer_size = data_size + rdnc_size * NB_INFLIGHT;
+
+    if (posix_memalign((void **)&bench->buffer, 64, buffer_size)) {
+        DOCA_LOG_ERR("Failed to alloc memory");
+        return DOCA_ERROR_NO_MEMORY;
+    }
+    for (size_t i = 0; i < data_size; i++) {
+        bench->buffer[i] = rand();
+    }
+
+    /* Software ecs only read the memory from the CPU */
+    doca_error_t status = doca_mmap_create(&bench->mmap);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create mmap: %s", doca_error_get_descr(status));
+        return status;
+    }
+    status = doca_mmap_set_memrange(bench->mmap, bench->buffer, buffer_size);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set memrange: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+    status = doca_mmap_start(bench->mmap);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start mmap: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_buf_inventory_create(1 + NB_INFLIGHT, &bench->buf_inventory);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create buf inventory: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+    status = doca_buf_inventory_start(bench->buf_inventory);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start buf inventory: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_buf_inventory_buf_get_by_data(bench->buf_inventory,
+                                                bench->mmap, bench->buffer,
+                                                data_size, &bench->src_buf);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to alloc buf for data blocks: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+    for (uint32_t i = 0; i < NB_INFLIGHT; i++) {
+        doca_buf *dst_buf;
+        status = doca_buf_inventory_buf_get_by_addr(
+            bench->buf_inventory, bench->mmap,
+            bench->buffer + data_size + i * rdnc_size, rdnc_size, &dst_buf);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to alloc buf for rdnc blocks: %s",
+                         doca_error_get_descr(status));
+            return status;
+        }
+        bench->dst_bufs.push_back(dst_buf);
+    }
+    return DOCA_SUCCESS;
+}
+
+/* The submitter runs inline so submissions are timed on one thread */
+static doca_error_t setup(handle_bench *bench) {
+    doca_error_t status = astraea_pe_create(&bench->pe);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create pe: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = astraea_ec_create_software(&bench->ec);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create ec: %s", doca_error_get_descr(status));
+        return status;
+    }
+    status = astraea_ec_task_create_set_conf(bench->ec, task_success_cb,
+                                             task_error_cb, NB_INFLIGHT);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set ec create task conf: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    bench->ctx = astraea_ec_as_ctx(bench->ec);
+    if (bench->ctx == nullptr) {
+        DOCA_LOG_ERR("Failed to convert ec to ctx");
+        return DOCA_ERROR_UNEXPECTED;
+    }
+    status = astraea_ctx_set_inline_submit(bench->ctx, true);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set submit mode: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+    status = astraea_pe_connect_ctx(bench->pe, bench->ctx);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to connect pe to ctx: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+    status = astraea_ctx_start(bench->ctx);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start ctx: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = astraea_ec_matrix_create(bench->ec, ASTRAEA_EC_MATRIX_TYPE_CAUCHY,
+                                      NB_DATA_BLOCKS, NB_RDNC_BLOCKS,
+                                      &bench->matrix);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create ec matrix: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = prepare_memory(bench);
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
+    for (uint32_t i = 0; i < NB_INFLIGHT; i++) {
+        bench->slots[i] = {.bench = bench, .id = i};
+    }
+    return DOCA_SUCCESS;
+}
+
+static uint64_t rss_kb() {
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (file == nullptr) {
+        return 0;
+    }
+    uint64_t nb_pages = 0, nb_resident_pages = 0;
+    if (fscanf(file, "%lu %lu", &nb_pages, &nb_resident_pages) != 2) {
+        nb_resident_pages = 0;
+    }
+    fclose(file);
+    return nb_resident_pages * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+static void report(handle_bench *bench, const char *mode, uint64_t second,
+                   uint64_t nb_tasks, std::vector<uint32_t> *samples) {
+    double mean_ns = 0;
+    uint32_t p99_ns = 0;
+    if (!samples->empty()) {
+        for (uint32_t sample : *samples) {
+            mean_ns += sample;
+        }
+        mean_ns /= samples->size();
+        auto p99 = samples->begin() + samples->size() * 99 / 100;
+        std::nth_element(samples->begin(), p99, samples->end());
+        p99_ns = *p99;
+    }
+    astraea_ec_resource_stats resource_stats;
+    astraea_ec_get_resource_stats(bench->ec, &resource_stats);
+    DOCA_LOG_INFO("%s, %lus, %lu tasks, rss = %luKB, submit mean = %.1fns, "
+                  "p99 = %uns, %u tasks outstanding, %u bufs free",
+                  mode, second, nb_tasks, rss_kb(), mean_ns, p99_ns,
+                  resource_stats.nb_tasks, resource_stats.nb_free_bufs);
+    samples->clear();
+}
+
+static doca_error_t run(handle_bench *bench, bool is_heap,
+                        uint64_t duration_s) {
+    const char *mode = is_heap ? "heap" : "embedded";
+    std::vector<uint32_t> samples;
+    samples.reserve(MAX_NB_SAMPLES);
+
+    bench->idle_slots.clear();
+    for (uint32_t i = 0; i < NB_INFLIGHT; i++) {
+        bench->idle_slots.push_back(i);
+    }
+    std::vector<uint32_t> ready_slots;
+    ready_slots.reserve(NB_INFLIGHT);
+
+    uint64_t nb_tasks = 0;
+    uint64_t second = 0;
+    const auto begin_time = std::chrono::steady_clock::now();
+    auto report_time = begin_time + std::chrono::seconds(1);
+    while (second < duration_s) {
+        ready_slots.swap(bench->idle_slots);
+        for (uint32_t slot_id : ready_slots) {
+            /* The slot's parity buf is written again from its start */
+            doca_buf_reset_data_len(bench->dst_bufs[slot_id]);
+
+            astraea_ec_task_create *task;
+            doca_error_t status = astraea_ec_task_create_allocate_init(
+                bench->ec, bench->matrix, bench->mmap, bench->src_buf,
+                bench->mmap, bench->dst_bufs[slot_id],
+                {.ptr = &bench->slots[slot_id]}, &task);
+            if (status != DOCA_SUCCESS) {
+                DOCA_LOG_ERR("Failed to allocate and init ec task: %s",
+                             doca_error_get_descr(status));
+                return status;
+            }
+
+            const auto submit_begin = std::chrono::steady_clock::now();
+            astraea_task *handle = astraea_ec_task_create_as_task(task);
+            if (is_heap) {
+                handle = new astraea_task(*handle);
+            }
+            status = astraea_task_submit(handle);
+            const auto submit_end = std::chrono::steady_clock::now();
+            if (status != DOCA_SUCCESS) {
+                DOCA_LOG_ERR("Failed to submit task: %s",
+                             doca_error_get_descr(status));
+                return status;
+            }
+
+            if (samples.size() < MAX_NB_SAMPLES) {
+                samples.push_back(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        submit_end - submit_begin)
+                        .count());
+            }
+            nb_tasks++;
+        }
+        ready_slots.clear();
+
+        (void)astraea_pe_progress(bench->pe);
+
+        if (std::chrono::steady_clock::now() >= report_time) {
+            second++;
+            report(bench, mode, second, nb_tasks, &samples);
+            report_time += std::chrono::seconds(1);
+        }
+    }
+
+    while (bench->idle_slots.size() < NB_INFLIGHT) {
+        (void)astraea_pe_progress(bench->pe);
+    }
+    if (bench->nb_failed > 0) {
+        DOCA_LOG_ERR("%lu tasks failed", bench->nb_failed);
+        return DOCA_ERROR_UNEXPECTED;
+    }
+    return DOCA_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    doca_error_t status;
+
+    /* Setup SDK logger */
+    doca_log_backend *sdk_log;
+    status = doca_log_backend_create_standard();
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to create log standard backend: %s\n",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = doca_log_backend_create_with_file_sdk(stderr, &sdk_log);
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to create log backend with file sdk: %s\n",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = doca_log_backend_set_sdk_level(sdk_log, DOCA_LOG_LEVEL_WARNING);
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to set log backend level: %s",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    const uint64_t duration_s =
+        argc > 1 ? strtoull(argv[1], nullptr, 10) : DEFAULT_DURATION_S;
+
+    astraea_authenticator authenticator{LATENCY_SLA_US, &status};
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register app");
+        return EXIT_FAILURE;
+    }
+
+    handle_bench bench;
+    status = setup(&bench);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set up the software ec");
+        return EXIT_FAILURE;
+    }
+
+    /* Embedded first, the leaked heap handles would inflate its rss */
+    for (bool is_heap : {false, true}) {
+        status = run(&bench, is_heap, duration_s);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Profiling failed");
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,454 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <doca_buf.h>
+#include <doca_buf_inventory.h>
+#include <doca_error.h>
+#include <doca_log.h>
+#include <doca_mmap.h>
+
+#include "astraea_ctx.h"
+#include "astraea_ec.h"
+#include "astraea_pe.h"
+#include "astraea_ring.h"
+#include "resource_mgmt.h"
+
+DOCA_LOG_REGISTER(PRODUCER_SCALING : MAIN);
+
+/**
+ * Cost of allocating and submitting tasks of one ctx from many threads
+ * 1, 2, 4, 8 and 16 producer threads each keep NB_INFLIGHT tasks in flight
+ * on a software ec for the given seconds, 5 by default, while the main
+ * thread drives the pe and the ctx runs its submitter thread. Each round
+ * prints the task rate and the mean and p99 time of allocate_init plus
+ * submit. Blocks are 4KB unless a block size is given, larger blocks get
+ * sliced and their strips share the queue with those of other threads
+ * Run it after astraea_scheduler
+ */
+
+constexpr uint32_t NB_DATA_BLOCKS = 4;
+constexpr uint32_t NB_RDNC_BLOCKS = 2;
+constexpr size_t DEFAULT_BLOCK_SIZE = 4096;
+constexpr uint32_t MAX_NB_PRODUCERS = 16;
+/* Tasks each producer keeps in flight, a power of two */
+constexpr uint32_t NB_INFLIGHT = 16;
+constexpr uint32_t LATENCY_SLA_US = 1000;
+constexpr uint64_t DEFAULT_DURATION_S = 5;
+/* Submissions timed per producer and round */
+constexpr size_t MAX_NB_SAMPLES = 256 * 1024;
+
+struct producer;
+struct scaling_bench;
+
+struct producer_slot {
+    producer *owner;
+    uint32_t id;
+};
+
+struct producer {
+    scaling_bench *bench;
+    producer_slot slots[NB_INFLIGHT];
+    std::vector<doca_buf *> dst_bufs;
+    /* Slots whose task completed, pushed by the completion callbacks */
+    astraea_spsc_ring<uint32_t, NB_INFLIGHT> idle_slots;
+    std::atomic<uint32_t> nb_inflight{0};
+    std::atomic<uint64_t> nb_failed{0};
+
+    /* Written by the producer thread, read once it has joined */
+    uint64_t nb_tasks = 0;
+    uint64_t nb_retries = 0;
+    std::vector<uint32_t> samples;
+    doca_error_t status = DOCA_SUCCESS;
+};
+
+struct scaling_bench {
+    astraea_pe *pe = nullptr;
+    astraea_ec *ec = nullptr;
+    astraea_ctx *ctx = nullptr;
+    astraea_ec_matrix *matrix = nullptr;
+    doca_mmap *mmap = nullptr;
+    uint8_t *buffer = nullptr;
+    doca_buf_inventory *buf_inventory = nullptr;
+    doca_buf *src_buf = nullptr;
+    size_t block_size = DEFAULT_BLOCK_SIZE;
+
+    std::unique_ptr<producer> producers[MAX_NB_PRODUCERS];
+    std::atomic<bool> is_stopped{false};
+
+    ~scaling_bench() {
+        if (ctx) {
+            doca_error_t status = astraea_ctx_stop(ctx);
+            while (status == DOCA_ERROR_IN_PROGRESS) {
+                (void)astraea_pe_progress(pe);
+                status = astraea_ctx_stop(ctx);
+            }
+        }
+        if (matrix)
+            astraea_ec_matrix_destroy(matrix);
+        if (ec)
+            astraea_ec_destroy(ec);
+        for (std::unique_ptr<producer> &p : producers) {
+            if (p == nullptr)
+                continue;
+            for (doca_buf *buf : p->dst_bufs)
+                doca_buf_dec_refcount(buf, nullptr);
+        }
+        if (src_buf)
+            doca_buf_dec_refcount(src_buf, nullptr);
+        if (buf_inventory)
+            doca_buf_inventory_destroy(buf_inventory);
+        if (mmap)
+            doca_mmap_destroy(mmap);
+        free(buffer);
+        if (pe)
+            astraea_pe_destroy(pe);
+    }
+};
+
+/* Called on the thread driving the pe */
+static void task_done(doca_data task_user_data, bool is_success) {
+    producer_slot *slot = static_cast<producer_slot *>(task_user_data.ptr);
+    producer *owner = slot->owner;
+    if (!is_success) {
+        owner->nb_failed.fetch_add(1, std::memory_order_relaxed);
+    }
+    owner->idle_slots.try_push(slot->id);
+    owner->nb_inflight.fetch_sub(1, std::memory_order_release);
+}
+
+static void task_success_cb(astraea_ec_task_create *task,
+                            doca_data task_user_data,
+                            doca_data ctx_user_data) {
+    (void)task;
+    (void)ctx_user_data;
+    task_done(task_user_data, true);
+}
+
+static void task_error_cb(astraea_ec_task_create *task,
+                          doca_data task_user_data, doca_data ctx_user_data) {
+    (void)task;
+    (void)ctx_user_data;
+    task_done(task_user_data, false);
+}
+
+static doca_error_t prepare_memory(scaling_bench *bench) {
+    const size_t data_size = NB_DATA_BLOCKS * bench->block_size;
+    const size_t rdnc_size = NB_RDNC_BLOCKS * bench->block_size;
+    const uint32_t nb_dst_bufs = MAX_NB_PRODUCERS * NB_INFLIGHT;
+    const size_t buffer_size = data_size + rdnc_size * nb_dst_bufs;
+
+    if (posix_memalign((void **)&bench->buffer, 64, buffer_size)) {
+        DOCA_LOG_ERR("Failed to alloc memory");
+        return DOCA_ERROR_NO_MEMORY;
+    }
+    for (size_t i = 0; i < data_size; i++) {
+        bench->buffer[i] = rand();
+    }
+
+    /* Software ecs only read the memory from the CPU */
+    doca_error_t status = doca_mmap_create(&bench->mmap);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create mmap: %s", doca_error_get_descr(status));
+        return status;
+    }
+    status = doca_mmap_set_memrange(bench->mmap, bench->buffer, buffer_size);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set memrange: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+    status = doca_mmap_start(bench->mmap);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start mmap: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status =
+        doca_buf_inventory_create(1 + nb_dst_bufs, &bench->buf_inventory);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create buf inventory: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+    status = doca_buf_inventory_start(bench->buf_inventory);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start buf inventory: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_buf_inventory_buf_get_by_data(bench->buf_inventory,
+                                                bench->mmap, bench->buffer,
+                                                data_size, &bench->src_buf);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to alloc buf for data blocks: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    /* Bufs are taken here, producer threads never touch the inventory */
+    uint8_t *dst_addr = bench->buffer + data_size;
+    for (uint32_t i = 0; i < MAX_NB_PRODUCERS; i++) {
+        bench->producers[i] = std::make_unique<producer>();
+        producer *p = bench->producers[i].get();
+        p->bench = bench;
+        for (uint32_t j = 0; j < NB_INFLIGHT; j++) {
+            p->slots[j] = {.owner = p, .id = j};
+            doca_buf *dst_buf;
+            status = doca_buf_inventory_buf_get_by_addr(
+                bench->buf_inventory, bench->mmap, dst_addr, rdnc_size,
+                &dst_buf);
+            if (status != DOCA_SUCCESS) {
+                DOCA_LOG_ERR("Failed to alloc buf for rdnc blocks: %s",
+                             doca_error_get_descr(status));
+                return status;
+            }
+            p->dst_bufs.push_back(dst_buf);
+            dst_addr += rdnc_size;
+        }
+    }
+    return DOCA_SUCCESS;
+}
+
+static doca_error_t setup(scaling_bench *bench) {
+    doca_error_t status = astraea_pe_create(&bench->pe);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create pe: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = astraea_ec_create_software(&bench->ec);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create ec: %s", doca_error_get_descr(status));
+        return status;
+    }
+    status = astraea_ec_task_create_set_conf(
+        bench->ec, task_success_cb, task_error_cb,
+        MAX_NB_PRODUCERS * NB_INFLIGHT);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set ec create task conf: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    bench->ctx = astraea_ec_as_ctx(bench->ec);
+    if (bench->ctx == nullptr) {
+        DOCA_LOG_ERR("Failed to convert ec to ctx");
+        return DOCA_ERROR_UNEXPECTED;
+    }
+    status = astraea_pe_connect_ctx(bench->pe, bench->ctx);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to connect pe to ctx: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+    status = astraea_ctx_start(bench->ctx);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start ctx: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = astraea_ec_matrix_create(bench->ec, ASTRAEA_EC_MATRIX_TYPE_CAUCHY,
+                                      NB_DATA_BLOCKS, NB_RDNC_BLOCKS,
+                                      &bench->matrix);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create ec matrix: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    return prepare_memory(bench);
+}
+
+/* Refill the slots of p as they complete until the round is over */
+static void produce(producer *p) {
+    scaling_bench *bench = p->bench;
+    while (!bench->is_stopped.load(std::memory_order_relaxed)) {
+        uint32_t slot_id;
+        if (!p->idle_slots.try_pop(slot_id)) {
+            std::this_thread::yield();
+            continue;
+        }
+        /* The slot's parity buf is written again from its start */
+        doca_buf_reset_data_len(p->dst_bufs[slot_id]);
+
+        const auto begin = std::chrono::steady_clock::now();
+        astraea_ec_task_create *task;
+        doca_error_t status = astraea_ec_task_create_allocate_init(
+            bench->ec, bench->matrix, bench->mmap, bench->src_buf,
+            bench->mmap, p->dst_bufs[slot_id], {.ptr = &p->slots[slot_id]},
+            &task);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to allocate and init ec task: %s",
+                         doca_error_get_descr(status));
+            p->status = status;
+            return;
+        }
+
+        astraea_task *handle = astraea_ec_task_create_as_task(task);
+        p->nb_inflight.fetch_add(1, std::memory_order_relaxed);
+        status = astraea_task_submit(handle);
+        while (status == DOCA_ERROR_AGAIN) {
+            p->nb_retries++;
+            std::this_thread::yield();
+            status = astraea_task_submit(handle);
+        }
+        const auto end = std::chrono::steady_clock::now();
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to submit task: %s",
+                         doca_error_get_descr(status));
+            p->nb_inflight.fetch_sub(1, std::memory_order_relaxed);
+            astraea_task_free(handle);
+            p->status = status;
+            return;
+        }
+
+        if (p->samples.size() < MAX_NB_SAMPLES) {
+            p->samples.push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end -
+                                                                     begin)
+                    .count());
+        }
+        p->nb_tasks++;
+    }
+}
+
+static doca_error_t run(scaling_bench *bench, uint32_t nb_producers,
+                        uint64_t duration_s) {
+    for (uint32_t i = 0; i < nb_producers; i++) {
+        producer *p = bench->producers[i].get();
+        uint32_t slot_id;
+        while (p->idle_slots.try_pop(slot_id)) {
+        }
+        for (uint32_t j = 0; j < NB_INFLIGHT; j++) {
+            p->idle_slots.try_push(j);
+        }
+        p->nb_tasks = 0;
+        p->nb_retries = 0;
+        p->samples.clear();
+        p->samples.reserve(MAX_NB_SAMPLES);
+    }
+
+    bench->is_stopped.store(false, std::memory_order_relaxed);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < nb_producers; i++) {
+        threads.emplace_back(produce, bench->producers[i].get());
+    }
+
+    const auto begin_time = std::chrono::steady_clock::now();
+    const auto end_time = begin_time + std::chrono::seconds(duration_s);
+    while (std::chrono::steady_clock::now() < end_time) {
+        (void)astraea_pe_progress(bench->pe);
+    }
+    bench->is_stopped.store(true, std::memory_order_relaxed);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    const double elapsed_s =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                      begin_time)
+            .count();
+
+    /* Drain the round so the next one starts with every slot idle */
+    for (uint32_t i = 0; i < nb_producers; i++) {
+        producer *p = bench->producers[i].get();
+        while (p->nb_inflight.load(std::memory_order_acquire) > 0) {
+            (void)astraea_pe_progress(bench->pe);
+        }
+    }
+
+    uint64_t nb_tasks = 0, nb_retries = 0, nb_failed = 0;
+    std::vector<uint32_t> samples;
+    for (uint32_t i = 0; i < nb_producers; i++) {
+        producer *p = bench->producers[i].get();
+        if (p->status != DOCA_SUCCESS) {
+            return p->status;
+        }
+        nb_tasks += p->nb_tasks;
+        nb_retries += p->nb_retries;
+        nb_failed += p->nb_failed.exchange(0, std::memory_order_relaxed);
+        samples.insert(samples.end(), p->samples.begin(), p->samples.end());
+    }
+
+    double mean_ns = 0;
+    uint32_t p99_ns = 0;
+    if (!samples.empty()) {
+        for (uint32_t sample : samples) {
+            mean_ns += sample;
+        }
+        mean_ns /= samples.size();
+        auto p99 = samples.begin() + samples.size() * 99 / 100;
+        std::nth_element(samples.begin(), p99, samples.end());
+        p99_ns = *p99;
+    }
+    DOCA_LOG_INFO("%u producers, %.0f tasks/s, submit mean = %.1fns, "
+                  "p99 = %uns, %lu full queue retries, %lu failed",
+                  nb_producers, nb_tasks / elapsed_s, mean_ns, p99_ns,
+                  nb_retries, nb_failed);
+    return nb_failed > 0 ? DOCA_ERROR_UNEXPECTED : DOCA_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    doca_error_t status;
+
+    /* Setup SDK logger */
+    doca_log_backend *sdk_log;
+    status = doca_log_backend_create_standard();
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to create log standard backend: %s\n",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = doca_log_backend_create_with_file_sdk(stderr, &sdk_log);
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to create log backend with file sdk: %s\n",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = doca_log_backend_set_sdk_level(sdk_log, DOCA_LOG_LEVEL_WARNING);
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to set log backend level: %s",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    const uint64_t duration_s =
+        argc > 1 ? strtoull(argv[1], nullptr, 10) : DEFAULT_DURATION_S;
+
+    astraea_authenticator authenticator{LATENCY_SLA_US, &status};
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register app");
+        return EXIT_FAILURE;
+    }
+
+    scaling_bench bench;
+    if (argc > 2) {
+        bench.block_size = strtoull(argv[2], nullptr, 10);
+    }
+    status = setup(&bench);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set up the software ec");
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t nb_producers = 1; nb_producers <= MAX_NB_PRODUCERS;
+         nb_producers *= 2) {
+        status = run(&bench, nb_producers, duration_s);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Profiling failed");
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
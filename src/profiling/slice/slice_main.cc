@@ -0,0 +1,224 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <doca_buf.h>
+#include <doca_buf_inventory.h>
+#include <doca_error.h>
+#include <doca_log.h>
+#include <doca_mmap.h>
+
+DOCA_LOG_REGISTER(SLICE : MAIN);
+
+/**
+ * Compare what a sliced ec create task costs on the CPU for its parity
+ * 1. copy: every strip lands in a scratch region and is copied back into
+ *    the rdnc blocks on the completion path
+ * 2. zero copy: every strip gets a chain of strided bufs that point into the
+ *    rdnc blocks, built on the submission path
+ */
+
+constexpr uint32_t nb_rdnc_blocks_arr[] = {1, 4, 8, 16, 32};
+constexpr size_t block_size_arr[] = {65536, 262144, 1048576};
+constexpr size_t granularity_arr[] = {1024, 4096, 16384, 65536};
+constexpr uint32_t nb_repeats = 16;
+constexpr size_t MAX_BLOCK_SIZE = 1048576;
+constexpr uint32_t MAX_NB_RDNC_BLOCKS = 32;
+constexpr uint32_t NB_BUFS = 64 * 1024;
+
+struct slice_resources {
+    doca_mmap *mmap = nullptr;
+    doca_buf_inventory *buf_inventory = nullptr;
+    uint8_t *buffer = nullptr;
+
+    ~slice_resources() {
+        if (buf_inventory)
+            doca_buf_inventory_destroy(buf_inventory);
+        if (mmap)
+            doca_mmap_destroy(mmap);
+        free(buffer);
+    }
+};
+
+/* The first half is the rdnc blocks, the second half the scratch region */
+static doca_error_t prepare(slice_resources &rscs) {
+    const size_t size = 2 * MAX_NB_RDNC_BLOCKS * MAX_BLOCK_SIZE;
+    if (posix_memalign((void **)&rscs.buffer, 64, size)) {
+        DOCA_LOG_ERR("Failed to alloc memory");
+        return DOCA_ERROR_NO_MEMORY;
+    }
+    memset(rscs.buffer, 0, size);
+
+    doca_error_t status = doca_mmap_create(&rscs.mmap);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create mmap: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_mmap_set_memrange(rscs.mmap, rscs.buffer, size);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set memrange: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_mmap_start(rscs.mmap);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start mmap: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_buf_inventory_create(NB_BUFS, &rscs.buf_inventory);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create buf inventory: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_buf_inventory_start(rscs.buf_inventory);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start buf inventory: %s",
+                     doca_error_get_descr(status));
+    }
+    return status;
+}
+
+static double copy_path(slice_resources &rscs, uint32_t nb_rdnc_blocks,
+                        size_t block_size, size_t granularity) {
+    uint8_t *dst_base = rscs.buffer;
+    uint8_t *scratch = rscs.buffer + MAX_NB_RDNC_BLOCKS * MAX_BLOCK_SIZE;
+    const uint32_t nb_strips = block_size / granularity;
+
+    auto begin_time = std::chrono::high_resolution_clock::now();
+    for (uint32_t r = 0; r < nb_repeats; r++) {
+        for (uint32_t s = 0; s < nb_strips; s++) {
+            uint8_t *strip = scratch + s * granularity * nb_rdnc_blocks;
+            for (uint32_t i = 0; i < nb_rdnc_blocks; i++) {
+                memcpy(dst_base + i * block_size + s * granularity,
+                       strip + i * granularity, granularity);
+            }
+        }
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end_time -
+                                                                begin_time)
+               .count() /
+           (double)1000 / nb_repeats;
+}
+
+static doca_error_t zero_copy_path(slice_resources &rscs,
+                                   uint32_t nb_rdnc_blocks, size_t block_size,
+                                   size_t granularity, double *time_cost) {
+    uint8_t *dst_base = rscs.buffer;
+    const uint32_t nb_strips = block_size / granularity;
+    doca_error_t status;
+
+    auto begin_time = std::chrono::high_resolution_clock::now();
+    for (uint32_t r = 0; r < nb_repeats; r++) {
+        for (uint32_t s = 0; s < nb_strips; s++) {
+            doca_buf *head = nullptr;
+            for (uint32_t i = 0; i < nb_rdnc_blocks; i++) {
+                doca_buf *buf;
+                status = doca_buf_inventory_buf_get_by_addr(
+                    rscs.buf_inventory, rscs.mmap,
+                    dst_base + i * block_size + s * granularity, granularity,
+                    &buf);
+                if (status != DOCA_SUCCESS) {
+                    DOCA_LOG_ERR("Failed to alloc buf: %s",
+                                 doca_error_get_descr(status));
+                    return status;
+                }
+                if (i == 0) {
+                    head = buf;
+                } else {
+                    status = doca_buf_chain_list(head, buf);
+                    if (status != DOCA_SUCCESS) {
+                        DOCA_LOG_ERR("Failed to chain list: %s",
+                                     doca_error_get_descr(status));
+                        return status;
+                    }
+                }
+            }
+            doca_buf_dec_refcount(head, nullptr);
+        }
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    *time_cost = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     end_time - begin_time)
+                     .count() /
+                 (double)1000 / nb_repeats;
+    return DOCA_SUCCESS;
+}
+
+static doca_error_t profile() {
+    slice_resources rscs;
+    doca_error_t status = prepare(rscs);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to prepare resources");
+        return status;
+    }
+
+    for (uint32_t nb_rdnc_blocks : nb_rdnc_blocks_arr) {
+        for (size_t block_size : block_size_arr) {
+            for (size_t granularity : granularity_arr) {
+                if (granularity >= block_size) {
+                    continue;
+                }
+                double copy_time =
+                    copy_path(rscs, nb_rdnc_blocks, block_size, granularity);
+                double zero_copy_time;
+                status = zero_copy_path(rscs, nb_rdnc_blocks, block_size,
+                                        granularity, &zero_copy_time);
+                if (status != DOCA_SUCCESS) {
+                    return status;
+                }
+                DOCA_LOG_INFO("nb_rdnc_blocks = %u, block_size = %lu, "
+                              "granularity = %lu, completion_copy = %fus, "
+                              "submission_chain = %fus",
+                              nb_rdnc_blocks, block_size, granularity,
+                              copy_time, zero_copy_time);
+            }
+        }
+    }
+    return DOCA_SUCCESS;
+}
+
+int main() {
+    doca_error_t status;
+
+    /* Setup SDK logger */
+    doca_log_backend *sdk_log;
+    status = doca_log_backend_create_standard();
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to create log standard backend: %s\n",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = doca_log_backend_create_with_file_sdk(stderr, &sdk_log);
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to create log backend with file sdk: %s\n",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = doca_log_backend_set_sdk_level(sdk_log, DOCA_LOG_LEVEL_WARNING);
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to set log backend level: %s",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = profile();
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Profiling failed");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
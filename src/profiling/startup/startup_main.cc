@@ -0,0 +1,331 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <vector>
+
+#include <doca_buf.h>
+#include <doca_buf_inventory.h>
+#include <doca_error.h>
+#include <doca_log.h>
+#include <doca_mmap.h>
+
+#include "astraea_ctx.h"
+#include "astraea_ec.h"
+#include "astraea_pe.h"
+#include "resource_mgmt.h"
+
+DOCA_LOG_REGISTER(STARTUP : MAIN);
+
+/**
+ * Cost of bringing an ec up and down, and of the descriptors it holds
+ * Each round creates a pe and a software ec, so no device is needed, and
+ * starts its ctx. Batches of 1 to NB_MAX_HELD_TASKS tasks are then
+ * allocated and freed again without being submitted, which grows the
+ * descriptor slabs as a load of that many tasks in flight would. The ctx
+ * is then stopped and everything destroyed. It prints how long startup and
+ * teardown took and the resident set after each step
+ * Run it after astraea_scheduler
+ */
+
+constexpr uint32_t NB_DATA_BLOCKS = 8;
+constexpr uint32_t NB_RDNC_BLOCKS = 4;
+constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+constexpr uint32_t NB_MAX_HELD_TASKS = 4096;
+constexpr uint32_t LATENCY_SLA_US = 1000;
+constexpr uint32_t DEFAULT_NB_ROUNDS = 5;
+
+struct startup_bench {
+    size_t block_size;
+    doca_mmap *mmap = nullptr;
+    uint8_t *buffer = nullptr;
+    doca_buf_inventory *buf_inventory = nullptr;
+    doca_buf *src_buf = nullptr;
+    /* Every task writes the same parity region, none of them runs */
+    std::vector<doca_buf *> dst_bufs;
+
+    ~startup_bench() {
+        for (doca_buf *buf : dst_bufs)
+            doca_buf_dec_refcount(buf, nullptr);
+        if (src_buf)
+            doca_buf_dec_refcount(src_buf, nullptr);
+        if (buf_inventory)
+            doca_buf_inventory_destroy(buf_inventory);
+        if (mmap)
+            doca_mmap_destroy(mmap);
+        free(buffer);
+    }
+};
+
+static void task_success_cb(astraea_ec_task_create *task,
+                            doca_data task_user_data,
+                            doca_data ctx_user_data) {
+    (void)task;
+    (void)task_user_data;
+    (void)ctx_user_data;
+}
+
+static void task_error_cb(astraea_ec_task_create *task,
+                          doca_data task_user_data, doca_data ctx_user_data) {
+    (void)task;
+    (void)task_user_data;
+    (void)ctx_user_data;
+}
+
+static doca_error_t prepare_memory(startup_bench *bench) {
+    const size_t data_size = NB_DATA_BLOCKS * bench->block_size;
+    const size_t rdnc_size = NB_RDNC_BLOCKS * bench->block_size;
+    const size_t buffer_size = data_size + rdnc_size;
+
+    if (posix_memalign((void **)&bench->buffer, 64, buffer_size)) {
+        DOCA_LOG_ERR("Failed to alloc memory");
+        return DOCA_ERROR_NO_MEMORY;
+    }
+
+    /* Software ecs only read the memory from the CPU */
+    doca_error_t status = doca_mmap_create(&bench->mmap);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create mmap: %s", doca_error_get_descr(status));
+        return status;
+    }
+    status = doca_mmap_set_memrange(bench->mmap, bench->buffer, buffer_size);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set memrange: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+    status = doca_mmap_start(bench->mmap);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start mmap: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_buf_inventory_create(1 + NB_MAX_HELD_TASKS,
+                                       &bench->buf_inventory);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create buf inventory: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+    status = doca_buf_inventory_start(bench->buf_inventory);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start buf inventory: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_buf_inventory_buf_get_by_data(bench->buf_inventory,
+                                                bench->mmap, bench->buffer,
+                                                data_size, &bench->src_buf);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to alloc buf for data blocks: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+    for (uint32_t i = 0; i < NB_MAX_HELD_TASKS; i++) {
+        doca_buf *dst_buf;
+        status = doca_buf_inventory_buf_get_by_addr(
+            bench->buf_inventory, bench->mmap, bench->buffer + data_size,
+            rdnc_size, &dst_buf);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to alloc buf for rdnc blocks: %s",
+                         doca_error_get_descr(status));
+            return status;
+        }
+        bench->dst_bufs.push_back(dst_buf);
+    }
+    return DOCA_SUCCESS;
+}
+
+static uint64_t rss_kb() {
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (file == nullptr) {
+        return 0;
+    }
+    uint64_t nb_pages = 0, nb_resident_pages = 0;
+    if (fscanf(file, "%lu %lu", &nb_pages, &nb_resident_pages) != 2) {
+        nb_resident_pages = 0;
+    }
+    fclose(file);
+    return nb_resident_pages * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - begin)
+        .count();
+}
+
+static doca_error_t start_ec(astraea_pe **pe, astraea_ec **ec) {
+    doca_error_t status = astraea_pe_create(pe);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create pe: %s", doca_error_get_descr(status));
+        return status;
+    }
+    status = astraea_ec_create_software(ec);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create ec: %s", doca_error_get_descr(status));
+        return status;
+    }
+    status = astraea_ec_task_create_set_conf(*ec, task_success_cb,
+                                             task_error_cb, NB_MAX_HELD_TASKS);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set ec create task conf: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+    astraea_ctx *ctx = astraea_ec_as_ctx(*ec);
+    if (ctx == nullptr) {
+        DOCA_LOG_ERR("Failed to convert ec to ctx");
+        return DOCA_ERROR_UNEXPECTED;
+    }
+    status = astraea_pe_connect_ctx(*pe, ctx);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to connect pe to ctx: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+    status = astraea_ctx_start(ctx);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start ctx: %s", doca_error_get_descr(status));
+    }
+    return status;
+}
+
+/* Allocate nb_tasks tasks at once, then free them */
+static doca_error_t hold_tasks(startup_bench *bench, astraea_ec *ec,
+                               astraea_ec_matrix *matrix, uint32_t nb_tasks) {
+    std::vector<astraea_ec_task_create *> tasks;
+    tasks.reserve(nb_tasks);
+    doca_error_t status = DOCA_SUCCESS;
+    for (uint32_t i = 0; i < nb_tasks; i++) {
+        astraea_ec_task_create *task;
+        status = astraea_ec_task_create_allocate_init(
+            ec, matrix, bench->mmap, bench->src_buf, bench->mmap,
+            bench->dst_bufs[i], {.u64 = i}, &task);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to allocate and init ec task: %s",
+                         doca_error_get_descr(status));
+            break;
+        }
+        tasks.push_back(task);
+    }
+
+    astraea_ec_resource_stats resource_stats;
+    astraea_ec_get_resource_stats(ec, &resource_stats);
+    DOCA_LOG_INFO("%u tasks held, rss = %luKB, %u strips, %u strip bufs",
+                  resource_stats.nb_tasks, rss_kb(),
+                  resource_stats.nb_subtasks, resource_stats.nb_task_bufs);
+
+    for (astraea_ec_task_create *task : tasks) {
+        astraea_task_free(astraea_ec_task_create_as_task(task));
+    }
+    return status;
+}
+
+static doca_error_t run_round(startup_bench *bench, uint32_t round) {
+    astraea_pe *pe = nullptr;
+    astraea_ec *ec = nullptr;
+    const uint64_t rss_before_kb = rss_kb();
+
+    auto begin_time = std::chrono::steady_clock::now();
+    doca_error_t status = start_ec(&pe, &ec);
+    const double startup_ms = elapsed_ms(begin_time);
+    DOCA_LOG_INFO("Round %u, startup = %.3fms, rss = %luKB (+%ldKB)", round,
+                  startup_ms, rss_kb(),
+                  static_cast<int64_t>(rss_kb() - rss_before_kb));
+
+    astraea_ec_matrix *matrix = nullptr;
+    if (status == DOCA_SUCCESS) {
+        status = astraea_ec_matrix_create(ec, ASTRAEA_EC_MATRIX_TYPE_CAUCHY,
+                                          NB_DATA_BLOCKS, NB_RDNC_BLOCKS,
+                                          &matrix);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to create ec matrix: %s",
+                         doca_error_get_descr(status));
+        }
+    }
+    for (uint32_t nb_tasks = 1;
+         status == DOCA_SUCCESS && nb_tasks <= NB_MAX_HELD_TASKS;
+         nb_tasks *= 16) {
+        status = hold_tasks(bench, ec, matrix, nb_tasks);
+    }
+
+    begin_time = std::chrono::steady_clock::now();
+    if (matrix) {
+        astraea_ec_matrix_destroy(matrix);
+    }
+    if (ec) {
+        astraea_ctx *ctx = astraea_ec_as_ctx(ec);
+        doca_error_t stop_status = astraea_ctx_stop(ctx);
+        while (stop_status == DOCA_ERROR_IN_PROGRESS) {
+            (void)astraea_pe_progress(pe);
+            stop_status = astraea_ctx_stop(ctx);
+        }
+        astraea_ec_destroy(ec);
+    }
+    if (pe) {
+        astraea_pe_destroy(pe);
+    }
+    const double teardown_ms = elapsed_ms(begin_time);
+    DOCA_LOG_INFO("Round %u, teardown = %.3fms, rss = %luKB", round,
+                  teardown_ms, rss_kb());
+    return status;
+}
+
+int main(int argc, char **argv) {
+    doca_error_t status;
+
+    /* Setup SDK logger */
+    doca_log_backend *sdk_log;
+    status = doca_log_backend_create_standard();
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to create log standard backend: %s\n",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = doca_log_backend_create_with_file_sdk(stderr, &sdk_log);
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to create log backend with file sdk: %s\n",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = doca_log_backend_set_sdk_level(sdk_log, DOCA_LOG_LEVEL_WARNING);
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to set log backend level: %s",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    const uint32_t nb_rounds =
+        argc > 1 ? strtoul(argv[1], nullptr, 10) : DEFAULT_NB_ROUNDS;
+    startup_bench bench;
+    bench.block_size =
+        argc > 2 ? strtoull(argv[2], nullptr, 10) : DEFAULT_BLOCK_SIZE;
+
+    astraea_authenticator authenticator{LATENCY_SLA_US, &status};
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to register app");
+        return EXIT_FAILURE;
+    }
+
+    status = prepare_memory(&bench);
+    if (status != DOCA_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    DOCA_LOG_INFO("Before the first ec, rss = %luKB", rss_kb());
+
+    for (uint32_t round = 0; round < nb_rounds; round++) {
+        status = run_round(&bench, round);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Profiling failed");
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
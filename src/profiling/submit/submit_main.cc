@@ -0,0 +1,436 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <semaphore.h>
+#include <thread>
+#include <vector>
+
+#include <doca_buf.h>
+#include <doca_buf_inventory.h>
+#include <doca_ctx.h>
+#include <doca_dev.h>
+#include <doca_erasure_coding.h>
+#include <doca_error.h>
+#include <doca_log.h>
+#include <doca_mmap.h>
+#include <doca_pe.h>
+
+DOCA_LOG_REGISTER(SUBMIT : MAIN);
+
+/**
+ * Compare how fast strips can be handed to DOCA by the submitter
+ * 1. per strip: two token round trips, one doca_task_submit and a 1us sleep
+ *    per strip, the loop the ctx worker used to run
+ * 2. burst: one token reservation for up to batch_size strips, deferred
+ *    submissions and a single flush
+ * Strips are tiny so the accelerator is never the bottleneck, tokens come
+ * from a process local counter that never runs dry
+ */
+
+constexpr uint32_t batch_size_arr[] = {1, 4, 16, 64, 256};
+constexpr uint32_t NB_DATA_BLOCKS = 4;
+constexpr uint32_t NB_RDNC_BLOCKS = 2;
+constexpr size_t BLOCK_SIZE = 4096;
+constexpr uint32_t NB_TASKS = 256;
+constexpr uint32_t NB_STRIPS = 64 * 1024;
+
+struct submit_resources {
+    doca_dev *dev = nullptr;
+    doca_pe *pe = nullptr;
+    doca_ec *ec = nullptr;
+    doca_ec_matrix *matrix = nullptr;
+    doca_mmap *mmap = nullptr;
+    doca_buf_inventory *buf_inventory = nullptr;
+    uint8_t *buffer = nullptr;
+    std::vector<doca_buf *> bufs;
+    std::vector<doca_ec_task_create *> tasks;
+
+    /* Tasks ready to be submitted again */
+    std::vector<doca_ec_task_create *> idle_tasks;
+    sem_t token_sem;
+    bool has_token_sem = false;
+    uint64_t nb_tokens = UINT64_MAX;
+
+    ~submit_resources() {
+        /* Every task is back in idle_tasks once a run returns */
+        for (doca_ec_task_create *task : tasks)
+            doca_task_free(doca_ec_task_create_as_task(task));
+        if (ec) {
+            doca_error_t status = doca_ctx_stop(doca_ec_as_ctx(ec));
+            while (status == DOCA_ERROR_IN_PROGRESS) {
+                (void)doca_pe_progress(pe);
+                status = doca_ctx_stop(doca_ec_as_ctx(ec));
+            }
+        }
+        if (matrix)
+            doca_ec_matrix_destroy(matrix);
+        if (ec)
+            doca_ec_destroy(ec);
+        for (doca_buf *buf : bufs)
+            doca_buf_dec_refcount(buf, nullptr);
+        if (buf_inventory)
+            doca_buf_inventory_destroy(buf_inventory);
+        if (mmap)
+            doca_mmap_destroy(mmap);
+        free(buffer);
+        if (pe)
+            doca_pe_destroy(pe);
+        if (dev)
+            doca_dev_close(dev);
+        if (has_token_sem)
+            sem_destroy(&token_sem);
+    }
+};
+
+static void task_completion_cb(doca_ec_task_create *task,
+                               doca_data task_user_data,
+                               doca_data ctx_user_data) {
+    (void)ctx_user_data;
+    submit_resources *rscs =
+        static_cast<submit_resources *>(task_user_data.ptr);
+    rscs->idle_tasks.push_back(task);
+}
+
+static doca_error_t open_dev(submit_resources &rscs) {
+    doca_devinfo **devinfo_list;
+    uint32_t nb_devs;
+
+    doca_error_t status = doca_devinfo_create_list(&devinfo_list, &nb_devs);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create devinfo list: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    /* Simply choose the first device, that should work */
+    status = doca_dev_open(devinfo_list[0], &rscs.dev);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to open dev: %s", doca_error_get_descr(status));
+    }
+
+    doca_devinfo_destroy_list(devinfo_list);
+    return status;
+}
+
+static doca_error_t prepare_ctx(submit_resources &rscs) {
+    doca_error_t status = doca_pe_create(&rscs.pe);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create pe: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_ec_create(rscs.dev, &rscs.ec);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create ec: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_ec_task_create_set_conf(rscs.ec, task_completion_cb,
+                                          task_completion_cb, NB_TASKS);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set ec create task conf: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_pe_connect_ctx(rscs.pe, doca_ec_as_ctx(rscs.ec));
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to connect pe to ctx: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_ctx_start(doca_ec_as_ctx(rscs.ec));
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start ctx: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_ec_matrix_create(rscs.ec, DOCA_EC_MATRIX_TYPE_CAUCHY,
+                                   NB_DATA_BLOCKS, NB_RDNC_BLOCKS,
+                                   &rscs.matrix);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create ec matrix: %s",
+                     doca_error_get_descr(status));
+    }
+    return status;
+}
+
+/* Every task gets its own data and rdnc blocks */
+static doca_error_t prepare_tasks(submit_resources &rscs) {
+    const size_t data_size = NB_DATA_BLOCKS * BLOCK_SIZE;
+    const size_t rdnc_size = NB_RDNC_BLOCKS * BLOCK_SIZE;
+    const size_t size = NB_TASKS * (data_size + rdnc_size);
+    if (posix_memalign((void **)&rscs.buffer, 64, size)) {
+        DOCA_LOG_ERR("Failed to alloc memory");
+        return DOCA_ERROR_NO_MEMORY;
+    }
+    memset(rscs.buffer, 0x5a, size);
+
+    doca_error_t status = doca_mmap_create(&rscs.mmap);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create mmap: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_mmap_add_dev(rscs.mmap, rscs.dev);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to add dev: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_mmap_set_memrange(rscs.mmap, rscs.buffer, size);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to set memrange: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_mmap_start(rscs.mmap);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start mmap: %s", doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_buf_inventory_create(2 * NB_TASKS, &rscs.buf_inventory);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to create buf inventory: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    status = doca_buf_inventory_start(rscs.buf_inventory);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to start buf inventory: %s",
+                     doca_error_get_descr(status));
+        return status;
+    }
+
+    for (uint32_t i = 0; i < NB_TASKS; i++) {
+        uint8_t *data = rscs.buffer + i * (data_size + rdnc_size);
+        doca_buf *src_buf, *dst_buf;
+
+        status = doca_buf_inventory_buf_get_by_data(
+            rscs.buf_inventory, rscs.mmap, data, data_size, &src_buf);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to alloc buf for data blocks: %s",
+                         doca_error_get_descr(status));
+            return status;
+        }
+        rscs.bufs.push_back(src_buf);
+
+        status = doca_buf_inventory_buf_get_by_addr(
+            rscs.buf_inventory, rscs.mmap, data + data_size, rdnc_size,
+            &dst_buf);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to alloc buf for rdnc blocks: %s",
+                         doca_error_get_descr(status));
+            return status;
+        }
+        rscs.bufs.push_back(dst_buf);
+
+        doca_ec_task_create *task;
+        status = doca_ec_task_create_allocate_init(
+            rscs.ec, rscs.matrix, src_buf, dst_buf, {.ptr = &rscs}, &task);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to allocate ec create task: %s",
+                         doca_error_get_descr(status));
+            return status;
+        }
+        rscs.tasks.push_back(task);
+        rscs.idle_tasks.push_back(task);
+    }
+
+    if (sem_init(&rscs.token_sem, 0, 1)) {
+        DOCA_LOG_ERR("Failed to init token sem");
+        return DOCA_ERROR_OPERATING_SYSTEM;
+    }
+    rscs.has_token_sem = true;
+    return DOCA_SUCCESS;
+}
+
+/* Reserve up to nb_wanted tokens in one critical section */
+static uint32_t reserve_tokens(submit_resources &rscs, uint32_t nb_wanted) {
+    sem_wait(&rscs.token_sem);
+    uint32_t nb_reserved =
+        rscs.nb_tokens < nb_wanted ? rscs.nb_tokens : nb_wanted;
+    rscs.nb_tokens -= nb_reserved;
+    sem_post(&rscs.token_sem);
+    return nb_reserved;
+}
+
+static doca_error_t per_strip(submit_resources &rscs, uint32_t *nb_strips) {
+    /* Read tokens */
+    sem_wait(&rscs.token_sem);
+    const uint64_t nb_avail_tokens = rscs.nb_tokens;
+    sem_post(&rscs.token_sem);
+
+    uint32_t nb_submitted = 0;
+    if (nb_avail_tokens > 0 && !rscs.idle_tasks.empty()) {
+        doca_error_t status = doca_task_submit(
+            doca_ec_task_create_as_task(rscs.idle_tasks.back()));
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to submit task: %s",
+                         doca_error_get_descr(status));
+            return status;
+        }
+        rscs.idle_tasks.pop_back();
+        nb_submitted++;
+    }
+
+    /* Consume tokens */
+    sem_wait(&rscs.token_sem);
+    rscs.nb_tokens -= nb_submitted;
+    sem_post(&rscs.token_sem);
+
+    std::this_thread::sleep_for(std::chrono::microseconds(1));
+    *nb_strips = nb_submitted;
+    return DOCA_SUCCESS;
+}
+
+static doca_error_t burst(submit_resources &rscs, uint32_t batch_size,
+                          uint32_t *nb_strips) {
+    uint32_t nb_wanted = rscs.idle_tasks.size();
+    if (nb_wanted > batch_size) {
+        nb_wanted = batch_size;
+    }
+    const uint32_t nb_reserved = reserve_tokens(rscs, nb_wanted);
+
+    for (uint32_t i = 0; i < nb_reserved; i++) {
+        doca_error_t status =
+            doca_task_submit_ex(doca_ec_task_create_as_task(
+                                    rscs.idle_tasks.back()),
+                                DOCA_TASK_SUBMIT_FLAG_NONE);
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to submit task: %s",
+                         doca_error_get_descr(status));
+            return status;
+        }
+        rscs.idle_tasks.pop_back();
+    }
+
+    if (nb_reserved > 0) {
+        doca_error_t status = doca_ctx_flush_tasks(doca_ec_as_ctx(rscs.ec));
+        if (status != DOCA_SUCCESS) {
+            DOCA_LOG_ERR("Failed to flush tasks: %s",
+                         doca_error_get_descr(status));
+            return status;
+        }
+    }
+    *nb_strips = nb_reserved;
+    return DOCA_SUCCESS;
+}
+
+/* batch_size 0 runs the per strip loop */
+static doca_error_t run(submit_resources &rscs, uint32_t batch_size,
+                        double *strips_per_sec, double *avg_burst_size) {
+    uint64_t nb_submitted = 0, nb_bursts = 0;
+    doca_error_t status;
+
+    auto begin_time = std::chrono::high_resolution_clock::now();
+    while (nb_submitted < NB_STRIPS) {
+        uint32_t nb_strips = 0;
+        status = batch_size == 0 ? per_strip(rscs, &nb_strips)
+                                 : burst(rscs, batch_size, &nb_strips);
+        if (status != DOCA_SUCCESS) {
+            return status;
+        }
+        if (nb_strips > 0) {
+            nb_submitted += nb_strips;
+            nb_bursts++;
+        }
+        while (doca_pe_progress(rscs.pe)) {
+        }
+    }
+
+    /* Wait for every task to come back before the next round */
+    while (rscs.idle_tasks.size() < NB_TASKS) {
+        (void)doca_pe_progress(rscs.pe);
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    const double time_cost =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end_time -
+                                                             begin_time)
+            .count() /
+        (double)1000000000;
+    *strips_per_sec = nb_submitted / time_cost;
+    *avg_burst_size = nb_submitted / (double)nb_bursts;
+    return DOCA_SUCCESS;
+}
+
+static doca_error_t profile() {
+    submit_resources rscs;
+    doca_error_t status = open_dev(rscs);
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
+
+    status = prepare_ctx(rscs);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to prepare ctx");
+        return status;
+    }
+
+    status = prepare_tasks(rscs);
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Failed to prepare tasks");
+        return status;
+    }
+
+    double strips_per_sec, avg_burst_size;
+    status = run(rscs, 0, &strips_per_sec, &avg_burst_size);
+    if (status != DOCA_SUCCESS) {
+        return status;
+    }
+    DOCA_LOG_INFO("mode = per_strip, strips_per_sec = %f", strips_per_sec);
+
+    for (uint32_t batch_size : batch_size_arr) {
+        status = run(rscs, batch_size, &strips_per_sec, &avg_burst_size);
+        if (status != DOCA_SUCCESS) {
+            return status;
+        }
+        DOCA_LOG_INFO("mode = burst, batch_size = %u, strips_per_sec = %f, "
+                      "avg_burst_size = %f",
+                      batch_size, strips_per_sec, avg_burst_size);
+    }
+    return DOCA_SUCCESS;
+}
+
+int main() {
+    doca_error_t status;
+
+    /* Setup SDK logger */
+    doca_log_backend *sdk_log;
+    status = doca_log_backend_create_standard();
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to create log standard backend: %s\n",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = doca_log_backend_create_with_file_sdk(stderr, &sdk_log);
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to create log backend with file sdk: %s\n",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = doca_log_backend_set_sdk_level(sdk_log, DOCA_LOG_LEVEL_WARNING);
+    if (status != DOCA_SUCCESS) {
+        printf("Failed to set log backend level: %s",
+               doca_error_get_descr(status));
+        return EXIT_FAILURE;
+    }
+
+    status = profile();
+    if (status != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("Profiling failed");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
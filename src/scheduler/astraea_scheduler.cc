@@ -1,3 +1,4 @@
+#include <atomic>
 #include <chrono>
 #include <csignal>
 #include <cstdint>
@@ -13,6 +14,7 @@
 #include <doca_error.h>
 #include <doca_log.h>
 
+#include "astraea_doorbell.h"
 #include "astraea_scheduler.h"
 #include "doca_error.h"
 #include "resource_mgmt.h"
@@ -78,6 +80,8 @@ astraea_scheduler::astraea_scheduler(doca_error_t *status) {
         shm_data->ec_tokens[i] = 0;
         shm_data->pids[i] = -1;
     }
+    shm_data->token_epoch = 0;
+    shm_data->token_refresh_ns = 0;
 
     memset(allocated_ec_tokens, 0, sizeof(allocated_ec_tokens));
 
@@ -147,8 +151,11 @@ void astraea_scheduler::refresh_tokens() {
     double pred_sum = 0;
     double deficit_sum = 0;
     for (uint32_t i = 0; i < shm_data->nb_apps; i++) {
+        /* A refund racing the last refresh may leave more than allocated */
         uint32_t nb_used_tokens =
-            allocated_ec_tokens[i] - shm_data->ec_tokens[i];
+            shm_data->ec_tokens[i] < allocated_ec_tokens[i]
+                ? allocated_ec_tokens[i] - shm_data->ec_tokens[i]
+                : 0;
         pred_tokens[i] = EWMA_COEFF * nb_used_tokens +
                          (1 - EWMA_COEFF) * allocated_ec_tokens[i];
         pred_sum += pred_tokens[i];
@@ -170,6 +177,11 @@ void astraea_scheduler::refresh_tokens() {
         allocated_ec_tokens[i] = nb_allocated_tokens;
         shm_data->ec_tokens[i] = nb_allocated_tokens;
     }
+    /* Bumped under the token semaphores, refunds from before are dropped */
+    std::atomic_ref<uint64_t>(shm_data->token_refresh_ns)
+        .store(astraea_now_ns(), std::memory_order_relaxed);
+    std::atomic_ref<uint32_t>(shm_data->token_epoch)
+        .fetch_add(1, std::memory_order_release);
 
     for (uint32_t i = 0; i < shm_data->nb_apps; i++) {
         if (sem_post(ec_token_sems[i]) == -1) {
@@ -183,6 +195,9 @@ void astraea_scheduler::refresh_tokens() {
     if (sem_post(metadata_sem) == -1) {
         DOCA_LOG_ERR("Failed to release metadata_sem");
     }
+
+    /* Wake submitters parked on an empty bucket */
+    astraea_futex_wake_all(&shm_data->token_epoch, true);
 }
 
 void astraea_scheduler::run() {
@@ -191,6 +206,7 @@ void astraea_scheduler::run() {
 
     do {
         refresh_tokens();
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::this_thread::sleep_for(
+            std::chrono::nanoseconds(TOKEN_REFRESH_PERIOD_NS));
     } while (!scheduler_force_quit);
 }
\ No newline at end of file
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "astraea_gf.h"
+
+/**
+ * Check the CPU erasure coding of astraea_gf.cc
+ *
+ * Every vector kernel this CPU runs must write the same bytes as the scalar
+ * one, including the tail of lengths that are not a multiple of its width
+ * and blocks that are not aligned. Recover and update rows are checked end
+ * to end: rebuilding dropped blocks gives them back, and folding changed
+ * blocks into the parity gives what a full encode of the new data gives.
+ */
+
+constexpr uint32_t NB_TRIALS = 200;
+constexpr uint32_t MAX_NB_DATA_BLOCKS = 32;
+/* More than one pass of the vector kernels */
+constexpr uint32_t MAX_NB_RDNC_BLOCKS = 9;
+constexpr size_t MAX_BLOCK_SIZE = 4096;
+/* Around the widths of the kernels, checked on top of random lengths */
+constexpr size_t EDGE_BLOCK_SIZES[] = {1,  15, 16, 17, 31,  32,  33,
+                                       63, 64, 65, 95, 127, 128, 129};
+
+static uint32_t nb_failures = 0;
+static std::mt19937 rng(20260918);
+
+static void expect(bool is_ok, const char *test, const char *what,
+                   uint32_t nb_data_blocks, uint32_t nb_rdnc_blocks,
+                   size_t block_size) {
+    if (!is_ok) {
+        fprintf(stderr, "%s: %s differs, k = %u, m = %u, block size = %lu\n",
+                test, what, nb_data_blocks, nb_rdnc_blocks, block_size);
+        nb_failures++;
+    }
+}
+
+static uint32_t random_in(uint32_t low, uint32_t high) {
+    return std::uniform_int_distribution<uint32_t>(low, high)(rng);
+}
+
+/* nb_blocks blocks of block_size bytes, offset bytes past an aligned base */
+struct blocks {
+    std::vector<uint8_t> memory;
+    std::vector<uint8_t *> ptrs;
+
+    blocks(uint32_t nb_blocks, size_t block_size, size_t offset = 0)
+        : memory(nb_blocks * (block_size + offset)), ptrs(nb_blocks) {
+        for (uint32_t i = 0; i < nb_blocks; i++) {
+            ptrs[i] = memory.data() + i * (block_size + offset) + offset;
+        }
+    }
+
+    void randomize() {
+        for (uint8_t &byte : memory) {
+            byte = rng();
+        }
+    }
+};
+
+static bool equal(const std::vector<uint8_t *> &a,
+                  const std::vector<uint8_t *> &b, size_t block_size) {
+    for (size_t i = 0; i < a.size(); i++) {
+        if (memcmp(a[i], b[i], block_size) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void encode(astraea_gf_kernel kernel, const uint8_t *coefs,
+                   uint32_t nb_src, uint32_t nb_dst, size_t block_size,
+                   const std::vector<uint8_t *> &src,
+                   const std::vector<uint8_t *> &dst) {
+    std::vector<uint8_t> tables(size_t{nb_src} * nb_dst * GF_TABLE_SIZE);
+    astraea_gf_init_tables(coefs, nb_dst, nb_src, tables.data());
+    astraea_gf_encode(kernel, block_size, nb_src, nb_dst, tables.data(),
+                      src.data(), dst.data());
+}
+
+/* Random coefficients, with zeros and ones, on every kernel */
+static void check_kernel(astraea_gf_kernel kernel, size_t block_size) {
+    const uint32_t k = random_in(1, MAX_NB_DATA_BLOCKS);
+    const uint32_t m = random_in(1, MAX_NB_RDNC_BLOCKS);
+    std::vector<uint8_t> coefs(m * k);
+    for (uint8_t &coef : coefs) {
+        coef = random_in(0, 3) == 0 ? random_in(0, 1) : random_in(0, 255);
+    }
+
+    blocks src(k, block_size, random_in(0, 3));
+    src.randomize();
+    /* Parity is written over whatever the blocks held */
+    blocks want(m, block_size);
+    blocks got(m, block_size, random_in(0, 3));
+    got.randomize();
+
+    encode(ASTRAEA_GF_KERNEL_SCALAR, coefs.data(), k, m, block_size, src.ptrs,
+           want.ptrs);
+    encode(kernel, coefs.data(), k, m, block_size, src.ptrs, got.ptrs);
+    expect(equal(want.ptrs, got.ptrs, block_size), GF_KERNEL_NAMES[kernel],
+           "parity", k, m, block_size);
+}
+
+static void test_kernels() {
+    for (uint32_t i = ASTRAEA_GF_KERNEL_SCALAR + 1; i < ASTRAEA_GF_NB_KERNELS;
+         i++) {
+        const astraea_gf_kernel kernel = static_cast<astraea_gf_kernel>(i);
+        if (!astraea_gf_kernel_is_supported(kernel)) {
+            printf("Skip %s, not supported here\n", GF_KERNEL_NAMES[kernel]);
+            continue;
+        }
+        for (size_t block_size : EDGE_BLOCK_SIZES) {
+            check_kernel(kernel, block_size);
+        }
+        for (uint32_t trial = 0; trial < NB_TRIALS; trial++) {
+            check_kernel(kernel, random_in(1, MAX_BLOCK_SIZE));
+        }
+    }
+}
+
+/* Sorted distinct indices below nb_indices */
+static std::vector<uint32_t> pick_indices(uint32_t nb_indices,
+                                          uint32_t nb_picked) {
+    std::vector<uint32_t> indices(nb_indices);
+    for (uint32_t i = 0; i < nb_indices; i++) {
+        indices[i] = i;
+    }
+    std::shuffle(indices.begin(), indices.end(), rng);
+    indices.resize(nb_picked);
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+/* Encode, drop up to m blocks, rebuild them from the first k survivors */
+static void test_recover() {
+    const char *test = "recover";
+    const astraea_gf_kernel kernel = astraea_gf_best_kernel();
+    for (uint32_t trial = 0; trial < NB_TRIALS; trial++) {
+        const uint32_t k = random_in(1, MAX_NB_DATA_BLOCKS);
+        const uint32_t m = random_in(1, MAX_NB_RDNC_BLOCKS);
+        const size_t block_size = random_in(1, MAX_BLOCK_SIZE);
+        std::vector<uint8_t> coding_coefs(m * k);
+        astraea_gf_gen_cauchy(k, m, coding_coefs.data());
+
+        /* Data then parity, the indices recover counts over */
+        blocks all(k + m, block_size);
+        all.randomize();
+        const std::vector<uint8_t *> data(all.ptrs.begin(),
+                                          all.ptrs.begin() + k);
+        const std::vector<uint8_t *> parity(all.ptrs.begin() + k,
+                                            all.ptrs.end());
+        encode(kernel, coding_coefs.data(), k, m, block_size, data, parity);
+
+        const std::vector<uint32_t> missing =
+            pick_indices(k + m, random_in(1, m));
+        std::vector<uint8_t> coefs(missing.size() * k);
+        if (astraea_gf_gen_recover(coding_coefs.data(), k, m, missing.data(),
+                                   missing.size(), coefs.data()) !=
+            DOCA_SUCCESS) {
+            expect(false, test, "recover rows", k, m, block_size);
+            continue;
+        }
+
+        std::vector<uint8_t *> survivors;
+        std::vector<uint8_t *> lost;
+        for (uint32_t index = 0; index < k + m; index++) {
+            if (std::binary_search(missing.begin(), missing.end(), index)) {
+                lost.push_back(all.ptrs[index]);
+            } else if (survivors.size() < k) {
+                survivors.push_back(all.ptrs[index]);
+            }
+        }
+        blocks rebuilt(missing.size(), block_size);
+        encode(kernel, coefs.data(), k, missing.size(), block_size, survivors,
+               rebuilt.ptrs);
+        expect(equal(lost, rebuilt.ptrs, block_size), test, "rebuilt blocks",
+               k, m, block_size);
+    }
+}
+
+/* Folding changed blocks into the parity matches encoding the new data */
+static void test_update() {
+    const char *test = "update";
+    const astraea_gf_kernel kernel = astraea_gf_best_kernel();
+    for (uint32_t trial = 0; trial < NB_TRIALS; trial++) {
+        const uint32_t k = random_in(1, MAX_NB_DATA_BLOCKS);
+        const uint32_t m = random_in(1, MAX_NB_RDNC_BLOCKS);
+        const size_t block_size = random_in(1, MAX_BLOCK_SIZE);
+        std::vector<uint8_t> coding_coefs(m * k);
+        astraea_gf_gen_cauchy(k, m, coding_coefs.data());
+
+        blocks old_data(k, block_size);
+        old_data.randomize();
+        blocks old_parity(m, block_size);
+        encode(kernel, coding_coefs.data(), k, m, block_size, old_data.ptrs,
+               old_parity.ptrs);
+
+        const std::vector<uint32_t> updated =
+            pick_indices(k, random_in(1, k));
+        const uint32_t n = updated.size();
+        blocks new_data(k, block_size);
+        memcpy(new_data.memory.data(), old_data.memory.data(),
+               old_data.memory.size());
+        for (uint32_t index : updated) {
+            for (size_t pos = 0; pos < block_size; pos++) {
+                new_data.ptrs[index][pos] = rng();
+            }
+        }
+
+        blocks want(m, block_size);
+        encode(kernel, coding_coefs.data(), k, m, block_size, new_data.ptrs,
+               want.ptrs);
+
+        /* Old and new copy of each changed block, then the old parity */
+        std::vector<uint8_t> coefs(m * (2 * n + m));
+        astraea_gf_gen_update(coding_coefs.data(), k, m, updated.data(), n,
+                              coefs.data());
+        std::vector<uint8_t *> src;
+        for (uint32_t index : updated) {
+            src.push_back(old_data.ptrs[index]);
+            src.push_back(new_data.ptrs[index]);
+        }
+        src.insert(src.end(), old_parity.ptrs.begin(), old_parity.ptrs.end());
+        blocks got(m, block_size);
+        encode(kernel, coefs.data(), 2 * n + m, m, block_size, src, got.ptrs);
+        expect(equal(want.ptrs, got.ptrs, block_size), test, "new parity", k,
+               m, block_size);
+    }
+}
+
+int main() {
+    test_kernels();
+    test_recover();
+    test_update();
+
+    if (nb_failures > 0) {
+        fprintf(stderr, "%u checks failed\n", nb_failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
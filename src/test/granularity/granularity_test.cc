@@ -0,0 +1,189 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "astraea_granularity.h"
+
+/**
+ * Drive astraea_granularity_adaptive with a synthetic device
+ *
+ * Tasks always cost more tokens than the bucket holds, so every one of them
+ * is sliced and the ladder alone would cut 32 KB strips. A task takes a
+ * fixed cost per strip plus a cost per byte, whether it meets its sla is up
+ * to each test.
+ */
+
+/* Must match astraea_granularity.cc */
+constexpr uint32_t HOLD_TASKS = 16;
+
+constexpr size_t BLOCK_SIZE = 1024 * 1024;
+constexpr uint32_t NB_DATA_BLOCKS = 8;
+constexpr uint32_t NB_RDNC_BLOCKS = 4;
+/* The ladder picks 32 KB on 64 tokens */
+constexpr uint32_t NB_AVAIL_TOKENS = 64;
+constexpr size_t LADDER_GRANULARITY = 32 * 1024;
+
+struct latency_model {
+    double strip_overhead_ns;
+    double ns_per_byte;
+};
+
+/* The cost of strips is hidden behind the bytes they move */
+constexpr latency_model FLAT_MODEL = {0, 1};
+/* Every strip costs 10us, finer strips are much slower */
+constexpr latency_model OVERHEAD_MODEL = {10000, 0.01};
+
+static uint32_t nb_failures = 0;
+
+static void expect(bool is_ok, const char *test, const char *what,
+                   uint64_t got, uint64_t want) {
+    if (!is_ok) {
+        fprintf(stderr, "%s: %s is %lu, expected %lu\n", test, what, got,
+                want);
+        nb_failures++;
+    }
+}
+
+/* Choose a strip size for one task, run it and report back */
+static size_t run_task(void *state, size_t block_size,
+                       const latency_model &model, bool is_miss) {
+    const astraea_granularity_ops &ops = astraea_granularity_adaptive;
+    const astraea_granularity_input input = {
+        .nb_data_blocks = NB_DATA_BLOCKS,
+        .nb_rdnc_blocks = NB_RDNC_BLOCKS,
+        .block_size = block_size,
+        .token_cost = NB_AVAIL_TOKENS * 4,
+        .nb_avail_tokens = NB_AVAIL_TOKENS};
+    const size_t granularity = ops.choose(state, &input);
+
+    const uint32_t nb_strips =
+        granularity < block_size ? block_size / granularity : 1;
+    const double latency_ns =
+        nb_strips * model.strip_overhead_ns +
+        model.ns_per_byte * block_size * NB_DATA_BLOCKS;
+    const astraea_granularity_feedback feedback = {
+        .block_size = block_size,
+        .granularity = granularity < block_size ? granularity : block_size,
+        .nb_data_blocks = NB_DATA_BLOCKS,
+        .nb_strips = nb_strips,
+        .latency_ns = static_cast<uint64_t>(latency_ns),
+        .slack_ns = is_miss ? -1000 : 1000,
+        .has_failed = false};
+    ops.feedback(state, &feedback);
+    return granularity;
+}
+
+/* Return the strip size of the last task */
+static size_t run_tasks(void *state, uint32_t nb_tasks,
+                        const latency_model &model, bool is_miss) {
+    size_t granularity = 0;
+    for (uint32_t i = 0; i < nb_tasks; i++) {
+        granularity = run_task(state, BLOCK_SIZE, model, is_miss);
+    }
+    return granularity;
+}
+
+/* Each window of misses halves the strips, none move in between */
+static void test_misses_move_down() {
+    const char *test = "misses_move_down";
+    void *state = astraea_granularity_adaptive.create();
+
+    for (uint32_t window = 0; window < 3; window++) {
+        const size_t want = LADDER_GRANULARITY >> window;
+        for (uint32_t i = 0; i < HOLD_TASKS; i++) {
+            const size_t got = run_task(state, BLOCK_SIZE, FLAT_MODEL, true);
+            expect(got == want, test, "granularity", got, want);
+        }
+    }
+
+    astraea_granularity_stats stats = {};
+    astraea_granularity_adaptive.get_stats(state, &stats);
+    expect(stats.nb_steps_down == 3, test, "steps down", stats.nb_steps_down,
+           3);
+    expect(stats.nb_steps_up == 0, test, "steps up", stats.nb_steps_up, 0);
+    astraea_granularity_adaptive.destroy(state);
+}
+
+/* A miss rate inside the band neither refines nor coarsens strips */
+static void test_hold_in_band() {
+    const char *test = "hold_in_band";
+    void *state = astraea_granularity_adaptive.create();
+
+    /* One miss per window keeps the rate between 2% and 10% */
+    for (uint32_t i = 0; i < HOLD_TASKS * 16; i++) {
+        const bool is_miss = i % HOLD_TASKS == HOLD_TASKS - 1;
+        const size_t got = run_task(state, BLOCK_SIZE, FLAT_MODEL, is_miss);
+        expect(got == LADDER_GRANULARITY, test, "granularity", got,
+               LADDER_GRANULARITY);
+    }
+
+    astraea_granularity_stats stats = {};
+    astraea_granularity_adaptive.get_stats(state, &stats);
+    expect(stats.nb_steps_down == 0, test, "steps down", stats.nb_steps_down,
+           0);
+    expect(stats.nb_steps_up == 0, test, "steps up", stats.nb_steps_up, 0);
+    astraea_granularity_adaptive.destroy(state);
+}
+
+/* A move that makes latency worse is taken back and retried later */
+static void test_rollback() {
+    const char *test = "rollback";
+    void *state = astraea_granularity_adaptive.create();
+
+    size_t got = run_tasks(state, HOLD_TASKS, OVERHEAD_MODEL, true);
+    expect(got == LADDER_GRANULARITY, test, "first window", got,
+           LADDER_GRANULARITY);
+    got = run_tasks(state, HOLD_TASKS, OVERHEAD_MODEL, true);
+    expect(got == LADDER_GRANULARITY / 2, test, "after the move", got,
+           LADDER_GRANULARITY / 2);
+    got = run_task(state, BLOCK_SIZE, OVERHEAD_MODEL, true);
+    expect(got == LADDER_GRANULARITY, test, "after the rollback", got,
+           LADDER_GRANULARITY);
+
+    /* The hold doubled, the next move waits for two windows */
+    got = run_tasks(state, HOLD_TASKS * 2 - 2, OVERHEAD_MODEL, true);
+    expect(got == LADDER_GRANULARITY, test, "during the longer hold", got,
+           LADDER_GRANULARITY);
+    run_task(state, BLOCK_SIZE, OVERHEAD_MODEL, true);
+    got = run_task(state, BLOCK_SIZE, OVERHEAD_MODEL, true);
+    expect(got == LADDER_GRANULARITY / 2, test, "after the longer hold", got,
+           LADDER_GRANULARITY / 2);
+
+    astraea_granularity_stats stats = {};
+    astraea_granularity_adaptive.get_stats(state, &stats);
+    expect(stats.nb_steps_down == 2, test, "steps down", stats.nb_steps_down,
+           2);
+    expect(stats.nb_steps_up == 1, test, "steps up", stats.nb_steps_up, 1);
+    astraea_granularity_adaptive.destroy(state);
+}
+
+/* Tasks of another block size leave what was learnt on the first alone */
+static void test_per_geometry() {
+    const char *test = "per_geometry";
+    void *state = astraea_granularity_adaptive.create();
+
+    run_tasks(state, HOLD_TASKS * 2, FLAT_MODEL, true);
+    for (uint32_t i = 0; i < HOLD_TASKS; i++) {
+        const size_t got = run_task(state, BLOCK_SIZE / 2, FLAT_MODEL, false);
+        expect(got == LADDER_GRANULARITY, test, "other block size", got,
+               LADDER_GRANULARITY);
+    }
+    const size_t got = run_task(state, BLOCK_SIZE, FLAT_MODEL, true);
+    expect(got == LADDER_GRANULARITY / 4, test, "first block size", got,
+           LADDER_GRANULARITY / 4);
+    astraea_granularity_adaptive.destroy(state);
+}
+
+int main() {
+    test_misses_move_down();
+    test_hold_in_band();
+    test_rollback();
+    test_per_geometry();
+
+    if (nb_failures > 0) {
+        fprintf(stderr, "%u checks failed\n", nb_failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}